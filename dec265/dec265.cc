@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits>
+#include <algorithm>
 #include <getopt.h>
 #ifdef HAVE_MALLOC_H
 #include <malloc.h>
@@ -42,6 +43,10 @@
 #ifndef _MSC_VER
 #include <sys/time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#define HAVE_MMAP_INPUT 1
 #endif
 
 #include "libde265/quality.h"
@@ -57,10 +62,12 @@ using namespace videogfx;
 
 
 #define BUFFER_SIZE 40960
+#define MMAP_WINDOW_SIZE (1024*1024)
 #define NUM_THREADS 4
 
 int nThreads=0;
 bool nal_input=false;
+bool mmap_input=false;
 int quiet=0;
 bool check_hash=false;
 bool show_help=false;
@@ -82,6 +89,12 @@ int highestTID = 100;
 int verbosity=0;
 int disable_deblocking=0;
 int disable_sao=0;
+bool build_index=false;
+int keyframes_only=0;
+int low_latency=0;
+int stage_timing=0;
+const char* trace_filename = NULL;
+int roi[5] = { 0,0,0,0,0 }; // x,y,w,h,margin
 
 static struct option long_options[] = {
   {"quiet",      no_argument,       0, 'q' },
@@ -92,6 +105,7 @@ static struct option long_options[] = {
   {"output",     required_argument, 0, 'o' },
   {"dump",       no_argument,       0, 'd' },
   {"nal",        no_argument,       0, 'n' },
+  {"mmap",       no_argument,       0, 'M' },
   {"videogfx",   no_argument,       0, 'V' },
   {"no-logging", no_argument,       0, 'L' },
   {"help",       no_argument,       0, 'h' },
@@ -101,9 +115,15 @@ static struct option long_options[] = {
   {"ssim",        no_argument,       0, 's' },
   {"errmap",      no_argument,       0, 'e' },
   {"highest-TID", required_argument, 0, 'T' },
+  {"index",       no_argument,       0, 'I' },
   {"verbose",    no_argument,       0, 'v' },
   {"disable-deblocking", no_argument, &disable_deblocking, 1 },
   {"disable-sao",        no_argument, &disable_sao, 1 },
+  {"keyframes-only",     no_argument, &keyframes_only, 1 },
+  {"low-latency",        no_argument, &low_latency, 1 },
+  {"timing",             no_argument, &stage_timing, 1 },
+  {"trace",              required_argument, 0, 'A' },
+  {"roi",                required_argument, 0, 'R' },
   {0,         0,                 0,  0 }
 };
 
@@ -554,12 +574,117 @@ void (*volatile __malloc_initialize_hook)(void) = init_my_hooks;
 #endif
 
 
+#if HAVE_MMAP_INPUT
+struct mapped_input
+{
+  const uint8_t* data;
+  size_t size;
+  size_t pos;
+};
+
+static bool map_input_file(const char* filename, mapped_input* in)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd<0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd,&st)<0) {
+    close(fd);
+    return false;
+  }
+
+  in->size = st.st_size;
+  in->pos  = 0;
+  in->data = NULL;
+
+  if (in->size>0) {
+    void* mem = mmap(NULL, in->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mem == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+
+    in->data = (const uint8_t*)mem;
+    madvise(mem, in->size, MADV_SEQUENTIAL);
+  }
+
+  close(fd);
+  return true;
+}
+
+static void unmap_input_file(mapped_input* in)
+{
+  if (in->data) {
+    munmap((void*)in->data, in->size);
+  }
+}
+
+/* Push the next window of the mapped file into the decoder. The data is passed
+   to the decoder directly from the mapping, without an intermediate read buffer.
+ */
+static de265_error push_mapped_input(de265_decoder_context* ctx, mapped_input* in,
+                                     FILE* bytestream_fh)
+{
+  de265_error err = DE265_OK;
+  size_t window_end = std::min(in->pos + MMAP_WINDOW_SIZE, in->size);
+
+  if (nal_input) {
+    while (in->pos < window_end && in->size - in->pos >= 4) {
+      const uint8_t* p = in->data + in->pos;
+      size_t length = ((uint32_t)p[0]<<24) + ((uint32_t)p[1]<<16) + ((uint32_t)p[2]<<8) + p[3];
+      length = std::min(length, in->size - in->pos - 4);
+
+      err = de265_push_NAL(ctx, p+4, length, in->pos, (void*)1);
+      if (err != DE265_OK) {
+        return err;
+      }
+
+      if (bytestream_fh) {
+        uint8_t sc[3] = { 0,0,1 };
+        fwrite(sc ,1,3,bytestream_fh);
+        fwrite(p+4,1,length,bytestream_fh);
+      }
+
+      in->pos += 4+length;
+    }
+
+    if (in->size - in->pos < 4) {
+      in->pos = in->size; // ignore incomplete length prefix at end of file
+    }
+  }
+  else if (in->pos < window_end) {
+    err = de265_push_data(ctx, in->data + in->pos, window_end - in->pos, in->pos, (void*)2);
+    if (err != DE265_OK) {
+      return err;
+    }
+
+    in->pos = window_end;
+  }
+
+
+  // read-ahead hint for the next window
+
+  if (in->pos < in->size) {
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    size_t start = in->pos & ~(pagesize-1);
+    size_t end   = std::min(in->pos + MMAP_WINDOW_SIZE, in->size);
+
+    madvise((void*)(in->data + start), end-start, MADV_WILLNEED);
+  }
+
+  return DE265_OK;
+}
+#endif
+
+
 int main(int argc, char** argv)
 {
   while (1) {
     int option_index = 0;
 
-    int c = getopt_long(argc, argv, "qt:chf:o:dLB:n0vT:m:se"
+    int c = getopt_long(argc, argv, "qt:chf:o:dLB:nM0vT:m:seI"
 #if HAVE_VIDEOGFX && HAVE_SDL
                         "V"
 #endif
@@ -576,6 +701,7 @@ int main(int argc, char** argv)
     case 'h': show_help=true; break;
     case 'd': dump_headers=true; break;
     case 'n': nal_input=true; break;
+    case 'M': mmap_input=true; break;
     case 'V': output_with_videogfx=true; break;
     case 'L': logging=false; break;
     case '0': no_acceleration=true; break;
@@ -585,6 +711,14 @@ int main(int argc, char** argv)
     case 'e': show_psnr_map=true; break;
     case 'T': highestTID=atoi(optarg); break;
     case 'v': verbosity++; break;
+    case 'I': build_index=true; break;
+    case 'A': trace_filename=optarg; break;
+    case 'R':
+      if (sscanf(optarg,"%d,%d,%d,%d,%d", &roi[0],&roi[1],&roi[2],&roi[3],&roi[4]) < 4) {
+        fprintf(stderr,"invalid region of interest '%s'\n", optarg);
+        exit(5);
+      }
+      break;
     }
   }
 
@@ -599,6 +733,9 @@ int main(int argc, char** argv)
     fprintf(stderr,"  -t, --threads N   set number of worker threads (0 - no threading)\n");
     fprintf(stderr,"  -c, --check-hash  perform hash check\n");
     fprintf(stderr,"  -n, --nal         input is a stream with 4-byte length prefixed NAL units\n");
+#if HAVE_MMAP_INPUT
+    fprintf(stderr,"  -M, --mmap        memory-map the input file instead of reading it\n");
+#endif
     fprintf(stderr,"  -f, --frames N    set number of frames to process\n");
     fprintf(stderr,"  -o, --output      write YUV reconstruction\n");
     fprintf(stderr,"  -d, --dump        dump headers\n");
@@ -615,8 +752,14 @@ int main(int argc, char** argv)
     fprintf(stderr,"  -e, --errmap      show error-map (only when -m active)\n");
 #endif
     fprintf(stderr,"  -T, --highest-TID select highest temporal sublayer to decode\n");
+    fprintf(stderr,"  -I, --index       only parse headers and print a picture index\n");
     fprintf(stderr,"      --disable-deblocking   disable deblocking filter\n");
     fprintf(stderr,"      --disable-sao          disable sample-adaptive offset filter\n");
+    fprintf(stderr,"      --keyframes-only       only decode IRAP pictures\n");
+    fprintf(stderr,"      --low-latency          output pictures as soon as they are decoded, show latency\n");
+    fprintf(stderr,"      --roi X,Y,W,H[,MARGIN] only decode the tiles covering this region\n");
+    fprintf(stderr,"      --timing               show the time spent in each decoding stage\n");
+    fprintf(stderr,"      --trace FILE           write a Chrome trace of the worker threads\n");
     fprintf(stderr,"  -h, --help        show help\n");
 
     exit(show_help ? 0 : 5);
@@ -632,6 +775,12 @@ int main(int argc, char** argv)
 
   de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_DISABLE_DEBLOCKING, disable_deblocking);
   de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_DISABLE_SAO, disable_sao);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_HEADERS_ONLY, build_index);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_KEYFRAMES_ONLY, keyframes_only);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_LOW_LATENCY_OUTPUT, low_latency);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_STAGE_TIMING, stage_timing);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_THREAD_TRACE, trace_filename != NULL);
+  de265_set_region_of_interest(ctx, roi[0],roi[1],roi[2],roi[3],roi[4]);
 
   if (dump_headers) {
     de265_set_parameter_int(ctx, DE265_DECODER_PARAM_DUMP_SPS_HEADERS, 1);
@@ -671,6 +820,20 @@ int main(int argc, char** argv)
     exit(10);
   }
 
+#if HAVE_MMAP_INPUT
+  mapped_input mapped = {};
+
+  if (mmap_input && !map_input_file(argv[optind], &mapped)) {
+    fprintf(stderr,"cannot map file %s!\n", argv[optind]);
+    exit(10);
+  }
+#else
+  if (mmap_input) {
+    fprintf(stderr,"memory-mapped input is not supported on this platform\n");
+    exit(10);
+  }
+#endif
+
   FILE* bytestream_fh = NULL;
 
   if (write_bytestream) {
@@ -689,6 +852,15 @@ int main(int argc, char** argv)
       //tid = (framecnt/1000) & 1;
       //de265_set_limit_TID(ctx, tid);
 
+#if HAVE_MMAP_INPUT
+      if (mmap_input) {
+        err = push_mapped_input(ctx, &mapped, bytestream_fh);
+        if (err != DE265_OK) {
+          break;
+        }
+      }
+      else
+#endif
       if (nal_input) {
         uint8_t len[4];
         int n = fread(len,1,4,fh);
@@ -735,7 +907,14 @@ int main(int argc, char** argv)
 
       // printf("pending data: %d\n", de265_get_number_of_input_bytes_pending(ctx));
 
-      if (feof(fh)) {
+      bool end_of_input = feof(fh);
+#if HAVE_MMAP_INPUT
+      if (mmap_input) {
+        end_of_input = (mapped.pos == mapped.size);
+      }
+#endif
+
+      if (end_of_input) {
         err = de265_flush_data(ctx); // indicate end of stream
         stop = true;
       }
@@ -788,6 +967,12 @@ int main(int argc, char** argv)
 
   fclose(fh);
 
+#if HAVE_MMAP_INPUT
+  if (mmap_input) {
+    unmap_input_file(&mapped);
+  }
+#endif
+
   if (write_bytestream) {
     fclose(bytestream_fh);
   }
@@ -802,6 +987,64 @@ int main(int argc, char** argv)
     fclose(reference_file);
   }
 
+  if (build_index) {
+    printf("#   offset     pts   POC NAL TID type refs\n");
+
+    for (int i=0;i<de265_get_number_of_indexed_pictures(ctx);i++) {
+      de265_picture_info info;
+      de265_get_picture_info(ctx, i, &info);
+
+      printf("%10lld %7lld %5d %3d %3d  %c%c%c ",
+             (long long)info.stream_offset, (long long)info.pts, info.poc,
+             info.nal_unit_type, info.temporal_id,
+             "BPI"[info.slice_type],
+             info.is_irap ? '*' : ' ',
+             info.is_reference ? ' ' : 'n');
+
+      for (int k=0;k<info.num_dependencies;k++) {
+        printf(" %d", info.dependency_poc[k]);
+      }
+      printf("\n");
+    }
+  }
+
+  if (low_latency && quiet<=1) {
+    de265_latency_statistics latency;
+    de265_get_latency_statistics(ctx, &latency);
+
+    fprintf(stderr,"output latency: %d pictures, average %lld us, max %lld us\n",
+            latency.num_pictures,
+            (long long)latency.average_us,
+            (long long)latency.max_us);
+  }
+
+  if (stage_timing && quiet<=1) {
+    de265_statistics stats;
+    de265_get_statistics(ctx, &stats);
+
+    int64_t sum=0;
+    for (int i=0;i<DE265_NUMBER_OF_DECODE_STAGES;i++) {
+      sum += stats.total_ns[i];
+    }
+
+    fprintf(stderr,"decoding stages (%d pictures):\n", stats.num_pictures);
+
+    for (int i=0;i<DE265_NUMBER_OF_DECODE_STAGES;i++) {
+      fprintf(stderr,"  %-22s %9.2f ms %5.1f%%  %8.3f ms/picture\n",
+              de265_get_decode_stage_name((enum de265_decode_stage)i),
+              stats.total_ns[i] / 1000000.0,
+              sum ? stats.total_ns[i] * 100.0 / sum : 0.0,
+              stats.num_pictures ? stats.total_ns[i] / 1000000.0 / stats.num_pictures : 0.0);
+    }
+  }
+
+  if (trace_filename) {
+    de265_error traceErr = de265_write_thread_trace(ctx, trace_filename);
+    if (traceErr != DE265_OK) {
+      fprintf(stderr,"cannot write trace file %s\n", trace_filename);
+    }
+  }
+
   de265_free_decoder(ctx);
 
   struct timeval tv_end;
@@ -94,6 +94,7 @@ struct inout_params
   option_string input_yuv;
   option_int input_width;
   option_int input_height;
+  option_int input_bit_depth;
 
   option_bool input_is_rgb;
 
@@ -118,8 +119,9 @@ inout_params::inout_params()
   output_filename.set_ID("output"); output_filename.set_short_option('o');
   output_filename.set_default("out.bin");
 
-  reconstruction_yuv.set_ID("input");
-  reconstruction_yuv.set_default("recon.yuv");
+  reconstruction_yuv.set_ID("reconstruction");
+  reconstruction_yuv.set_default("");
+  reconstruction_yuv.set_description("write the reconstructed pictures into this YUV file");
 
   first_frame.set_ID("first-frame");
   first_frame.set_default(0);
@@ -136,6 +138,11 @@ inout_params::inout_params()
   input_height.set_ID("height"); input_height.set_short_option('h');
   input_height.set_minimum(1); input_height.set_default(288);
 
+  input_bit_depth.set_ID("bit-depth");
+  input_bit_depth.set_range(8,10); input_bit_depth.set_default(8);
+  input_bit_depth.set_description("bit depth of the input YUV file (16 bit samples above 8 bit, "
+                                  "which are coded in the Main 10 profile)");
+
   input_is_rgb.set_ID("rgb");
   input_is_rgb.set_default(false);
   input_is_rgb.set_description("input is sequence of RGB PNG images");
@@ -150,6 +157,8 @@ void inout_params::register_params(config_parameters& config)
   config.add_option(&max_number_of_frames);
   config.add_option(&input_width);
   config.add_option(&input_height);
+  config.add_option(&input_bit_depth);
+  config.add_option(&reconstruction_yuv);
 #if HAVE_VIDEOGFX
   if (videogfx::PNG_Supported()) {
     config.add_option(&input_is_rgb);
@@ -272,9 +281,9 @@ int main(int argc, char** argv)
   //test_parameters_API(ectx);
 
 
+  bool write_reconstruction = false;
   if (strlen(inout_params.reconstruction_yuv.get().c_str()) != 0) {
-    reconstruction_sink.set_filename(inout_params.reconstruction_yuv.get().c_str());
-    //ectx.reconstruction_sink = &reconstruction_sink;
+    write_reconstruction = reconstruction_sink.set_filename(inout_params.reconstruction_yuv.get().c_str());
   }
 
   ImageSource* image_source;
@@ -293,7 +302,8 @@ int main(int argc, char** argv)
   else {
     image_source_yuv.set_input_file(inout_params.input_yuv.get().c_str(),
                                     inout_params.input_width,
-                                    inout_params.input_height);
+                                    inout_params.input_height,
+                                    inout_params.input_bit_depth);
     image_source = &image_source_yuv;
   }
 
@@ -343,6 +353,10 @@ int main(int argc, char** argv)
 
         packet_sink.send_packet(pck->data, pck->length);
 
+        if (write_reconstruction && pck->reconstruction) {
+          reconstruction_sink.send_image(pck->reconstruction);
+        }
+
         en265_free_packet(ectx,pck);
       }
     }
@@ -194,6 +194,9 @@ struct acceleration_functions
   // indexed with (log2TbSize-2)
   void (*fwd_transform_8[4])     (int16_t *coeffs, const int16_t *src, ptrdiff_t stride); // fDCT
 
+  void (*fwd_transform_4x4_dst_16)(int16_t *coeffs, const int16_t* src, ptrdiff_t stride, int bit_depth);
+  void (*fwd_transform_16[4])     (int16_t *coeffs, const int16_t *src, ptrdiff_t stride, int bit_depth);
+
 
   // forward Hadamard transform (without scaling factor)
   // (4x4,8x8,16x16,32x32) indexed with (log2TbSize-2)
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 
 #define INITIAL_CABAC_BUFFER_CAPACITY 4096
 
@@ -566,6 +567,25 @@ void CABAC_encoder_bitstream::check_size_and_resize(int nBytes)
 }
 
 
+void CABAC_encoder_bitstream::append_data(const uint8_t* data, int size)
+{
+  while (data_size+size > data_capacity) {
+    check_size_and_resize(size);
+  }
+
+  memcpy(data_mem+data_size, data, size);
+  data_size += size;
+
+  // continue emulation prevention after the appended data
+
+  state=0;
+  for (uint32_t i=(data_size>=2 ? data_size-2 : 0); i<data_size; i++) {
+    if (data_mem[i]==0) { state++; }
+    else                { state=0; }
+  }
+}
+
+
 void CABAC_encoder_bitstream::append_byte(int byte)
 {
   check_size_and_resize(2);
@@ -118,6 +118,9 @@ public:
 
   virtual int  number_free_bits_in_byte() const;
 
+  // append bytes of a previously encoded bitstream (including its emulation-prevention bytes)
+  void append_data(const uint8_t* data, int size);
+
   // output all remaining bits and fill with zeros to next byte boundary
   virtual void flush_VLC();
 
@@ -157,6 +157,8 @@ LIBDE265_API const char* de265_get_error_text(de265_error err)
     return "SPS header missing, cannot decode SEI";
   case DE265_WARNING_COLLOCATED_MOTION_VECTOR_OUTSIDE_IMAGE_AREA:
     return "collocated motion-vector is outside image area";
+  case DE265_WARNING_MEMORY_BUDGET_EXCEEDED:
+    return "decoder memory exceeds the memory budget";
 
   default: return "unknown error";
   }
@@ -321,7 +323,15 @@ LIBDE265_API de265_error de265_push_data(de265_decoder_context* de265ctx,
   //printf("push data (size %d)\n",len);
   //dumpdata(data8,16);
 
-  return ctx->nal_parser.push_data(data,len,pts,user_data);
+  int64_t start = (ctx->param_stage_timing ? monotonic_time_ns() : 0);
+
+  de265_error err = ctx->nal_parser.push_data(data,len,pts,user_data);
+
+  if (start) {
+    ctx->add_pending_stage_time(DE265_STAGE_NAL_PARSING, start);
+  }
+
+  return err;
 }
 
 
@@ -335,7 +345,15 @@ LIBDE265_API de265_error de265_push_NAL(de265_decoder_context* de265ctx,
   //printf("push NAL (size %d)\n",len);
   //dumpdata(data8,16);
 
-  return ctx->nal_parser.push_NAL(data,len,pts,user_data);
+  int64_t start = (ctx->param_stage_timing ? monotonic_time_ns() : 0);
+
+  de265_error err = ctx->nal_parser.push_NAL(data,len,pts,user_data);
+
+  if (start) {
+    ctx->add_pending_stage_time(DE265_STAGE_NAL_PARSING, start);
+  }
+
+  return err;
 }
 
 
@@ -437,6 +455,19 @@ LIBDE265_API void de265_release_next_picture(de265_decoder_context* de265ctx)
 }
 
 
+LIBDE265_API const struct de265_image* de265_image_ref(const struct de265_image* img)
+{
+  decoded_picture_buffer::ref_image((de265_image*)img);
+  return img;
+}
+
+
+LIBDE265_API void de265_image_unref(const struct de265_image* img)
+{
+  decoded_picture_buffer::unref_image((de265_image*)img);
+}
+
+
 
 LIBDE265_API int  de265_get_highest_TID(de265_decoder_context* de265ctx)
 {
@@ -468,6 +499,102 @@ LIBDE265_API int  de265_change_framerate(de265_decoder_context* de265ctx,int mor
   return ctx->change_framerate(more);
 }
 
+LIBDE265_API void de265_report_output_lateness(de265_decoder_context* de265ctx, int lateness_us)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->report_output_lateness(lateness_us);
+}
+
+LIBDE265_API void de265_get_realtime_status(de265_decoder_context* de265ctx,
+                                            struct de265_realtime_status* status)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->get_realtime_status(status);
+}
+
+
+LIBDE265_API void de265_get_latency_statistics(de265_decoder_context* de265ctx,
+                                               struct de265_latency_statistics* stats)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->get_latency_statistics(stats);
+}
+
+
+LIBDE265_API void de265_reset_latency_statistics(de265_decoder_context* de265ctx)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->reset_latency_statistics();
+}
+
+
+LIBDE265_API void de265_get_statistics(de265_decoder_context* de265ctx,
+                                       struct de265_statistics* stats)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->get_statistics(stats);
+}
+
+
+LIBDE265_API void de265_reset_statistics(de265_decoder_context* de265ctx)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->reset_statistics();
+}
+
+
+LIBDE265_API const char* de265_get_decode_stage_name(enum de265_decode_stage stage)
+{
+  switch (stage) {
+  case DE265_STAGE_NAL_PARSING: return "NAL parsing";
+  case DE265_STAGE_SLICE_HEADER: return "slice headers";
+  case DE265_STAGE_SLICE_DATA: return "CABAC/syntax";
+  case DE265_STAGE_INTRA_PREDICTION: return "intra prediction";
+  case DE265_STAGE_MOTION_COMPENSATION: return "motion compensation";
+  case DE265_STAGE_INVERSE_TRANSFORM: return "inverse transform";
+  case DE265_STAGE_DEBLOCKING: return "deblocking";
+  case DE265_STAGE_SAO: return "SAO";
+  case DE265_STAGE_HASH_CHECK: return "hash check";
+  case DE265_STAGE_WAIT_FOR_PROGRESS: return "waiting for progress";
+  default: return "unknown";
+  }
+}
+
+
+LIBDE265_API de265_error de265_write_thread_trace(de265_decoder_context* de265ctx,
+                                                 const char* filename)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  return ctx->write_thread_trace(filename);
+}
+
+
+LIBDE265_API void de265_set_row_callback(de265_decoder_context* de265ctx,
+                                         de265_row_callback callback,
+                                         void* userdata)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->set_row_callback(callback, userdata);
+}
+
+
+LIBDE265_API void de265_set_region_of_interest(de265_decoder_context* de265ctx,
+                                               int x, int y, int width, int height,
+                                               int margin)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->set_region_of_interest(x,y, width,height, margin);
+}
+
+
+LIBDE265_API void de265_set_region_of_interest_tiles(de265_decoder_context* de265ctx,
+                                                     const int* tile_indices,
+                                                     int num_tiles)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  ctx->set_region_of_interest_tiles(tile_indices, num_tiles);
+}
+
 
 LIBDE265_API de265_error de265_get_warning(de265_decoder_context* de265ctx)
 {
@@ -498,6 +625,38 @@ LIBDE265_API void de265_set_parameter_bool(de265_decoder_context* de265ctx, enum
       ctx->param_disable_sao = !!value;
       break;
 
+    case DE265_DECODER_PARAM_HEADERS_ONLY:
+      ctx->param_headers_only = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_KEEP_FULL_MOTION_FIELD:
+      ctx->param_keep_full_motion_field = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_KEYFRAMES_ONLY:
+      ctx->set_keyframes_only(!!value);
+      break;
+
+    case DE265_DECODER_PARAM_SKIP_FILTERS_NON_REFERENCE:
+      ctx->param_skip_filters_non_reference = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_REALTIME_SKIP_FILTERS:
+      ctx->param_realtime_skip_filters = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_LOW_LATENCY_OUTPUT:
+      ctx->param_low_latency_output = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_STAGE_TIMING:
+      ctx->param_stage_timing = !!value;
+      break;
+
+    case DE265_DECODER_PARAM_THREAD_TRACE:
+      ctx->set_thread_tracing(!!value);
+      break;
+
       /*
     case DE265_DECODER_PARAM_DISABLE_MC_RESIDUAL_IDCT:
       ctx->param_disable_mc_residual_idct = !!value;
@@ -541,6 +700,34 @@ LIBDE265_API void de265_set_parameter_int(de265_decoder_context* de265ctx, enum
       ctx->set_acceleration_functions((enum de265_acceleration)value);
       break;
 
+    case DE265_DECODER_PARAM_NAL_POOL_UNITS_PER_CLASS:
+      ctx->nal_parser.set_pool_limits(value, ctx->nal_parser.get_pool_max_bytes());
+      break;
+
+    case DE265_DECODER_PARAM_NAL_POOL_MAX_BYTES:
+      ctx->nal_parser.set_pool_limits(ctx->nal_parser.get_pool_max_units_per_class(), value);
+      break;
+
+    case DE265_DECODER_PARAM_MEMORY_BUDGET_MB:
+      ctx->param_memory_budget = (int64_t)libde265_max(value,0) * 1024*1024;
+      break;
+
+    case DE265_DECODER_PARAM_IMAGE_ALLOCATOR:
+      ctx->param_image_allocator = (enum de265_image_allocator)value;
+      break;
+
+    case DE265_DECODER_PARAM_IMAGE_NUMA_NODE:
+      ctx->param_image_numa_node = value;
+      break;
+
+    case DE265_DECODER_PARAM_SKIP_FILTERS_MIN_TID:
+      ctx->param_skip_filters_min_TID = value;
+      break;
+
+    case DE265_DECODER_PARAM_REALTIME_FRAME_INTERVAL_US:
+      ctx->set_realtime_frame_interval(value);
+      break;
+
     default:
       assert(false);
       break;
@@ -568,6 +755,30 @@ LIBDE265_API int de265_get_parameter_bool(de265_decoder_context* de265ctx, enum
     case DE265_DECODER_PARAM_DISABLE_SAO:
       return ctx->param_disable_sao;
 
+    case DE265_DECODER_PARAM_HEADERS_ONLY:
+      return ctx->param_headers_only;
+
+    case DE265_DECODER_PARAM_KEEP_FULL_MOTION_FIELD:
+      return ctx->param_keep_full_motion_field;
+
+    case DE265_DECODER_PARAM_KEYFRAMES_ONLY:
+      return ctx->param_keyframes_only;
+
+    case DE265_DECODER_PARAM_SKIP_FILTERS_NON_REFERENCE:
+      return ctx->param_skip_filters_non_reference;
+
+    case DE265_DECODER_PARAM_REALTIME_SKIP_FILTERS:
+      return ctx->param_realtime_skip_filters;
+
+    case DE265_DECODER_PARAM_LOW_LATENCY_OUTPUT:
+      return ctx->param_low_latency_output;
+
+    case DE265_DECODER_PARAM_STAGE_TIMING:
+      return ctx->param_stage_timing;
+
+    case DE265_DECODER_PARAM_THREAD_TRACE:
+      return ctx->is_thread_tracing();
+
       /*
     case DE265_DECODER_PARAM_DISABLE_MC_RESIDUAL_IDCT:
       return ctx->param_disable_mc_residual_idct;
@@ -583,6 +794,81 @@ LIBDE265_API int de265_get_parameter_bool(de265_decoder_context* de265ctx, enum
 }
 
 
+LIBDE265_API void de265_get_nal_pool_statistics(de265_decoder_context* de265ctx,
+                                                struct de265_nal_pool_statistics* stats)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  ctx->nal_parser.get_pool_statistics(stats);
+}
+
+
+LIBDE265_API void de265_get_memory_usage(de265_decoder_context* de265ctx,
+                                         struct de265_memory_usage* usage)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  ctx->get_memory_usage(usage);
+}
+
+
+LIBDE265_API int de265_get_number_of_indexed_pictures(de265_decoder_context* de265ctx)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  return ctx->picture_index.size();
+}
+
+
+LIBDE265_API int de265_get_picture_info(de265_decoder_context* de265ctx, int idx,
+                                        struct de265_picture_info* info)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  if (idx<0 || idx>=(int)ctx->picture_index.size()) {
+    return 0;
+  }
+
+  *info = ctx->picture_index[idx];
+  return 1;
+}
+
+
+LIBDE265_API void de265_clear_picture_index(de265_decoder_context* de265ctx)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  ctx->picture_index.clear();
+}
+
+
+LIBDE265_API void de265_add_picture_info(de265_decoder_context* de265ctx,
+                                         const struct de265_picture_info* info)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  ctx->add_picture_info(*info);
+}
+
+
+LIBDE265_API de265_error de265_seek_to_pts(de265_decoder_context* de265ctx, de265_PTS pts,
+                                           int64_t* restart_offset)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  return ctx->seek(true, pts, 0, restart_offset);
+}
+
+
+LIBDE265_API de265_error de265_seek_to_frame(de265_decoder_context* de265ctx, int frame,
+                                             int64_t* restart_offset)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  return ctx->seek(false, 0, frame, restart_offset);
+}
+
+
 LIBDE265_API int de265_get_number_of_input_bytes_pending(de265_decoder_context* de265ctx)
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
@@ -135,7 +135,8 @@ typedef enum {
   DE265_NON_EXISTING_LT_REFERENCE_CANDIDATE_IN_SLICE_HEADER=1023,
   DE265_WARNING_CANNOT_APPLY_SAO_OUT_OF_MEMORY=1024,
   DE265_WARNING_SPS_MISSING_CANNOT_DECODE_SEI=1025,
-  DE265_WARNING_COLLOCATED_MOTION_VECTOR_OUTSIDE_IMAGE_AREA=1026
+  DE265_WARNING_COLLOCATED_MOTION_VECTOR_OUTSIDE_IMAGE_AREA=1026,
+  DE265_WARNING_MEMORY_BUDGET_EXCEEDED=1027
 } de265_error;
 
 LIBDE265_API const char* de265_get_error_text(de265_error err);
@@ -293,6 +294,15 @@ LIBDE265_API const struct de265_image* de265_get_next_picture(de265_decoder_cont
    use the data anymore after calling this function. */
 LIBDE265_API void de265_release_next_picture(de265_decoder_context*);
 
+/* Keep a decoded picture valid beyond de265_release_next_picture(). The picture
+   can be used until the matching de265_image_unref(), while decoding continues.
+   Once the decoder does not need the picture for prediction anymore, it continues
+   with a fresh buffer. References may be dropped in any order and from any thread.
+   Pictures from custom allocation functions should be unreferenced before the
+   decoder is freed; otherwise, release_buffer() gets NULL user data. */
+LIBDE265_API const struct de265_image* de265_image_ref(const struct de265_image*);
+LIBDE265_API void de265_image_unref(const struct de265_image*);
+
 
 LIBDE265_API de265_error de265_get_warning(de265_decoder_context*);
 
@@ -370,10 +380,205 @@ LIBDE265_API void de265_set_framerate_ratio(de265_decoder_context*,int percent);
 LIBDE265_API int  de265_change_framerate(de265_decoder_context*,int more_vs_less); // 1: more, -1: less, returns corresponding framerate_ratio
 
 
+/* --- real-time decoding ---
+
+   With DE265_DECODER_PARAM_REALTIME_FRAME_INTERVAL_US set, a governor adjusts the frame
+   dropping such that the decoder keeps up with the given frame interval. It measures the
+   time spent in de265_decode() over a few pictures of the stream (decoded or dropped).
+   When this exceeds the frame interval, it steps down to a lower quality level:
+   - first, the in-loop filters are skipped on non-reference pictures (only if
+     DE265_DECODER_PARAM_REALTIME_SKIP_FILTERS is set),
+   - then, temporal layers are dropped from the top, one per step. The filters are
+     applied to all decoded pictures again from this step on.
+   When the decoder is fast enough again, the steps are undone. Dropped temporal layers
+   are decoded again from the next IRAP, TSA or STSA picture on.
+   While the governor is active, it controls the framerate ratio. The limit set with
+   de265_set_limit_TID() is still obeyed.
+
+   Applications that present the pictures against a clock can additionally report how
+   late each output picture was with de265_report_output_lateness() (in microseconds,
+   negative if it was early). Late pictures also make the governor step down.
+*/
+
+struct de265_realtime_status
+{
+  int level;            // 0: decoding at full quality, higher: more degradation steps
+  int load;             // decoding time relative to the frame interval in percent (recent pictures)
+  int current_TID;      // highest temporal layer that is currently decoded
+  int skipping_filters; // in-loop filters are skipped on non-reference pictures
+  int num_adjustments;  // number of level changes so far
+};
+
+LIBDE265_API void de265_report_output_lateness(de265_decoder_context*, int lateness_us);
+LIBDE265_API void de265_get_realtime_status(de265_decoder_context*,
+                                            struct de265_realtime_status* status);
+
+
+/* --- low-latency output ---
+
+   Normally, a decoded picture is only output when the first slice of the next picture
+   arrives, or at de265_push_end_of_frame() / de265_flush_data(), because until then,
+   more slices of the picture could follow. With DE265_DECODER_PARAM_LOW_LATENCY_OUTPUT,
+   a picture is filtered and output as soon as its last CTB has been decoded and no
+   further NALs are queued.
+   The output order is not changed: pictures are still reordered as signalled in the
+   stream. For low-delay streams (sps_max_num_reorder_pics == 0), this means that each
+   picture is output by the de265_decode() call that decoded its last slice.
+
+   Note that with de265_push_data(), a NAL is only complete when the start code of the
+   next NAL is seen. Use de265_push_NAL() or de265_push_end_of_NAL() to avoid waiting
+   for the next NAL. Suffix SEIs (e.g. picture hashes) that arrive after the picture
+   was output are ignored.
+
+   de265_get_latency_statistics() reports the time from the arrival of the last slice
+   NAL of each picture (when the NAL was complete in the input) until the picture
+   entered the output queue. Only pictures taken with de265_release_next_picture()
+   or de265_get_next_picture() are counted.
+*/
+
+struct de265_latency_statistics
+{
+  int     num_pictures;
+  int64_t last_us;
+  int64_t average_us;
+  int64_t max_us;
+};
+
+LIBDE265_API void de265_get_latency_statistics(de265_decoder_context*,
+                                               struct de265_latency_statistics* stats);
+LIBDE265_API void de265_reset_latency_statistics(de265_decoder_context*);
+
+
+/* --- row callback ---
+
+   The row callback is called whenever rows of a picture have reached their final state,
+   i.e. after deblocking and SAO. Rows are passed from top to bottom, each row exactly once,
+   as a range [y_start;y_end) of luma rows of the visible picture (as returned by
+   de265_get_image_plane()). The callback may copy or display these rows while the rest
+   of the picture is still being processed. Only pictures that will be output are reported.
+
+   'img' holds the final samples of the rows. It can be a temporary buffer instead of the
+   picture that is output later, and it must only be accessed within the callback.
+   The callback can be called from worker threads, but calls are never concurrent.
+
+   How early rows become available depends on the filters:
+   - Without in-loop filters (or when they are skipped), rows are passed as soon as their
+     CTBs are decoded.
+   - With multi-threaded filtering, rows are passed as the filter tasks finish them.
+   - With single-threaded filtering, all rows are passed when the filters have finished.
+*/
+
+typedef void (*de265_row_callback)(void* userdata, const struct de265_image* img,
+                                   int y_start, int y_end);
+
+LIBDE265_API void de265_set_row_callback(de265_decoder_context*,
+                                         de265_row_callback callback,
+                                         void* userdata);
+
+
+/* --- region of interest ---
+
+   For streams that are coded in tiles, decoding can be restricted to the tiles that
+   cover a region of interest. The substreams of all other tiles are skipped without
+   entropy decoding. The picture area outside of the decoded tiles is undefined.
+
+   The region is a rectangle in luma samples of the visible picture. It is extended by
+   'margin' samples on all sides before the tiles are selected. Since motion vectors
+   can point outside of the region, the margin should cover the motion vector range
+   of the stream. Otherwise, the prediction from undecoded areas leads to artifacts that
+   propagate until the next IRAP picture. Streams with motion-constrained tile sets
+   only need no margin when the loop filters do not cross tile boundaries.
+
+   Deblocking and SAO are not applied across the edges to tiles that are not decoded.
+   When the stream filters across tile boundaries, the region is extended by the 4 luma
+   samples that the loop filters reach before the tiles are selected. Thus, the region
+   is reconstructed like in a full decode. With tiles selected by their index, the
+   samples next to unselected tiles remain unfiltered.
+   Alternatively, the tiles can be selected directly by their index (in raster order of
+   the tile grid). This applies to all pictures, independent of their tiling.
+
+   Set a width or height of 0 (or an empty tile list) to decode the whole picture again.
+   Streams without tiles, or with tiles and WPP, are always decoded completely. The
+   selection takes effect with the next picture.
+*/
+
+LIBDE265_API void de265_set_region_of_interest(de265_decoder_context*,
+                                               int x, int y, int width, int height,
+                                               int margin);
+LIBDE265_API void de265_set_region_of_interest_tiles(de265_decoder_context*,
+                                                     const int* tile_indices,
+                                                     int num_tiles);
+
+
+/* --- per-stage timing ---
+
+   With DE265_DECODER_PARAM_STAGE_TIMING, the decoder measures how much time it spends
+   in each decoding stage. The times are summed over all threads, hence they can exceed
+   the wall-clock time when decoding with several threads. Each picture is accounted
+   when it is completely decoded, and de265_get_statistics() returns the times of the
+   last decoded picture and the sums over all pictures since the last reset.
+
+   DE265_STAGE_SLICE_DATA is the time in slice data decoding that is not spent in intra
+   prediction, motion compensation or the inverse transform, i.e. mainly CABAC decoding
+   and syntax parsing. NAL parsing is counted for the picture whose slice is decoded next.
+   DE265_STAGE_WAIT_FOR_PROGRESS is the time threads are blocked, waiting for other
+   threads to finish CTBs they depend on. With worker threads, the picture hash is checked
+   in the background and its time is only added to the sums when the check is finished.
+
+   The clock is read around every intra, inter and transform block. While the timing is
+   switched on, this slows down decoding by up to about 10% for streams with small blocks.
+*/
+
+enum de265_decode_stage {
+  DE265_STAGE_NAL_PARSING,
+  DE265_STAGE_SLICE_HEADER,
+  DE265_STAGE_SLICE_DATA,
+  DE265_STAGE_INTRA_PREDICTION,
+  DE265_STAGE_MOTION_COMPENSATION,
+  DE265_STAGE_INVERSE_TRANSFORM,
+  DE265_STAGE_DEBLOCKING,
+  DE265_STAGE_SAO,
+  DE265_STAGE_HASH_CHECK,
+  DE265_STAGE_WAIT_FOR_PROGRESS,
+  DE265_NUMBER_OF_DECODE_STAGES
+};
+
+struct de265_statistics
+{
+  int     num_pictures;
+  int64_t last_picture_ns[DE265_NUMBER_OF_DECODE_STAGES];
+  int64_t total_ns[DE265_NUMBER_OF_DECODE_STAGES];
+};
+
+LIBDE265_API void de265_get_statistics(de265_decoder_context*,
+                                       struct de265_statistics* stats);
+LIBDE265_API void de265_reset_statistics(de265_decoder_context*);
+LIBDE265_API const char* de265_get_decode_stage_name(enum de265_decode_stage);
+
+
+/* --- thread-pool tracing ---
+
+   With DE265_DECODER_PARAM_THREAD_TRACE, the worker threads record when they execute
+   which task (CTB rows, slice segments, deblocking and SAO rows), when a task is blocked
+   waiting for the progress of another CTB (with the CTB position and the progress
+   level waited for), and when they are idle.
+
+   de265_write_thread_trace() writes the recorded events in the Chrome trace-event format,
+   which can be viewed in chrome://tracing or ui.perfetto.dev, and clears them. It may be
+   called while the worker threads are decoding; events that they record during the write
+   are kept for the next call. The trace holds at most
+   one million events per worker thread. Decoding without worker threads is not traced.
+*/
+
+LIBDE265_API de265_error de265_write_thread_trace(de265_decoder_context*, const char* filename);
+
+
 /* --- decoding parameters --- */
 
 enum de265_param {
   DE265_DECODER_PARAM_BOOL_SEI_CHECK_HASH=0, // (bool) Perform SEI hash check on decoded pictures.
+                                             //        With worker threads, the check runs in the background
+                                             //        and a mismatch is returned by a later de265_decode().
   DE265_DECODER_PARAM_DUMP_SPS_HEADERS=1,    // (int)  Dump headers to specified file-descriptor.
   DE265_DECODER_PARAM_DUMP_VPS_HEADERS=2,
   DE265_DECODER_PARAM_DUMP_PPS_HEADERS=3,
@@ -382,9 +587,24 @@ enum de265_param {
   DE265_DECODER_PARAM_SUPPRESS_FAULTY_PICTURES=6, // (bool)  do not output frames with decoding errors, default: no (output all images)
 
   DE265_DECODER_PARAM_DISABLE_DEBLOCKING=7,   // (bool)  disable deblocking
-  DE265_DECODER_PARAM_DISABLE_SAO=8           // (bool)  disable SAO filter
+  DE265_DECODER_PARAM_DISABLE_SAO=8,          // (bool)  disable SAO filter
   //DE265_DECODER_PARAM_DISABLE_MC_RESIDUAL_IDCT=9,     // (bool)  disable decoding of IDCT residuals in MC blocks
   //DE265_DECODER_PARAM_DISABLE_INTRA_RESIDUAL_IDCT=10  // (bool)  disable decoding of IDCT residuals in MC blocks
+  DE265_DECODER_PARAM_HEADERS_ONLY=11,        // (bool)  only parse headers and build the picture index (see below)
+  DE265_DECODER_PARAM_NAL_POOL_UNITS_PER_CLASS=12, // (int)  max. number of unused NAL buffers kept per size class
+  DE265_DECODER_PARAM_NAL_POOL_MAX_BYTES=13,       // (int)  max. total size of unused NAL buffers kept
+  DE265_DECODER_PARAM_KEEP_FULL_MOTION_FIELD=14,   // (bool)  keep 4x4 motion of decoded pictures (e.g. for visualization), default: 16x16 only
+  DE265_DECODER_PARAM_MEMORY_BUDGET_MB=15,         // (int)  max. decoder memory in MB (see below), default: 0 (unlimited)
+  DE265_DECODER_PARAM_IMAGE_ALLOCATOR=16,          // (int)  enum de265_image_allocator, default: standard
+  DE265_DECODER_PARAM_IMAGE_NUMA_NODE=17,          // (int)  NUMA node for picture memory (Linux only), default: -1 (no binding)
+  DE265_DECODER_PARAM_KEYFRAMES_ONLY=18,           // (bool)  only decode IRAP pictures (see below)
+  DE265_DECODER_PARAM_SKIP_FILTERS_NON_REFERENCE=19, // (bool)  no deblocking/SAO on pictures that are not used for reference
+  DE265_DECODER_PARAM_SKIP_FILTERS_MIN_TID=20,     // (int)  no deblocking/SAO on temporal layers >= value (see below), default: -1 (off)
+  DE265_DECODER_PARAM_REALTIME_FRAME_INTERVAL_US=21, // (int)  target decoding time per picture for the real-time governor (see above), default: 0 (off)
+  DE265_DECODER_PARAM_REALTIME_SKIP_FILTERS=22,    // (bool)  the real-time governor may skip the in-loop filters on non-reference pictures
+  DE265_DECODER_PARAM_LOW_LATENCY_OUTPUT=23,       // (bool)  output each picture as soon as it is decoded (see above)
+  DE265_DECODER_PARAM_STAGE_TIMING=24,             // (bool)  measure the time spent in each decoding stage (see above)
+  DE265_DECODER_PARAM_THREAD_TRACE=25              // (bool)  record the activity of the worker threads (see above)
 };
 
 // sorted such that a large ID includes all optimizations from lower IDs
@@ -402,6 +622,15 @@ enum de265_acceleration {
 };
 
 
+/* Memory layout of the pixel planes allocated by the library. This has no effect
+   when custom de265_image_allocation functions are used. */
+enum de265_image_allocator {
+  de265_image_allocator_standard = 0,      // 16-byte aligned heap memory
+  de265_image_allocator_cache_aligned = 1, // 64-byte aligned, strides padded against cache-set aliasing
+  de265_image_allocator_huge_pages = 2     // cache_aligned, large planes on 2 MB pages where available
+};
+
+
 /* Set decoding parameters. */
 LIBDE265_API void de265_set_parameter_bool(de265_decoder_context*, enum de265_param param, int value);
 
@@ -412,6 +641,152 @@ LIBDE265_API int  de265_get_parameter_bool(de265_decoder_context*, enum de265_pa
 
 
 
+/* --- NAL buffer pool ---
+
+   Input NAL data is stored in buffers with power-of-two sizes, which are recycled
+   through a pool with one free list per size. The amount of memory kept in the pool
+   is limited by DE265_DECODER_PARAM_NAL_POOL_UNITS_PER_CLASS and
+   DE265_DECODER_PARAM_NAL_POOL_MAX_BYTES.
+*/
+
+struct de265_nal_pool_statistics
+{
+  int64_t num_allocations;  // NAL buffers requested
+  int64_t num_pool_hits;    // requests served from the pool
+  int64_t num_mallocs;      // memory allocations for new or growing buffers
+
+  int     num_pooled_units; // unused buffers currently in the pool
+  int64_t pooled_bytes;     // total size of these buffers
+};
+
+LIBDE265_API void de265_get_nal_pool_statistics(de265_decoder_context*,
+                                                struct de265_nal_pool_statistics* stats);
+
+
+/* --- memory usage ---
+
+   de265_get_memory_usage() reports the memory currently held by a decoder context,
+   including pictures that are still referenced by the application.
+
+   With DE265_DECODER_PARAM_MEMORY_BUDGET_MB, the decoder tries to stay within the
+   given limit. When memory runs short, it
+   - frees pooled pictures, motion fields and NAL buffers,
+   - applies SAO in-place instead of into a separate output picture,
+   - allocates no further pictures while there are decoded pictures waiting in the
+     output queue. de265_decode() then returns DE265_ERROR_IMAGE_BUFFER_FULL until
+     the application has released pictures.
+   If the budget cannot be met nevertheless, decoding continues and
+   DE265_WARNING_MEMORY_BUDGET_EXCEEDED is set.
+*/
+
+struct de265_memory_usage
+{
+  int64_t picture_buffers;  // pixel data of DPB, pooled and application-held pictures
+  int64_t picture_metadata; // per-picture decoding metadata (motion, modes, progress)
+  int64_t sao_buffers;      // SAO output picture and scratch buffer
+  int64_t nal_buffers;      // queued, pending and pooled NAL data
+  int64_t thread_contexts;  // slice decoding contexts
+  int64_t total;
+
+  int64_t budget;           // memory budget in bytes, 0: unlimited
+  int     num_degradations; // how often memory had to be reduced to meet the budget
+};
+
+LIBDE265_API void de265_get_memory_usage(de265_decoder_context*,
+                                         struct de265_memory_usage* usage);
+
+
+/* --- stream probing ---
+
+   When DE265_DECODER_PARAM_HEADERS_ONLY is set, the decoder only parses the parameter
+   sets and slice headers. The slice data is skipped and no pictures are output.
+   Instead, an entry is added to the picture index for each picture (in decoding order).
+   Set the parameter before pushing any data.
+
+   The stream offset is the position of the start code of the first slice NAL of the
+   picture, counted from the first byte pushed with de265_push_data(). For NALs pushed
+   with de265_push_NAL(), only the NAL payload bytes are counted.
+
+   During normal decoding, IRAP pictures are added to the index as they are decoded.
+   This stops after de265_reset(), since the stream position is unknown afterwards.
+
+   When DE265_DECODER_PARAM_KEYFRAMES_ONLY is set, only IRAP (IDR/CRA/BLA) pictures are
+   decoded and output. All other slice NALs and all SEIs are dropped before they are
+   parsed. Parameter sets are still processed. Each CRA picture is decoded like a BLA
+   picture, i.e. it starts a new output sequence.
+*/
+
+/* --- skipping the in-loop filters ---
+
+   DE265_DECODER_PARAM_DISABLE_DEBLOCKING/DISABLE_SAO apply to all pictures, which lets
+   errors accumulate along the prediction chain. The following parameters restrict
+   skipping the filters to some pictures:
+
+   DE265_DECODER_PARAM_SKIP_FILTERS_NON_REFERENCE skips them on sub-layer non-reference
+   pictures of the highest temporal layer of the stream. No other picture is predicted
+   from these, hence the output error does not propagate.
+
+   DE265_DECODER_PARAM_SKIP_FILTERS_MIN_TID skips them on all pictures of the given and
+   higher temporal layers. Errors propagate to other pictures of these layers, but never
+   to lower layers.
+
+   The decoded picture hash SEIs are not checked for pictures decoded this way.
+*/
+
+#define DE265_MAX_PICTURE_DEPENDENCIES 16
+
+struct de265_picture_info
+{
+  int64_t   stream_offset;  // start of the access unit (including VPS/SPS/PPS/SEI before the slices)
+  de265_PTS pts;
+  int       picture_number; // in decoding order, starting at 0
+
+  int poc;
+  int nal_unit_type;
+  int temporal_id;
+  int slice_type;     // lowest slice type of all slices (0:B, 1:P, 2:I)
+  int is_irap;
+  int is_reference;   // 0 for sub-layer non-reference pictures
+
+  // POCs of all pictures referenced by this picture
+  int num_dependencies;
+  int dependency_poc[DE265_MAX_PICTURE_DEPENDENCIES];
+};
+
+LIBDE265_API int  de265_get_number_of_indexed_pictures(de265_decoder_context*);
+
+/* Copy entry 'idx' of the picture index into 'info'. Returns 0 if there is no such entry. */
+LIBDE265_API int  de265_get_picture_info(de265_decoder_context*, int idx, struct de265_picture_info* info);
+
+LIBDE265_API void de265_clear_picture_index(de265_decoder_context*);
+
+/* Add an externally known picture (e.g. from a container index or an earlier probing run).
+   Entries with an already indexed stream offset are ignored. */
+LIBDE265_API void de265_add_picture_info(de265_decoder_context*, const struct de265_picture_info* info);
+
+
+/* --- seeking ---
+
+   Seeking restarts decoding at the last IRAP picture in the picture index that is not
+   after the target. Without a suitable index entry, decoding restarts at the beginning
+   of the stream. The decoder is reset and the application has to continue pushing data
+   from the returned 'restart_offset' on.
+
+   Pictures before the target are not output. Sub-layer non-reference pictures of the
+   highest temporal layer and RASL pictures that cannot be reconstructed are skipped
+   without being decoded.
+
+   de265_seek_to_pts() seeks to the first picture with a PTS not less than 'pts'.
+   de265_seek_to_frame() seeks to picture number 'frame' in decoding order.
+*/
+
+LIBDE265_API de265_error de265_seek_to_pts(de265_decoder_context*, de265_PTS pts,
+                                           int64_t* restart_offset);
+LIBDE265_API de265_error de265_seek_to_frame(de265_decoder_context*, int frame,
+                                             int64_t* restart_offset);
+
+
+
 /* --- optional library initialization --- */
 
 /* Static library initialization. Must be paired with de265_free().
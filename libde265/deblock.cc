@@ -177,7 +177,8 @@ bool derive_edgeFlags_CTBRow(de265_image* img, int ctby)
         if (x0 == 0) filterLeftCbEdge = 0;
         if (y0 == 0) filterTopCbEdge  = 0;
 
-        // check for slice and tile boundaries (8.7.2, step 2 in both processes)
+        // check for slice and tile boundaries (8.7.2, step 2 in both processes),
+        // edges to tiles outside of the region of interest are not filtered either
 
         if (x0 && ((x0 & ctb_mask) == 0)) { // left edge at CTB boundary
           if (shdr->slice_loop_filter_across_slices_enabled_flag == 0 &&
@@ -186,9 +187,10 @@ bool derive_edgeFlags_CTBRow(de265_image* img, int ctby)
             {
               filterLeftCbEdge = 0;
             }
-          else if (pps.loop_filter_across_tiles_enabled_flag == 0 &&
-                   pps.TileIdRS[  x0ctb           +y0ctb*picWidthInCtbs] !=
-                   pps.TileIdRS[((x0-1)>>ctbshift)+y0ctb*picWidthInCtbs]) {
+          else if (pps.TileIdRS[  x0ctb           +y0ctb*picWidthInCtbs] !=
+                   pps.TileIdRS[((x0-1)>>ctbshift)+y0ctb*picWidthInCtbs] &&
+                   (pps.loop_filter_across_tiles_enabled_flag == 0 ||
+                    !img->is_tile_decoded(pps.TileIdRS[((x0-1)>>ctbshift)+y0ctb*picWidthInCtbs]))) {
             filterLeftCbEdge = 0;
           }
         }
@@ -200,9 +202,10 @@ bool derive_edgeFlags_CTBRow(de265_image* img, int ctby)
             {
               filterTopCbEdge = 0;
             }
-          else if (pps.loop_filter_across_tiles_enabled_flag == 0 &&
-                   pps.TileIdRS[x0ctb+  y0ctb           *picWidthInCtbs] !=
-                   pps.TileIdRS[x0ctb+((y0-1)>>ctbshift)*picWidthInCtbs]) {
+          else if (pps.TileIdRS[x0ctb+  y0ctb           *picWidthInCtbs] !=
+                   pps.TileIdRS[x0ctb+((y0-1)>>ctbshift)*picWidthInCtbs] &&
+                   (pps.loop_filter_across_tiles_enabled_flag == 0 ||
+                    !img->is_tile_decoded(pps.TileIdRS[x0ctb+((y0-1)>>ctbshift)*picWidthInCtbs]))) {
             filterTopCbEdge = 0;
           }
         }
@@ -899,6 +902,7 @@ class thread_task_deblock_CTBRow : public thread_task
 {
 public:
   struct de265_image* img;
+  image_unit* imgunit;
   int  ctb_y;
   bool vertical;
 
@@ -933,26 +937,34 @@ void thread_task_deblock_CTBRow::work()
 
   int rightCtb = img->get_sps().PicWidthInCtbsY-1;
 
+  int64_t waitTime = 0;
+
   if (vertical) {
     // pass 1: vertical
+    // (with tiles, the row below can be finished before this one)
+
+    waitTime += img->wait_for_CTB_row(this, ctb_y, CTB_PROGRESS_PREFILTER);
 
-    int CtbRow = std::min(ctb_y+1 , img->get_sps().PicHeightInCtbsY-1);
-    img->wait_for_progress(this, rightCtb,CtbRow, CTB_PROGRESS_PREFILTER);
+    if (ctb_y+1<img->get_sps().PicHeightInCtbsY) {
+      waitTime += img->wait_for_CTB_row(this, ctb_y+1, CTB_PROGRESS_PREFILTER);
+    }
   }
   else {
     // pass 2: horizontal
 
     if (ctb_y>0) {
-      img->wait_for_progress(this, rightCtb,ctb_y-1, CTB_PROGRESS_DEBLK_V);
+      waitTime += img->wait_for_progress(this, rightCtb,ctb_y-1, CTB_PROGRESS_DEBLK_V);
     }
 
-    img->wait_for_progress(this, rightCtb,ctb_y,  CTB_PROGRESS_DEBLK_V);
+    waitTime += img->wait_for_progress(this, rightCtb,ctb_y,  CTB_PROGRESS_DEBLK_V);
 
     if (ctb_y+1<img->get_sps().PicHeightInCtbsY) {
-      img->wait_for_progress(this, rightCtb,ctb_y+1, CTB_PROGRESS_DEBLK_V);
+      waitTime += img->wait_for_progress(this, rightCtb,ctb_y+1, CTB_PROGRESS_DEBLK_V);
     }
   }
 
+  int64_t start = (img->decctx->param_stage_timing ? monotonic_time_ns() : 0);
+
   //printf("deblock %d to %d orientation: %d\n",first,last,vertical);
 
   bool deblocking_enabled;
@@ -979,40 +991,47 @@ void thread_task_deblock_CTBRow::work()
     }
   }
 
+  if (start) {
+    img->add_stage_time(DE265_STAGE_DEBLOCKING, monotonic_time_ns() - start);
+    img->add_stage_time(DE265_STAGE_WAIT_FOR_PROGRESS, waitTime);
+  }
+
   for (int x=0;x<=rightCtb;x++) {
     const int CtbWidth = img->get_sps().PicWidthInCtbsY;
     img->ctb_progress[x+ctb_y*CtbWidth].set_progress(finalProgress);
   }
 
+  if (img->decctx->has_row_callback()) {
+    img->decctx->report_final_CTB_rows(imgunit, img, finalProgress);
+  }
+
   state = Finished;
   img->thread_finishes(this);
 }
 
 
-void add_deblocking_tasks(image_unit* imgunit)
+void add_deblocking_tasks(image_unit* imgunit, bool vertical, int firstRow, int endRow)
 {
   de265_image* img = imgunit->img;
   decoder_context* ctx = img->decctx;
 
-  int nRows = img->get_sps().PicHeightInCtbsY;
+  if (firstRow >= endRow) {
+    return;
+  }
 
-  int n=0;
-  img->thread_start(nRows*2);
+  img->thread_start(endRow-firstRow);
 
-  for (int pass=0;pass<2;pass++)
+  for (int y=firstRow;y<endRow;y++)
     {
-      for (int y=0;y<img->get_sps().PicHeightInCtbsY;y++)
-        {
-          thread_task_deblock_CTBRow* task = new thread_task_deblock_CTBRow;
+      thread_task_deblock_CTBRow* task = new thread_task_deblock_CTBRow;
 
-          task->img   = img;
-          task->ctb_y = y;
-          task->vertical = (pass==0);
+      task->img   = img;
+      task->imgunit = imgunit;
+      task->ctb_y = y;
+      task->vertical = vertical;
 
-          imgunit->tasks.push_back(task);
-          add_task(&ctx->thread_pool_, task);
-          n++;
-        }
+      imgunit->tasks.push_back(task);
+      add_task(&ctx->thread_pool_, task);
     }
 }
 
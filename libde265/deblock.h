@@ -23,7 +23,8 @@
 
 #include "libde265/decctx.h"
 
-void add_deblocking_tasks(image_unit* imgunit);
+// queue the tasks of one pass for the CTB rows [firstRow;endRow)
+void add_deblocking_tasks(image_unit* imgunit, bool vertical, int firstRow, int endRow);
 void apply_deblocking_filter(de265_image* img); //decoder_context* ctx);
 
 #endif
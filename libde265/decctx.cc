@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <new>
 
 #include "fallback.h"
 
@@ -89,6 +90,28 @@ thread_context::thread_context()
 
 
 
+  // There is a interesting issue here. When aligning _coeffBuf to 16 bytes offset with
+  // __attribute__((align(16))), the following statement is optimized away since the
+  // compiler assumes that the pointer would be 16-byte aligned. However, this is not the
+  // case when the structure has been dynamically allocated. In this case, the base can
+  // also be at 8 byte offsets (at least with MingW,32 bit).
+  int offset = ((uintptr_t)_coeffBuf) & 0xf;
+
+  if (offset == 0) {
+    coeffBuf = _coeffBuf;  // correctly aligned already
+  }
+  else {
+    coeffBuf = (int16_t *) (((uint8_t *)_coeffBuf) + (16-offset));
+  }
+
+  slice_data_start = 0;
+
+  reset();
+}
+
+
+void thread_context::reset()
+{
   IsCuQpDeltaCoded = false;
   CuQpDelta = 0;
 
@@ -122,23 +145,72 @@ thread_context::thread_context()
   sliceunit = NULL;
 
 
+  task = NULL;
+
   //memset(this,0,sizeof(thread_context));
 
-  // There is a interesting issue here. When aligning _coeffBuf to 16 bytes offset with
-  // __attribute__((align(16))), the following statement is optimized away since the
-  // compiler assumes that the pointer would be 16-byte aligned. However, this is not the
-  // case when the structure has been dynamically allocated. In this case, the base can
-  // also be at 8 byte offsets (at least with MingW,32 bit).
-  int offset = ((uintptr_t)_coeffBuf) & 0xf;
+  // the coefficient buffer may be left in use when a previous slice was aborted
+  memset(coeffBuf, 0, 32*32*sizeof(int16_t));
+}
 
-  if (offset == 0) {
-    coeffBuf = _coeffBuf;  // correctly aligned already
+
+#define THREAD_CONTEXT_ALIGNMENT 64  // cache line size
+
+thread_context_pool::thread_context_pool()
+  : nAllocated(0)
+{
+}
+
+
+thread_context_pool::~thread_context_pool()
+{
+  // all contexts must have been returned by the slice_units
+  assert(free_contexts.size() == (size_t)nAllocated);
+
+  release_unused();
+}
+
+
+thread_context* thread_context_pool::get()
+{
+  if (!free_contexts.empty()) {
+    thread_context* tctx = free_contexts.back();
+    free_contexts.pop_back();
+
+    tctx->reset();
+    return tctx;
   }
-  else {
-    coeffBuf = (int16_t *) (((uint8_t *)_coeffBuf) + (16-offset));
+
+  void* mem = ALLOC_ALIGNED(THREAD_CONTEXT_ALIGNMENT, sizeof(thread_context));
+  if (mem == NULL) {
+    return NULL;
   }
 
-  memset(coeffBuf, 0, 32*32*sizeof(int16_t));
+  nAllocated++;
+
+  return new (mem) thread_context;
+}
+
+
+void thread_context_pool::put(thread_context* tctx)
+{
+  free_contexts.push_back(tctx);
+}
+
+
+int64_t thread_context_pool::release_unused()
+{
+  int64_t released = free_contexts.size() * (int64_t)sizeof(thread_context);
+
+  for (int i=0;i<(int)free_contexts.size();i++) {
+    free_contexts[i]->~thread_context();
+    FREE_ALIGNED(free_contexts[i]);
+  }
+
+  nAllocated -= free_contexts.size();
+  free_contexts.clear();
+
+  return released;
 }
 
 
@@ -150,35 +222,55 @@ slice_unit::slice_unit(decoder_context* decctx)
     nThreads(0),
     first_decoded_CTB_RS(-1),
     last_decoded_CTB_RS(-1),
-    thread_contexts(NULL),
     ctx(decctx)
 {
   state = Unprocessed;
-  nThreadContexts = 0;
 }
 
 slice_unit::~slice_unit()
 {
   ctx->nal_parser.free_NAL_unit(nal);
 
-  if (thread_contexts) {
-    delete[] thread_contexts;
+  for (int i=0;i<(int)thread_contexts.size();i++) {
+    ctx->thread_contexts.put(thread_contexts[i]);
   }
 }
 
 
-void slice_unit::allocate_thread_contexts(int n)
+de265_error slice_unit::allocate_thread_contexts(int n)
 {
-  assert(thread_contexts==NULL);
+  assert(thread_contexts.empty());
+
+  thread_contexts.reserve(n);
+
+  for (int i=0;i<n;i++) {
+    thread_context* tctx = ctx->thread_contexts.get();
+    if (tctx == NULL) {
+      return DE265_ERROR_OUT_OF_MEMORY;
+    }
+
+    thread_contexts.push_back(tctx);
+  }
 
-  thread_contexts = new thread_context[n];
-  nThreadContexts = n;
+  return DE265_OK;
 }
 
 
 image_unit::image_unit()
 {
   img=NULL;
+  temporal_id=0;
+  end_of_picture_decoded=false;
+  skip_filters=false;
+  num_final_CTB_rows=0;
+  sao_output=NULL;
+  parallel_filters=false;
+  deblocking_tasks=false;
+  sao_tasks=false;
+  num_deblk_V_rows_queued=0;
+  num_deblk_H_rows_queued=0;
+  num_sao_rows_queued=0;
+  num_prefilter_rows_marked=0;
   role=Invalid;
   state=Unprocessed;
 }
@@ -193,6 +285,8 @@ image_unit::~image_unit()
   for (int i=0;i<tasks.size();i++) {
     delete tasks[i];
   }
+
+  delete sao_output;
 }
 
 
@@ -214,6 +308,14 @@ decoder_context::decoder_context()
 
   param_disable_deblocking = false;
   param_disable_sao = false;
+  param_headers_only = false;
+  param_keyframes_only = false;
+  param_skip_filters_non_reference = false;
+  param_skip_filters_min_TID = -1;
+  param_keep_full_motion_field = false;
+  param_low_latency_output = false;
+  param_stage_timing = false;
+  param_memory_budget = 0;
   //param_disable_mc_residual_idct = false;
   //param_disable_intra_residual_idct = false;
 
@@ -226,6 +328,8 @@ decoder_context::decoder_context()
 
   param_image_allocation_functions = de265_image::default_image_allocation;
   param_image_allocation_userdata  = NULL;
+  param_image_allocator = de265_image_allocator_standard;
+  param_image_numa_node = -1;
 
   /*
   memset(&vps, 0, sizeof(video_parameter_set)*DE265_MAX_VPS_SETS);
@@ -253,6 +357,27 @@ decoder_context::decoder_context()
 
   compute_framedrop_table();
 
+  param_realtime_skip_filters = false;
+  realtime_frame_interval = 0;
+  realtime_level = 0;
+  realtime_skip_filters = false;
+  realtime_load = 0;
+  realtime_num_adjustments = 0;
+  realtime_busy_time = 0;
+  realtime_pictures = 0;
+  realtime_late = false;
+  realtime_good_periods = 0;
+
+  reset_latency_statistics();
+  reset_statistics();
+
+  row_callback = NULL;
+  row_callback_userdata = NULL;
+
+  roi_x = roi_y = 0;
+  roi_width = roi_height = 0;
+  roi_margin = 0;
+
 
   //
 
@@ -265,6 +390,26 @@ decoder_context::decoder_context()
   prevPicOrderCntLsb = 0;
   prevPicOrderCntMsb = 0;
   img = NULL;
+  headers_only_shdr = NULL;
+  previous_slice_header = NULL;
+
+  num_memory_degradations = 0;
+  sao_scratch = NULL;
+  sao_scratch_size = 0;
+
+  seek_mode = SeekNone;
+  seek_target_pts = 0;
+  seek_target_frame = 0;
+  seek_target_reached = false;
+  seek_skip_picture = false;
+  seek_hide_picture = false;
+
+  current_picture_number = 0;
+  next_picture_number = 0;
+  stream_position_known = true;
+
+  access_unit_offset = 0;
+  access_unit_prefix = false;
 
   /*
   int PocLsbLt[MAX_NUM_REF_PICS];
@@ -318,10 +463,15 @@ decoder_context::decoder_context()
 
 decoder_context::~decoder_context()
 {
+  discard_hash_checks();
+
   while (!image_units.empty()) {
     delete image_units.back();
     image_units.pop_back();
   }
+
+  delete headers_only_shdr;
+  delete[] sao_scratch;
 }
 
 
@@ -341,6 +491,138 @@ void decoder_context::set_image_allocation_functions(de265_image_allocation* all
 }
 
 
+void decoder_context::get_memory_usage(de265_memory_usage* usage) const
+{
+  memset(usage, 0, sizeof(de265_memory_usage));
+
+  dpb.get_memory_usage(&usage->picture_buffers, &usage->picture_metadata);
+
+  usage->nal_buffers = nal_parser.get_memory_usage();
+  usage->sao_buffers = sao_scratch_size;
+
+  for (int i=0;i<(int)image_units.size();i++) {
+    const image_unit* imgunit = image_units[i];
+
+    if (imgunit->sao_output) {
+      usage->sao_buffers += imgunit->sao_output->get_pixel_memory_size();
+    }
+
+    for (int s=0;s<(int)imgunit->slice_units.size();s++) {
+      const slice_unit* sliceunit = imgunit->slice_units[s];
+
+      if (sliceunit->nal) {
+        usage->nal_buffers += sliceunit->nal->get_capacity();
+      }
+
+    }
+  }
+
+  usage->thread_contexts = thread_contexts.get_memory_usage();
+
+  usage->total = (usage->picture_buffers + usage->picture_metadata + usage->sao_buffers +
+                  usage->nal_buffers + usage->thread_contexts);
+
+  usage->budget = param_memory_budget;
+  usage->num_degradations = num_memory_degradations;
+}
+
+
+bool decoder_context::memory_budget_allows(int64_t additional_bytes)
+{
+  if (param_memory_budget==0) {
+    return true;
+  }
+
+  de265_memory_usage usage;
+  get_memory_usage(&usage);
+
+  if (usage.total + additional_bytes <= param_memory_budget) {
+    return true;
+  }
+
+
+  // release pooled memory, largest first
+
+  int64_t released = dpb.trim_pools();
+  released += thread_contexts.release_unused();
+
+  int64_t pooled_NAL_bytes = nal_parser.get_memory_usage();
+  nal_parser.release_pool();
+  released += pooled_NAL_bytes - nal_parser.get_memory_usage();
+
+  if (released > 0) {
+    num_memory_degradations++;
+  }
+
+  return usage.total - released + additional_bytes <= param_memory_budget;
+}
+
+
+int64_t decoder_context::estimate_picture_memory(const seq_parameter_set& sps) const
+{
+  // pixel planes (with stride alignment)
+
+  int bppY = (sps.BitDepth_Y+7)/8;
+  int bppC = (sps.BitDepth_C+7)/8;
+
+  const int border = MC_BORDER;
+
+  int64_t bytes = (int64_t)((sps.pic_width_in_luma_samples+3*border+15) & ~15)
+    * (sps.pic_height_in_luma_samples+2*border) * bppY;
+
+  if (sps.chroma_format_idc != CHROMA_MONO) {
+    int chromaWidth  = (sps.pic_width_in_luma_samples +3*border) / sps.SubWidthC;
+    int chromaHeight = (sps.pic_height_in_luma_samples+2*border) / sps.SubHeightC;
+
+    bytes += 2 * (int64_t)((chromaWidth+15) & ~15) * chromaHeight * bppC;
+  }
+
+  // metadata, dominated by the motion vectors at 4x4 granularity
+
+  int64_t nBlocks4x4 = (int64_t)(sps.pic_width_in_luma_samples/4) * (sps.pic_height_in_luma_samples/4);
+  bytes += nBlocks4x4 * (sizeof(PBMotion) + 4);
+
+  return bytes;
+}
+
+
+bool decoder_context::has_memory_for_next_picture()
+{
+  if (param_memory_budget==0 || !current_sps) {
+    return true;
+  }
+
+  if (dpb.has_reusable_image(*current_sps)) {
+    return true;
+  }
+
+  if (memory_budget_allows(estimate_picture_memory(*current_sps))) {
+    return true;
+  }
+
+  // Only stall when the application can free memory by releasing output pictures.
+  // Otherwise, we cannot avoid exceeding the budget.
+
+  return dpb.num_pictures_in_output_queue()==0;
+}
+
+
+uint8_t* decoder_context::get_sao_scratch_buffer(int size)
+{
+  if (size > sao_scratch_size) {
+    delete[] sao_scratch;
+    sao_scratch_size = 0;
+
+    sao_scratch = new (std::nothrow) uint8_t[size];
+    if (sao_scratch) {
+      sao_scratch_size = size;
+    }
+  }
+
+  return sao_scratch;
+}
+
+
 de265_error decoder_context::start_thread_pool(int nThreads)
 {
   ::start_thread_pool(&thread_pool_, nThreads);
@@ -353,6 +635,8 @@ de265_error decoder_context::start_thread_pool(int nThreads)
 
 void decoder_context::stop_thread_pool()
 {
+  discard_hash_checks();
+
   if (get_num_worker_threads()>0) {
     //flush_thread_pool(&ctx->thread_pool);
     ::stop_thread_pool(&thread_pool_);
@@ -362,6 +646,8 @@ void decoder_context::stop_thread_pool()
 
 void decoder_context::reset()
 {
+  discard_hash_checks();
+
   if (num_worker_threads>0) {
     //flush_thread_pool(&ctx->thread_pool);
     ::stop_thread_pool(&thread_pool_);
@@ -396,10 +682,32 @@ void decoder_context::reset()
 
   img = NULL;
 
+  if (headers_only_shdr) {
+    if (previous_slice_header == headers_only_shdr) {
+      previous_slice_header = NULL;
+    }
+
+    delete headers_only_shdr;
+    headers_only_shdr = NULL;
+  }
+
 
   // TODO: remove all pending image_units
 
 
+  // --- stream position and seeking ---
+
+  seek_mode = SeekNone;
+  seek_skip_picture = false;
+  seek_hide_picture = false;
+
+  next_picture_number = 0;
+  stream_position_known = false;
+
+  access_unit_offset = 0;
+  access_unit_prefix = false;
+
+
   // --- decoded picture buffer ---
 
   current_image_poc_lsb = -1; // any invalid number
@@ -618,6 +926,8 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
 {
   logdebug(LogHeaders,"---> read slice segment header\n");
 
+  int64_t header_start = (param_stage_timing ? monotonic_time_ns() : 0);
+
 
   // --- read slice header ---
 
@@ -636,6 +946,35 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
   }
 
 
+  if (shdr->first_slice_segment_in_pic_flag) {
+    current_picture_number = next_picture_number++;
+    update_seek_state(nal, nal_hdr.nuh_temporal_id);
+  }
+
+
+  // --- in headers-only mode, only record the picture in the index ---
+
+  if (param_headers_only) {
+    probe_slice_segment_header(shdr, nal, &nal_hdr);
+
+    delete headers_only_shdr;
+    headers_only_shdr = shdr;
+    previous_slice_header = shdr;
+
+    nal_parser.free_NAL_unit(nal);
+    return DE265_OK;
+  }
+
+
+  // --- skip pictures that are not required to reach the seek target ---
+
+  if (seek_skip_picture) {
+    nal_parser.free_NAL_unit(nal);
+    delete shdr;
+    return DE265_OK;
+  }
+
+
   if (process_slice_segment_header(shdr, &err, nal->pts, &nal_hdr, nal->user_data) == false)
     {
       if (img!=NULL) img->integrity = INTEGRITY_NOT_DECODED;
@@ -644,6 +983,12 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
       return err;
     }
 
+  if (shdr->first_slice_segment_in_pic_flag &&
+      isIRAP(nal_unit_type) &&
+      stream_position_known) {
+    add_picture_index_entry(shdr, nal, &nal_hdr, img->PicOrderCntVal);
+  }
+
   this->img->add_slice_segment_header(shdr);
 
   skip_bits(&reader,1); // TODO: why?
@@ -658,6 +1003,10 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
                                                                  headerLength);
   }
 
+  if (header_start) {
+    add_pending_stage_time(DE265_STAGE_SLICE_HEADER, header_start);
+  }
+
 
 
   // --- start a new image if this is the first slice ---
@@ -665,10 +1014,44 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
   if (shdr->first_slice_segment_in_pic_flag) {
     image_unit* imgunit = new image_unit;
     imgunit->img = this->img;
+    imgunit->temporal_id = nal_hdr.nuh_temporal_id;
+
+    // Sub-layer non-reference pictures may still be referenced from higher sub-layers.
+    // Compare against the highest sub-layer of the stream, not the highest decoded one,
+    // because the decoder may switch up to higher sub-layers later.
+
+    if (isSublayerNonReference(nal_hdr.nal_unit_type) &&
+        nal_hdr.nuh_temporal_id >= get_highest_TID()) {
+      imgunit->role = image_unit::Leaf;
+    }
+    else {
+      imgunit->role = image_unit::Reference;
+    }
+
+    imgunit->skip_filters = skip_postprocessing_filters(imgunit);
+
+    if (!imgunit->skip_filters) {
+      start_postprocessing_filters(imgunit);
+    }
+
+    select_ROI_tiles(imgunit);
+
+    imgunit->img->reset_stage_times();
+
     image_units.push_back(imgunit);
   }
 
 
+  // --- the NALs parsed so far and this slice header belong to the current picture ---
+
+  if (header_start) {
+    for (int i=0;i<DE265_NUMBER_OF_DECODE_STAGES;i++) {
+      img->add_stage_time((enum de265_decode_stage)i, pending_stage_time[i]);
+      pending_stage_time[i] = 0;
+    }
+  }
+
+
   // --- add slice to current picture ---
 
   if ( ! image_units.empty() ) {
@@ -682,11 +1065,18 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
 
 
     image_units.back()->slice_units.push_back(sliceunit);
+    image_units.back()->img->last_NAL_arrival_time = nal->arrival_time;
   }
 
   bool did_work;
   err = decode_some(&did_work);
 
+  // a picture that was completed here may have failed its hash check
+
+  if (err == DE265_ERROR_CHECKSUM_MISMATCH) {
+    return err;
+  }
+
   return DE265_OK;
 }
 
@@ -740,11 +1130,16 @@ de265_error decoder_context::decode_some(bool* did_work)
 
   // if we decoded all slices of the current image and there will not
   // be added any more slices to the image, output the image
+  // (in low-latency mode, already when the last CTB has been decoded and no complete
+  // NAL is waiting, which could still be a suffix SEI of this picture)
 
   if ( ( image_units.size()>=2 && image_units[0]->all_slice_segments_processed()) ||
        ( image_units.size()>=1 && image_units[0]->all_slice_segments_processed() &&
          nal_parser.number_of_NAL_units_pending()==0 &&
-         (nal_parser.is_end_of_stream() || nal_parser.is_end_of_frame()) )) {
+         (nal_parser.is_end_of_stream() || nal_parser.is_end_of_frame()) ) ||
+       ( image_units.size()>=1 && image_units[0]->all_slice_segments_processed() &&
+         param_low_latency_output && image_units[0]->end_of_picture_decoded &&
+         nal_parser.get_NAL_queue_length()==0 )) {
 
     image_unit* imgunit = image_units[0];
 
@@ -763,19 +1158,52 @@ de265_error decoder_context::decode_some(bool* did_work)
 
     // run post-processing filters (deblocking & SAO)
 
-    if (img->decctx->num_worker_threads)
-      run_postprocessing_filters_parallel(imgunit);
-    else
-      run_postprocessing_filters_sequential(imgunit->img);
+    bool skip_filters = imgunit->skip_filters;
+
+    if (!skip_filters) {
+      if (imgunit->parallel_filters)
+        run_postprocessing_filters_parallel(imgunit);
+      else
+        run_postprocessing_filters_sequential(imgunit->img);
+    }
 
-    // process suffix SEIs
+    if (row_callback) {
+      report_remaining_CTB_rows(imgunit);
+    }
 
-    for (int i=0;i<imgunit->suffix_SEIs.size();i++) {
-      const sei_message& sei = imgunit->suffix_SEIs[i];
+    // replicate the picture borders for motion compensation in later pictures
 
-      err = process_sei(&sei, imgunit->img);
-      if (err != DE265_OK)
-        break;
+    imgunit->img->extend_borders();
+
+
+    // process suffix SEIs (the picture hash does not match without the in-loop filters)
+    // With worker threads, the picture hash is checked while decoding continues.
+
+    if (!skip_filters) {
+      for (int i=0;i<imgunit->suffix_SEIs.size();i++) {
+        const sei_message& sei = imgunit->suffix_SEIs[i];
+
+        if (sei.payload_type == sei_payload_type_decoded_picture_hash &&
+            param_sei_check_hash && num_worker_threads > 0) {
+          start_hash_check(&sei, imgunit->img);
+          continue;
+        }
+
+        err = process_sei(&sei, imgunit->img);
+        if (err != DE265_OK)
+          break;
+      }
+    }
+
+
+    // later pictures only access the motion field at 16x16 granularity (TMVP)
+
+    if (!param_keep_full_motion_field) {
+      dpb.compress_motion_field(imgunit->img);
+    }
+
+    if (param_stage_timing) {
+      account_stage_times(imgunit->img);
     }
 
 
@@ -811,23 +1239,28 @@ de265_error decoder_context::decode_slice_unit_sequential(image_unit* imgunit,
   }
 
 
-  struct thread_context tctx;
+  err = sliceunit->allocate_thread_contexts(1);
+  if (err != DE265_OK) {
+    return err;
+  }
+
+  thread_context* tctx = sliceunit->get_thread_context(0);
 
-  tctx.shdr = sliceunit->shdr;
-  tctx.img  = imgunit->img;
-  tctx.decctx = this;
-  tctx.imgunit = imgunit;
-  tctx.sliceunit= sliceunit;
-  tctx.CtbAddrInTS = imgunit->img->get_pps().CtbAddrRStoTS[tctx.shdr->slice_segment_address];
-  tctx.task = NULL;
+  tctx->shdr = sliceunit->shdr;
+  tctx->img  = imgunit->img;
+  tctx->decctx = this;
+  tctx->imgunit = imgunit;
+  tctx->sliceunit= sliceunit;
+  tctx->CtbAddrInTS = imgunit->img->get_pps().CtbAddrRStoTS[tctx->shdr->slice_segment_address];
+  tctx->task = NULL;
 
-  init_thread_context(&tctx);
+  init_thread_context(tctx);
 
   if (sliceunit->reader.bytes_remaining <= 0) {
     return DE265_ERROR_PREMATURE_END_OF_SLICE;
   }
 
-  init_CABAC_decoder(&tctx.cabac_decoder,
+  init_CABAC_decoder(&tctx->cabac_decoder,
                      sliceunit->reader.data,
                      sliceunit->reader.bytes_remaining);
 
@@ -840,7 +1273,9 @@ de265_error decoder_context::decode_slice_unit_sequential(image_unit* imgunit,
 
   sliceunit->nThreads=1;
 
-  err=read_slice_segment_data(&tctx);
+  begin_slice_data_timing(tctx);
+  err=read_slice_segment_data(tctx);
+  end_slice_data_timing(tctx);
 
   sliceunit->finished_threads.set_progress(1);
 
@@ -878,6 +1313,37 @@ void decoder_context::mark_whole_slice_as_processed(image_unit* imgunit,
 }
 
 
+/* Mark all CTBs in the first 'nRows' CTB rows as decoded. This is done for the rows
+   that precede the slice segment and for the rows completed by its decoding tasks.
+   After decoding errors or with missing slice segments, some of these CTBs may not
+   have been marked, and the filter tasks waiting for them would never finish.
+ */
+void decoder_context::mark_CTB_rows_decoded(image_unit* imgunit, int nRows)
+{
+  de265_image* img = imgunit->img;
+  const int ctbW = img->get_sps().PicWidthInCtbsY;
+
+  for (int ctb=imgunit->num_prefilter_rows_marked*ctbW; ctb<nRows*ctbW; ctb++) {
+    img->ctb_progress[ctb].set_progress(CTB_PROGRESS_PREFILTER);
+  }
+
+  imgunit->num_prefilter_rows_marked = libde265_max(imgunit->num_prefilter_rows_marked,
+                                                    nRows);
+}
+
+
+/* Wait until the decoding tasks of the slice segment have finished and mark the CTB rows
+   before 'nRowsDecoded' as decoded.
+ */
+void decoder_context::wait_for_slice_decoding_tasks(image_unit* imgunit, slice_unit* sliceunit,
+                                                   int nRowsDecoded)
+{
+  sliceunit->finished_threads.wait_for_progress(sliceunit->nThreads);
+
+  mark_CTB_rows_decoded(imgunit, nRowsDecoded);
+}
+
+
 de265_error decoder_context::decode_slice_unit_parallel(image_unit* imgunit,
                                                         slice_unit* sliceunit)
 {
@@ -942,9 +1408,24 @@ de265_error decoder_context::decode_slice_unit_parallel(image_unit* imgunit,
   // as a background thread
   if (!use_WPP && !use_tiles) {
     //printf("SEQ\n");
+
+    // filter the rows of the previous slice segments while this one is decoded
+
+    int ctbsWidth = img->get_sps().PicWidthInCtbsY;
+    int nRowsDecoded = sliceunit->shdr->slice_segment_address / ctbsWidth;
+    mark_CTB_rows_decoded(imgunit, nRowsDecoded);
+    add_postprocessing_tasks(imgunit, nRowsDecoded);
+
     err = decode_slice_unit_sequential(imgunit, sliceunit);
     sliceunit->state = slice_unit::Decoded;
     mark_whole_slice_as_processed(imgunit,sliceunit,CTB_PROGRESS_PREFILTER);
+
+    img->wait_for_completion();
+
+    for (int i=0;i<(int)imgunit->tasks.size();i++)
+      delete imgunit->tasks[i];
+    imgunit->tasks.clear();
+
     return err;
   }
 
@@ -1000,13 +1481,20 @@ de265_error decoder_context::decode_slice_unit_WPP(image_unit* imgunit,
   }
 
 
-  sliceunit->allocate_thread_contexts(nRows);
+  err = sliceunit->allocate_thread_contexts(nRows);
+  if (err != DE265_OK) {
+    return err;
+  }
 
 
   // first CTB in this slice
   int ctbAddrRS = shdr->slice_segment_address;
   int ctbRow    = ctbAddrRS / ctbsWidth;
 
+  // CTB rows that are completely decoded when the tasks queued so far are finished
+  int nRowsDecoded = ctbRow;
+  mark_CTB_rows_decoded(imgunit, nRowsDecoded);
+
   for (int entryPt=0;entryPt<nRows;entryPt++) {
     // entry points other than the first start at CTB rows
     if (entryPt>0) {
@@ -1065,8 +1553,16 @@ de265_error decoder_context::decode_slice_unit_WPP(image_unit* imgunit,
     img->thread_start(1);
     sliceunit->nThreads++;
     add_task_decode_CTB_row(tctx, entryPt==0, ctbRow);
+
+    // interleave the filter tasks with the decoding (the slice segment may end within
+    // the last row)
+
+    nRowsDecoded = ctbRow;
+    add_postprocessing_tasks(imgunit, nRowsDecoded);
   }
 
+  wait_for_slice_decoding_tasks(imgunit, sliceunit, nRowsDecoded);
+
 #if 0
   for (;;) {
     printf("q:%d r:%d b:%d f:%d\n",
@@ -1105,13 +1601,21 @@ de265_error decoder_context::decode_slice_unit_tiles(image_unit* imgunit,
 
   assert(img->num_threads_active() == 0);
 
-  sliceunit->allocate_thread_contexts(nTiles);
+  err = sliceunit->allocate_thread_contexts(nTiles);
+  if (err != DE265_OK) {
+    return err;
+  }
 
 
   // first CTB in this slice
   int ctbAddrRS = shdr->slice_segment_address;
   int tileID = pps.TileIdRS[ctbAddrRS];
 
+  // CTB rows that are completely decoded when the tasks queued so far are finished
+  // (the slice segment may end within the last tile)
+  int nRowsDecoded = pps.rowBd[tileID / pps.num_tile_columns];
+  mark_CTB_rows_decoded(imgunit, nRowsDecoded);
+
   for (int entryPt=0;entryPt<nTiles;entryPt++) {
     // entry points other than the first start at tile beginnings
     if (entryPt>0) {
@@ -1127,9 +1631,25 @@ de265_error decoder_context::decode_slice_unit_tiles(image_unit* imgunit,
       ctbAddrRS = ctbY * ctbsWidth + ctbX;
     }
 
-    // set thread context
+    nRowsDecoded = pps.rowBd[tileID / pps.num_tile_columns];
 
-    thread_context* tctx = sliceunit->get_thread_context(entryPt);
+    // skip tiles outside of the region of interest
+
+    if (!imgunit->is_tile_decoded(tileID)) {
+      // Slice segments spanning several tiles contain complete tiles.
+      if (nTiles>1 && tileID == pps.num_tile_columns * pps.num_tile_rows - 1) {
+        imgunit->end_of_picture_decoded = true;
+      }
+
+      // the filters of the surrounding rows must not wait for this tile
+      img->mark_tile_CTB_progress(tileID, CTB_PROGRESS_PREFILTER);
+
+      continue;
+    }
+
+    // set thread context
+
+    thread_context* tctx = sliceunit->get_thread_context(entryPt);
 
     tctx->shdr   = shdr;
     tctx->decctx = img->decctx;
@@ -1169,8 +1689,13 @@ de265_error decoder_context::decode_slice_unit_tiles(image_unit* imgunit,
     add_task_decode_slice_segment(tctx, entryPt==0,
                                   ctbAddrRS % ctbsWidth,
                                   ctbAddrRS / ctbsWidth);
+
+    // interleave the filter tasks with the decoding
+    add_postprocessing_tasks(imgunit, nRowsDecoded);
   }
 
+  wait_for_slice_decoding_tasks(imgunit, sliceunit, nRowsDecoded);
+
   img->wait_for_completion();
 
   for (int i=0;i<imgunit->tasks.size();i++)
@@ -1181,6 +1706,21 @@ de265_error decoder_context::decode_slice_unit_tiles(image_unit* imgunit,
 }
 
 
+/* Whether 'nal' is the first slice segment of a picture. This reads the
+   first_slice_segment_in_pic_flag (the first bit after the NAL header) before
+   the slice header is parsed. Reserved VCL NAL unit types are no slices.
+ */
+static bool is_first_slice_of_picture(const NAL_unit* nal, const nal_header& nal_hdr)
+{
+  int type = nal_hdr.nal_unit_type;
+
+  bool isSlice = (type <= NAL_UNIT_RASL_R ||
+                  (type >= NAL_UNIT_BLA_W_LP && type <= NAL_UNIT_CRA_NUT));
+
+  return isSlice && nal->size()>2 && (nal->data()[2] & 0x80);
+}
+
+
 de265_error decoder_context::decode_NAL(NAL_unit* nal)
 {
   //return decode_NAL_OLD(nal);
@@ -1196,6 +1736,8 @@ de265_error decoder_context::decode_NAL(NAL_unit* nal)
   nal_hdr.read(&reader);
   ctx->process_nal_hdr(&nal_hdr);
 
+  update_access_unit_offset(nal, nal_hdr);
+
   if (nal_hdr.nuh_layer_id > 0) {
     // Discard all NAL units with nuh_layer_id > 0
     // These will have to be handeled by an SHVC decoder.
@@ -1215,6 +1757,29 @@ de265_error decoder_context::decode_NAL(NAL_unit* nal)
     nal_hdr.nuh_temporal_id);
   */
 
+  // count the pictures of the stream for the real-time governor, and switch up to
+  // a higher temporal layer at switching points when the governor deferred this
+
+  if (is_first_slice_of_picture(nal, nal_hdr)) {
+    realtime_count_picture();
+
+    if (goal_HighestTid > current_HighestTid) {
+      int type = nal_hdr.nal_unit_type;
+
+      if (isIRAP(type)) {
+        current_HighestTid = goal_HighestTid;
+      }
+      else if (nal_hdr.nuh_temporal_id == current_HighestTid+1) {
+        if (type==NAL_UNIT_TSA_N || type==NAL_UNIT_TSA_R) {
+          current_HighestTid = goal_HighestTid;
+        }
+        else if (type==NAL_UNIT_STSA_N || type==NAL_UNIT_STSA_R) {
+          current_HighestTid = nal_hdr.nuh_temporal_id;
+        }
+      }
+    }
+  }
+
   // throw away NALs from higher TIDs than currently selected
   // TODO: better online switching of HighestTID
 
@@ -1226,6 +1791,22 @@ de265_error decoder_context::decode_NAL(NAL_unit* nal)
   }
 
 
+  // in keyframes-only mode, drop all pictures that are not IRAP pictures
+
+  if (param_keyframes_only && nal_hdr.nal_unit_type<32) {
+    if (!isIRAP(nal_hdr.nal_unit_type)) {
+      nal_parser.free_NAL_unit(nal);
+      return DE265_OK;
+    }
+
+    // the pictures preceding a CRA picture are missing, decode it like a BLA picture
+    if (nal_hdr.nal_unit_type == NAL_UNIT_CRA_NUT &&
+        is_first_slice_of_picture(nal, nal_hdr)) {
+      HandleCraAsBlaFlag = true;
+    }
+  }
+
+
   if (nal_hdr.nal_unit_type<32) {
     err = read_slice_NAL(reader, nal, nal_hdr);
   }
@@ -1247,7 +1828,9 @@ de265_error decoder_context::decode_NAL(NAL_unit* nal)
 
     case NAL_UNIT_PREFIX_SEI_NUT:
     case NAL_UNIT_SUFFIX_SEI_NUT:
-      err = read_sei_NAL(reader, nal_hdr.nal_unit_type==NAL_UNIT_SUFFIX_SEI_NUT);
+      if (!param_headers_only && !param_keyframes_only) {
+        err = read_sei_NAL(reader, nal_hdr.nal_unit_type==NAL_UNIT_SUFFIX_SEI_NUT);
+      }
       nal_parser.free_NAL_unit(nal);
       break;
 
@@ -1266,15 +1849,45 @@ de265_error decoder_context::decode_NAL(NAL_unit* nal)
 
 
 de265_error decoder_context::decode(int* more)
+{
+  if (realtime_frame_interval == 0) {
+    return decode_next(more);
+  }
+
+  // measure the decoding time for the real-time governor
+
+  int64_t start = monotonic_time_us();
+  de265_error err = decode_next(more);
+  realtime_busy_time += monotonic_time_us() - start;
+
+  return err;
+}
+
+
+de265_error decoder_context::decode_next(int* more)
 {
   decoder_context* ctx = this;
 
+  // report hash mismatches of the pictures checked in the background
+
+  de265_error hash_err = finish_hash_checks(MAX_PENDING_HASH_CHECKS);
+  if (hash_err != DE265_OK) {
+    if (more) { *more = 0; }
+    return hash_err;
+  }
+
   // if the stream has ended, and no more NALs are to be decoded, flush all pictures
 
   if (ctx->nal_parser.get_NAL_queue_length() == 0 &&
       (ctx->nal_parser.is_end_of_stream() || ctx->nal_parser.is_end_of_frame()) &&
       ctx->image_units.empty()) {
 
+    hash_err = finish_hash_checks(0);
+    if (hash_err != DE265_OK) {
+      if (more) { *more = 0; }
+      return hash_err;
+    }
+
     // flush all pending pictures into output queue
 
     // ctx->push_current_picture_to_output_queue(); // TODO: not with new queue
@@ -1301,7 +1914,8 @@ de265_error decoder_context::decode(int* more)
   // when there are no free image buffers in the DPB, pause decoding
   // -> output stalled
 
-  if (!ctx->dpb.has_free_dpb_picture(false)) {
+  if (!ctx->dpb.has_free_dpb_picture(false) ||
+      !ctx->has_memory_for_next_picture()) {
     if (more) *more = 1;
     return DE265_ERROR_IMAGE_BUFFER_FULL;
   }
@@ -1349,8 +1963,10 @@ void decoder_context::process_nal_hdr(nal_header* nal)
 
 
 /* 8.3.1
+   Returns PicOrderCntVal of the current picture.
  */
-void decoder_context::process_picture_order_count(slice_segment_header* hdr)
+int decoder_context::process_picture_order_count(slice_segment_header* hdr,
+                                                 int nuh_temporal_id)
 {
   loginfo(LogHeaders,"POC computation. lsb:%d prev.pic.lsb:%d msb:%d\n",
           hdr->slice_pic_order_cnt_lsb,
@@ -1385,14 +2001,13 @@ void decoder_context::process_picture_order_count(slice_segment_header* hdr)
       }
     }
 
-  img->PicOrderCntVal = PicOrderCntMsb + hdr->slice_pic_order_cnt_lsb;
-  img->picture_order_cnt_lsb = hdr->slice_pic_order_cnt_lsb;
+  int PicOrderCntVal = PicOrderCntMsb + hdr->slice_pic_order_cnt_lsb;
 
   loginfo(LogHeaders,"POC computation. new msb:%d POC=%d\n",
           PicOrderCntMsb,
-          img->PicOrderCntVal);
+          PicOrderCntVal);
 
-  if (img->nal_hdr.nuh_temporal_id==0 &&
+  if (nuh_temporal_id==0 &&
       !isSublayerNonReference(nal_unit_type) &&
       !isRASL(nal_unit_type) &&
       !isRADL(nal_unit_type))
@@ -1402,6 +2017,8 @@ void decoder_context::process_picture_order_count(slice_segment_header* hdr)
       prevPicOrderCntLsb = hdr->slice_pic_order_cnt_lsb;
       prevPicOrderCntMsb = PicOrderCntMsb;
     }
+
+  return PicOrderCntVal;
 }
 
 
@@ -1876,8 +2493,16 @@ void decoder_context::run_postprocessing_filters_sequential(de265_image* img)
     write_picture_to_file(img, buf);
 #endif
 
+    int64_t start = (param_stage_timing ? monotonic_time_ns() : 0);
+
     if (!img->decctx->param_disable_deblocking) {
       apply_deblocking_filter(img);
+
+      if (start) {
+        int64_t now = monotonic_time_ns();
+        img->add_stage_time(DE265_STAGE_DEBLOCKING, now - start);
+        start = now;
+      }
     }
 
 #if SAVE_INTERMEDIATE_IMAGES
@@ -1887,6 +2512,10 @@ void decoder_context::run_postprocessing_filters_sequential(de265_image* img)
 
     if (!img->decctx->param_disable_sao) {
       apply_sample_adaptive_offset_sequential(img);
+
+      if (start) {
+        img->add_stage_time(DE265_STAGE_SAO, monotonic_time_ns() - start);
+      }
     }
 
 #if SAVE_INTERMEDIATE_IMAGES
@@ -1896,24 +2525,114 @@ void decoder_context::run_postprocessing_filters_sequential(de265_image* img)
 }
 
 
-void decoder_context::run_postprocessing_filters_parallel(image_unit* imgunit)
+bool decoder_context::skip_postprocessing_filters(const image_unit* imgunit) const
+{
+  if ((param_skip_filters_non_reference || realtime_skip_filters) &&
+      imgunit->role == image_unit::Leaf) {
+    return true;
+  }
+
+  if (param_skip_filters_min_TID >= 0 &&
+      imgunit->temporal_id >= param_skip_filters_min_TID) {
+    return true;
+  }
+
+  return false;
+}
+
+
+/* Decide when the picture is started whether deblocking and SAO run in the worker threads,
+   so that their tasks can be queued while the picture is decoded.
+ */
+void decoder_context::start_postprocessing_filters(image_unit* imgunit)
 {
   de265_image* img = imgunit->img;
 
+  imgunit->parallel_filters = (num_worker_threads > 0);
+
+  // Parallel SAO needs a full output picture. If there is none in the image pool and
+  // allocating it exceeds the memory budget, filter sequentially and in-place instead.
+
+  if (imgunit->parallel_filters &&
+      img->get_sps().sample_adaptive_offset_enabled_flag &&
+      !param_disable_sao &&
+      !dpb.has_sao_output_image(img->get_sps()) &&
+      !memory_budget_allows(img->get_pixel_memory_size())) {
+    imgunit->parallel_filters = false;
+    num_memory_degradations++;
+  }
+
+  if (imgunit->parallel_filters) {
+    imgunit->deblocking_tasks = !param_disable_deblocking;
+    imgunit->sao_tasks = (!param_disable_sao && alloc_sao_output(imgunit));
+  }
+}
+
+
+/* Number of CTB rows that a filter stage can process when 'nInputRows' rows of its
+   input are finished. Each row also needs the row below.
+ */
+static int filter_rows_ready(int nInputRows, int nRows)
+{
+  return (nInputRows >= nRows ? nRows : libde265_max(nInputRows-1, 0));
+}
+
+
+/* Queue the filter tasks of all CTB rows that only depend on the first 'nRowsDecoded'
+   CTB rows. These rows have to be decoded by the tasks queued so far (or the main thread),
+   so that no filter task blocks a worker thread while the decoding of its input is still
+   waiting in the task queue behind it.
+ */
+void decoder_context::add_postprocessing_tasks(image_unit* imgunit, int nRowsDecoded)
+{
+  if (!imgunit->parallel_filters) {
+    return;
+  }
+
+  const int nRows = imgunit->img->get_sps().PicHeightInCtbsY;
+
+  int nInputRows = nRowsDecoded;
   int saoWaitsForProgress = CTB_PROGRESS_PREFILTER;
-  bool waitForCompletion = false;
 
-  if (!img->decctx->param_disable_deblocking) {
-    add_deblocking_tasks(imgunit);
+  if (imgunit->deblocking_tasks) {
+    int nV = filter_rows_ready(nInputRows, nRows);
+    add_deblocking_tasks(imgunit, true, imgunit->num_deblk_V_rows_queued, nV);
+    imgunit->num_deblk_V_rows_queued = libde265_max(imgunit->num_deblk_V_rows_queued, nV);
+
+    int nH = filter_rows_ready(imgunit->num_deblk_V_rows_queued, nRows);
+    add_deblocking_tasks(imgunit, false, imgunit->num_deblk_H_rows_queued, nH);
+    imgunit->num_deblk_H_rows_queued = libde265_max(imgunit->num_deblk_H_rows_queued, nH);
+
+    nInputRows = imgunit->num_deblk_H_rows_queued;
     saoWaitsForProgress = CTB_PROGRESS_DEBLK_H;
   }
 
-  if (!img->decctx->param_disable_sao) {
-    waitForCompletion |= add_sao_tasks(imgunit, saoWaitsForProgress);
-    //apply_sample_adaptive_offset(img);
+  if (imgunit->sao_tasks) {
+    int nSAO = filter_rows_ready(nInputRows, nRows);
+    add_sao_tasks(imgunit, saoWaitsForProgress, imgunit->num_sao_rows_queued, nSAO);
+    imgunit->num_sao_rows_queued = libde265_max(imgunit->num_sao_rows_queued, nSAO);
   }
+}
+
+
+void decoder_context::run_postprocessing_filters_parallel(image_unit* imgunit)
+{
+  de265_image* img = imgunit->img;
+
+  add_postprocessing_tasks(imgunit, img->get_sps().PicHeightInCtbsY);
 
   img->wait_for_completion();
+
+  for (int i=0;i<(int)imgunit->tasks.size();i++)
+    delete imgunit->tasks[i];
+  imgunit->tasks.clear();
+
+  if (imgunit->sao_tasks) {
+    img->exchange_pixel_data_with(*imgunit->sao_output);
+
+    dpb.return_sao_output_image(imgunit->sao_output);
+    imgunit->sao_output = NULL;
+  }
 }
 
 /*
@@ -1923,6 +2642,340 @@ void decoder_context::push_current_picture_to_output_queue()
 }
 */
 
+void decoder_context::pop_next_picture_in_output_queue()
+{
+  const de265_image* outimg = dpb.get_next_picture_in_output_queue();
+
+  // pictures decoded from NALs that have been pushed into the decoder
+  if (outimg->last_NAL_arrival_time > 0) {
+    int64_t latency = outimg->output_time - outimg->last_NAL_arrival_time;
+
+    latency_num_pictures++;
+    latency_last = latency;
+    latency_sum += latency;
+    latency_max = libde265_max(latency_max, latency);
+  }
+
+  dpb.pop_next_picture_in_output_queue();
+}
+
+
+void decoder_context::set_thread_tracing(bool enable)
+{
+  thread_trace* trace = (enable ? &thread_trace_ : NULL);
+
+  if (num_worker_threads>0) {
+    de265_mutex_lock(&thread_pool_.mutex);
+    thread_pool_.trace = trace;
+    de265_mutex_unlock(&thread_pool_.mutex);
+  }
+  else {
+    thread_pool_.trace = trace;
+  }
+}
+
+
+de265_error decoder_context::write_thread_trace(const char* filename)
+{
+  FILE* fh = fopen(filename,"wb");
+  if (fh==NULL) {
+    return DE265_ERROR_NO_SUCH_FILE;
+  }
+
+  bool success = thread_trace_.write_chrome_trace(fh, true);
+  success &= (fclose(fh)==0);
+
+  return success ? DE265_OK : DE265_ERROR_NO_SUCH_FILE;
+}
+
+
+void decoder_context::account_stage_times(const de265_image* img)
+{
+  stats_num_pictures++;
+
+  for (int i=0;i<DE265_NUMBER_OF_DECODE_STAGES;i++) {
+    stats_last_picture[i] = img->stage_time[i];
+    stats_total[i] += stats_last_picture[i];
+  }
+}
+
+
+void decoder_context::start_hash_check(const sei_message* sei, de265_image* img)
+{
+  sei_hash_check* check = new sei_hash_check(sei, img);
+  check->start(&thread_pool_);
+
+  pending_hash_checks.push_back(check);
+}
+
+
+de265_error decoder_context::finish_hash_checks(int max_pending)
+{
+  de265_error err = DE265_OK;
+
+  while (!pending_hash_checks.empty() &&
+         ((int)pending_hash_checks.size() > max_pending ||
+          pending_hash_checks.front()->is_finished())) {
+    sei_hash_check* check = pending_hash_checks.front();
+    pending_hash_checks.pop_front();
+
+    de265_error check_err = check->get_result();
+    if (err == DE265_OK) {
+      err = check_err;
+    }
+
+    // the picture has already been accounted, add the hash time to the totals only
+
+    if (param_stage_timing) {
+      stats_total[DE265_STAGE_HASH_CHECK] += check->get_hash_time();
+    }
+
+    delete check;
+  }
+
+  return err;
+}
+
+
+void decoder_context::discard_hash_checks()
+{
+  while (!pending_hash_checks.empty()) {
+    delete pending_hash_checks.front();
+    pending_hash_checks.pop_front();
+  }
+}
+
+
+void decoder_context::get_statistics(de265_statistics* stats) const
+{
+  stats->num_pictures = stats_num_pictures;
+
+  for (int i=0;i<DE265_NUMBER_OF_DECODE_STAGES;i++) {
+    stats->last_picture_ns[i] = stats_last_picture[i];
+    stats->total_ns[i]        = stats_total[i];
+  }
+}
+
+
+void decoder_context::reset_statistics()
+{
+  stats_num_pictures = 0;
+
+  for (int i=0;i<DE265_NUMBER_OF_DECODE_STAGES;i++) {
+    pending_stage_time[i] = 0;
+    stats_last_picture[i] = 0;
+    stats_total[i] = 0;
+  }
+}
+
+
+void decoder_context::get_latency_statistics(de265_latency_statistics* stats) const
+{
+  stats->num_pictures = latency_num_pictures;
+  stats->last_us      = latency_last;
+  stats->average_us   = (latency_num_pictures ? latency_sum / latency_num_pictures : 0);
+  stats->max_us       = latency_max;
+}
+
+
+void decoder_context::reset_latency_statistics()
+{
+  latency_num_pictures = 0;
+  latency_last = 0;
+  latency_sum  = 0;
+  latency_max  = 0;
+}
+
+
+void decoder_context::set_row_callback(de265_row_callback callback, void* userdata)
+{
+  row_callback = callback;
+  row_callback_userdata = userdata;
+}
+
+
+int decoder_context::final_CTB_progress(const image_unit* imgunit) const
+{
+  const seq_parameter_set& sps = imgunit->img->get_sps();
+
+  if (imgunit->skip_filters) {
+    return CTB_PROGRESS_PREFILTER;
+  }
+  else if (sps.sample_adaptive_offset_enabled_flag && !param_disable_sao) {
+    return CTB_PROGRESS_SAO;
+  }
+  else if (!param_disable_deblocking) {
+    return CTB_PROGRESS_DEBLK_H;
+  }
+  else {
+    return CTB_PROGRESS_PREFILTER;
+  }
+}
+
+
+void decoder_context::report_final_CTB_rows(image_unit* imgunit, const de265_image* pixels,
+                                            int progress)
+{
+  if (progress != final_CTB_progress(imgunit)) {
+    return;
+  }
+
+  const de265_image* img = imgunit->img;
+  const seq_parameter_set& sps = img->get_sps();
+  const int ctbW = sps.PicWidthInCtbsY;
+  const int ctbH = sps.PicHeightInCtbsY;
+
+  std::lock_guard<std::mutex> lock(row_callback_mutex);
+
+  int nRows = imgunit->num_final_CTB_rows;
+  while (nRows < ctbH) {
+    bool final = true;
+
+    if (progress == CTB_PROGRESS_PREFILTER) {
+      // CTBs are decoded individually (possibly in several tiles)
+      for (int x=0;x<ctbW && final;x++) {
+        final = (img->ctb_progress[x+nRows*ctbW].get_progress() >= progress);
+      }
+    }
+    else {
+      // filters process whole rows
+      final = (img->ctb_progress[ctbW-1 + nRows*ctbW].get_progress() >= progress);
+
+      // deblocking the next row modifies the bottom of this row
+      if (final && progress == CTB_PROGRESS_DEBLK_H && nRows+1 < ctbH) {
+        final = (img->ctb_progress[ctbW-1 + (nRows+1)*ctbW].get_progress() >= progress);
+      }
+    }
+
+    if (!final) {
+      break;
+    }
+
+    nRows++;
+  }
+
+  call_row_callback(imgunit, pixels, nRows);
+}
+
+
+void decoder_context::report_remaining_CTB_rows(image_unit* imgunit)
+{
+  std::lock_guard<std::mutex> lock(row_callback_mutex);
+
+  call_row_callback(imgunit, imgunit->img, imgunit->img->get_sps().PicHeightInCtbsY);
+}
+
+
+void decoder_context::call_row_callback(image_unit* imgunit, const de265_image* pixels,
+                                        int nRows)
+{
+  if (nRows <= imgunit->num_final_CTB_rows) {
+    return;
+  }
+
+  const de265_image* img = imgunit->img;
+  const seq_parameter_set& sps = img->get_sps();
+
+  // convert to rows of the visible picture
+
+  int top = sps.conf_win_top_offset * sps.SubHeightC;
+
+  int y_start = imgunit->num_final_CTB_rows * sps.CtbSizeY - top;
+  int y_end   = nRows * sps.CtbSizeY - top;
+
+  y_start = Clip3(0, img->height_confwin, y_start);
+  y_end   = Clip3(0, img->height_confwin, y_end);
+
+  imgunit->num_final_CTB_rows = nRows;
+
+  if (y_end > y_start && img->PicOutputFlag) {
+    row_callback(row_callback_userdata, pixels, y_start, y_end);
+  }
+}
+
+
+void decoder_context::set_region_of_interest(int x, int y, int width, int height, int margin)
+{
+  roi_x = x;
+  roi_y = y;
+  roi_width  = libde265_max(width, 0);
+  roi_height = libde265_max(height,0);
+  roi_margin = libde265_max(margin,0);
+
+  roi_tiles.clear();
+}
+
+
+void decoder_context::set_region_of_interest_tiles(const int* tile_indices, int num_tiles)
+{
+  roi_width = roi_height = 0;
+
+  roi_tiles.assign(tile_indices, tile_indices + libde265_max(num_tiles,0));
+}
+
+
+void decoder_context::select_ROI_tiles(image_unit* imgunit) const
+{
+  const pic_parameter_set& pps = imgunit->img->get_pps();
+  const seq_parameter_set& sps = imgunit->img->get_sps();
+
+  imgunit->img->decoded_tiles.clear();
+
+  if (!pps.tiles_enabled_flag) {
+    return;
+  }
+
+  // With WPP, each tile has one entry point per CTB row. Skipping tiles assumes one
+  // entry point per tile, hence decode the whole picture in this case.
+
+  if (pps.entropy_coding_sync_enabled_flag) {
+    return;
+  }
+
+  int nTiles = pps.num_tile_columns * pps.num_tile_rows;
+  std::vector<bool>& decoded_tiles = imgunit->img->decoded_tiles;
+
+  if (!roi_tiles.empty()) {
+    decoded_tiles.resize(nTiles, false);
+
+    for (int i=0;i<(int)roi_tiles.size();i++) {
+      if (roi_tiles[i] >= 0 && roi_tiles[i] < nTiles) {
+        decoded_tiles[ roi_tiles[i] ] = true;
+      }
+    }
+  }
+  else if (roi_width > 0 && roi_height > 0) {
+    // Deblocking modifies up to 3 samples at a tile boundary and SAO reads one sample
+    // further. When the loop filters cross tile boundaries, the tiles within this reach
+    // are decoded as well, so that the filtered region equals the one of a full decode.
+
+    int margin = roi_margin + (pps.loop_filter_across_tiles_enabled_flag ? 4 : 0);
+
+    // region in CTBs of the coded picture (including the area cropped by the conformance window)
+
+    int x0 = roi_x + sps.conf_win_left_offset * sps.SubWidthC - margin;
+    int y0 = roi_y + sps.conf_win_top_offset  * sps.SubHeightC - margin;
+    int x1 = x0 + roi_width  + 2*margin - 1;
+    int y1 = y0 + roi_height + 2*margin - 1;
+
+    x0 = libde265_max(x0, 0) >> sps.Log2CtbSizeY;
+    y0 = libde265_max(y0, 0) >> sps.Log2CtbSizeY;
+    x1 = libde265_min(x1, sps.pic_width_in_luma_samples -1) >> sps.Log2CtbSizeY;
+    y1 = libde265_min(y1, sps.pic_height_in_luma_samples-1) >> sps.Log2CtbSizeY;
+
+    decoded_tiles.resize(nTiles);
+
+    for (int ty=0; ty<pps.num_tile_rows; ty++)
+      for (int tx=0; tx<pps.num_tile_columns; tx++) {
+        bool inside = (pps.colBd[tx] <= x1 && pps.colBd[tx+1] > x0 &&
+                       pps.rowBd[ty] <= y1 && pps.rowBd[ty+1] > y0);
+
+        decoded_tiles[tx + ty*pps.num_tile_columns] = inside;
+      }
+  }
+}
+
+
 de265_error decoder_context::push_picture_to_output_queue(image_unit* imgunit)
 {
   de265_image* outimg = imgunit->img;
@@ -1965,6 +3018,43 @@ de265_error decoder_context::push_picture_to_output_queue(image_unit* imgunit)
 }
 
 
+void decoder_context::update_NoRaslOutputFlag()
+{
+  if (isIRAP(nal_unit_type)) {
+    if (isIDR(nal_unit_type) ||
+        isBLA(nal_unit_type) ||
+        first_decoded_picture ||
+        FirstAfterEndOfSequenceNAL)
+      {
+        NoRaslOutputFlag = true;
+        FirstAfterEndOfSequenceNAL = false;
+        HandleCraAsBlaFlag = false;
+      }
+    else if (HandleCraAsBlaFlag) // set externally, e.g. in keyframes-only mode
+      {
+        NoRaslOutputFlag   = true;
+        HandleCraAsBlaFlag = false;
+      }
+    else
+      {
+        NoRaslOutputFlag   = false;
+        HandleCraAsBlaFlag = false;
+      }
+  }
+}
+
+
+void decoder_context::set_keyframes_only(bool enable)
+{
+  param_keyframes_only = enable;
+
+  // the next CRA picture follows its leading pictures again
+  if (!enable) {
+    HandleCraAsBlaFlag = false;
+  }
+}
+
+
 // returns whether we can continue decoding the stream or whether we should give up
 bool decoder_context::process_slice_segment_header(slice_segment_header* hdr,
                                                    de265_error* err, de265_PTS pts,
@@ -2007,6 +3097,12 @@ bool decoder_context::process_slice_segment_header(slice_segment_header* hdr,
 
     // --- find and allocate image buffer for decoding ---
 
+    if (param_memory_budget &&
+        !dpb.has_reusable_image(*current_sps) &&
+        !memory_budget_allows(estimate_picture_memory(*current_sps))) {
+      add_warning(DE265_WARNING_MEMORY_BUDGET_EXCEEDED, true);
+    }
+
     int image_buffer_idx;
     bool isOutputImage = (!sps->sample_adaptive_offset_enabled_flag || param_disable_sao);
     image_buffer_idx = dpb.new_image(current_sps, this, pts, user_data, isOutputImage);
@@ -2027,24 +3123,7 @@ bool decoder_context::process_slice_segment_header(slice_segment_header* hdr,
     img->clear_metadata();
 
 
-    if (isIRAP(nal_unit_type)) {
-      if (isIDR(nal_unit_type) ||
-          isBLA(nal_unit_type) ||
-          first_decoded_picture ||
-          FirstAfterEndOfSequenceNAL)
-        {
-          NoRaslOutputFlag = true;
-          FirstAfterEndOfSequenceNAL = false;
-        }
-      else if (0) // TODO: set HandleCraAsBlaFlag by external means
-        {
-        }
-      else
-        {
-          NoRaslOutputFlag   = false;
-          HandleCraAsBlaFlag = false;
-        }
-    }
+    update_NoRaslOutputFlag();
 
 
     if (isRASL(nal_unit_type) &&
@@ -2057,7 +3136,12 @@ bool decoder_context::process_slice_segment_header(slice_segment_header* hdr,
         img->PicOutputFlag = !!hdr->pic_output_flag;
       }
 
-    process_picture_order_count(hdr);
+    if (seek_hide_picture) {
+      img->PicOutputFlag = false;
+    }
+
+    img->PicOrderCntVal = process_picture_order_count(hdr, nal_hdr->nuh_temporal_id);
+    img->picture_order_cnt_lsb = hdr->slice_pic_order_cnt_lsb;
 
     if (hdr->first_slice_segment_in_pic_flag) {
       // mark picture so that it is not overwritten by unavailable reference frames
@@ -2113,6 +3197,231 @@ bool decoder_context::process_slice_segment_header(slice_segment_header* hdr,
 }
 
 
+/* Headers-only mode: record the picture in the picture index instead of decoding it.
+   The POC is derived like in process_slice_segment_header(), but without touching the DPB.
+ */
+void decoder_context::probe_slice_segment_header(slice_segment_header* hdr,
+                                                 const NAL_unit* nal,
+                                                 const nal_header* nal_hdr)
+{
+  if (!hdr->first_slice_segment_in_pic_flag) {
+    if (!picture_index.empty() &&
+        hdr->slice_type < picture_index.back().slice_type) {
+      picture_index.back().slice_type = hdr->slice_type;
+    }
+
+    return;
+  }
+
+  current_pps = pps[ (int)hdr->slice_pic_parameter_set_id ];
+  current_sps = sps[ (int)current_pps->seq_parameter_set_id ];
+
+  update_NoRaslOutputFlag();
+
+  int poc = process_picture_order_count(hdr, nal_hdr->nuh_temporal_id);
+  add_picture_index_entry(hdr, nal, nal_hdr, poc);
+
+  first_decoded_picture = false;
+}
+
+
+void decoder_context::add_picture_index_entry(const slice_segment_header* hdr,
+                                              const NAL_unit* nal,
+                                              const nal_header* nal_hdr,
+                                              int poc)
+{
+  de265_picture_info info;
+  memset(&info, 0, sizeof(info));
+
+  info.stream_offset  = access_unit_offset;
+  info.pts            = nal->pts;
+  info.picture_number = current_picture_number;
+  info.poc            = poc;
+  info.nal_unit_type  = nal_hdr->nal_unit_type;
+  info.temporal_id    = nal_hdr->nuh_temporal_id;
+  info.slice_type     = hdr->slice_type;
+  info.is_irap        = isIRAP(nal_unit_type);
+  info.is_reference   = !isSublayerNonReference(nal_unit_type);
+
+  // referenced POCs, see process_reference_picture_set()
+
+  if (!isIDR(nal_unit_type)) {
+    const ref_pic_set* rps = &hdr->CurrRps;
+    int n=0;
+
+    for (int i=0;i<rps->NumNegativePics;i++) {
+      if (rps->UsedByCurrPicS0[i] && n < DE265_MAX_PICTURE_DEPENDENCIES) {
+        info.dependency_poc[n++] = poc + rps->DeltaPocS0[i];
+      }
+    }
+
+    for (int i=0;i<rps->NumPositivePics;i++) {
+      if (rps->UsedByCurrPicS1[i] && n < DE265_MAX_PICTURE_DEPENDENCIES) {
+        info.dependency_poc[n++] = poc + rps->DeltaPocS1[i];
+      }
+    }
+
+    for (int i=0;i<hdr->num_long_term_sps + hdr->num_long_term_pics;i++) {
+      if (UsedByCurrPicLt[i] && n < DE265_MAX_PICTURE_DEPENDENCIES) {
+        int pocLt = PocLsbLt[i];
+
+        if (hdr->delta_poc_msb_present_flag[i]) {
+          int currentPictureMSB = poc - hdr->slice_pic_order_cnt_lsb;
+          pocLt += currentPictureMSB
+            - DeltaPocMsbCycleLt[i] * current_sps->MaxPicOrderCntLsb;
+        }
+
+        info.dependency_poc[n++] = pocLt;
+      }
+    }
+
+    info.num_dependencies = n;
+  }
+
+  add_picture_info(info);
+}
+
+
+void decoder_context::add_picture_info(const de265_picture_info& info)
+{
+  // usually, pictures are appended at the end
+
+  if (picture_index.empty() ||
+      picture_index.back().stream_offset < info.stream_offset) {
+    picture_index.push_back(info);
+    return;
+  }
+
+  std::vector<de265_picture_info>::iterator pos = picture_index.begin();
+  while (pos != picture_index.end() && pos->stream_offset < info.stream_offset) {
+    ++pos;
+  }
+
+  if (pos == picture_index.end() || pos->stream_offset != info.stream_offset) {
+    picture_index.insert(pos, info);
+  }
+}
+
+
+/* Remember where the access unit of the next picture starts. Parameter sets, AUDs and
+   prefix SEIs preceding the first slice of a picture belong to its access unit (7.4.2.4.4),
+   and decoding has to restart there when seeking to this picture.
+ */
+void decoder_context::update_access_unit_offset(const NAL_unit* nal, const nal_header& nal_hdr)
+{
+  int type = nal_hdr.nal_unit_type;
+
+  if (type < 32) {
+    if (!access_unit_prefix && is_first_slice_of_picture(nal, nal_hdr)) {
+      access_unit_offset = nal->stream_offset;
+    }
+
+    access_unit_prefix = false;
+  }
+  else if (!access_unit_prefix) {
+    bool startsAccessUnit = ((type >= NAL_UNIT_VPS_NUT && type <= NAL_UNIT_AUD_NUT) ||
+                             type == NAL_UNIT_PREFIX_SEI_NUT ||
+                             (type >= 41 && type <= 44) ||
+                             (type >= 48 && type <= 55));
+
+    if (startsAccessUnit) {
+      access_unit_offset = nal->stream_offset;
+      access_unit_prefix = true;
+    }
+  }
+}
+
+
+/* Restart decoding at the last indexed IRAP picture before the seek target.
+ */
+de265_error decoder_context::seek(bool toPTS, de265_PTS pts, int frame,
+                                  int64_t* restart_offset)
+{
+  const de265_picture_info* start = NULL;
+
+  for (int i=0;i<(int)picture_index.size();i++) {
+    const de265_picture_info& info = picture_index[i];
+
+    if (info.is_irap &&
+        (toPTS ? info.pts <= pts : info.picture_number <= frame)) {
+      start = &info;
+    }
+  }
+
+  int64_t offset = (start ? start->stream_offset  : 0);
+  int     number = (start ? start->picture_number : 0);
+
+  reset();
+
+  nal_parser.set_input_stream_offset(offset);
+  next_picture_number = number;
+  stream_position_known = true;
+
+  // reset() marks the next picture as the first decoded picture, which already
+  // starts a new coded video sequence at the IRAP picture (NoRaslOutputFlag)
+
+  seek_mode = (toPTS ? SeekToPTS : SeekToFrame);
+  seek_target_pts = pts;
+  seek_target_frame = frame;
+  seek_target_reached = false;
+
+  if (restart_offset) {
+    *restart_offset = offset;
+  }
+
+  return DE265_OK;
+}
+
+
+/* Decide whether the picture starting with 'nal' is needed while seeking.
+   Pictures before the target are decoded only when they may be used for reference.
+   Seeking ends at the first IRAP picture after the target, because no later
+   picture can precede the target in output order.
+ */
+void decoder_context::update_seek_state(const NAL_unit* nal, int temporal_id)
+{
+  seek_skip_picture = false;
+  seek_hide_picture = false;
+
+  if (seek_mode == SeekNone) {
+    return;
+  }
+
+  bool beforeTarget;
+  if (seek_mode == SeekToPTS) {
+    beforeTarget = (nal->pts < seek_target_pts);
+  }
+  else {
+    beforeTarget = (current_picture_number < seek_target_frame);
+  }
+
+  if (beforeTarget) {
+    seek_hide_picture = true;
+
+    // Sub-layer non-reference pictures can still be referenced from higher sub-layers.
+    // Only pictures in the highest sub-layer are not needed by any later picture.
+
+    if (isSublayerNonReference(nal_unit_type) &&
+        temporal_id >= get_highest_TID()) {
+      seek_skip_picture = true;
+    }
+  }
+  else if (seek_target_reached && isIRAP(nal_unit_type)) {
+    seek_mode = SeekNone;
+    return;
+  }
+  else {
+    seek_target_reached = true;
+  }
+
+  // RASL pictures of the IRAP picture we started at cannot be reconstructed
+
+  if (isRASL(nal_unit_type) && NoRaslOutputFlag) {
+    seek_skip_picture = true;
+  }
+}
+
+
 void decoder_context::remove_images_from_dpb(const std::vector<int>& removeImageList)
 {
   for (int i=0;i<removeImageList.size();i++) {
@@ -2223,8 +3532,129 @@ void decoder_context::calc_tid_and_framerate_ratio()
   goal_HighestTid       = framedrop_tab[framerate_ratio].tid;
   layer_framerate_ratio = framedrop_tab[framerate_ratio].ratio;
 
-  // TODO: for now, we switch immediately
-  current_HighestTid = goal_HighestTid;
+  // Under the real-time governor, switching up waits for a switching point (see decode_NAL()).
+  // TODO: otherwise, we switch immediately
+  if (goal_HighestTid < current_HighestTid || realtime_frame_interval == 0) {
+    current_HighestTid = goal_HighestTid;
+  }
+}
+
+
+// Number of pictures over which the governor measures the decoding time.
+#define REALTIME_CONTROL_PERIOD 8
+
+// The governor steps up only when the load stayed below this for two periods.
+#define REALTIME_HEADROOM_PERCENT 70
+
+void decoder_context::set_realtime_frame_interval(int interval_us)
+{
+  bool wasActive = (realtime_frame_interval > 0);
+
+  realtime_frame_interval = libde265_max(interval_us, 0);
+
+  realtime_busy_time = 0;
+  realtime_pictures = 0;
+  realtime_late = false;
+  realtime_good_periods = 0;
+
+  if (wasActive && realtime_frame_interval == 0) {
+    realtime_set_level(0);
+  }
+}
+
+
+void decoder_context::report_output_lateness(int lateness_us)
+{
+  if (lateness_us > 0) {
+    realtime_late = true;
+  }
+}
+
+
+void decoder_context::realtime_count_picture()
+{
+  if (realtime_frame_interval == 0) {
+    return;
+  }
+
+  realtime_pictures++;
+  if (realtime_pictures < REALTIME_CONTROL_PERIOD) {
+    return;
+  }
+
+
+  // evaluate the control period
+
+  int64_t budget = realtime_pictures * realtime_frame_interval;
+  realtime_load = (int)(100 * realtime_busy_time / budget);
+
+  int maxLevel = (param_realtime_skip_filters ? 1 : 0) + libde265_min(get_highest_TID(),
+                                                                      limit_HighestTid);
+
+  if (realtime_load > 100 || realtime_late) {
+    realtime_good_periods = 0;
+
+    if (realtime_level < maxLevel) {
+      realtime_set_level(realtime_level+1);
+    }
+  }
+  else if (realtime_load < REALTIME_HEADROOM_PERCENT) {
+    realtime_good_periods++;
+
+    if (realtime_good_periods >= 2 && realtime_level > 0) {
+      realtime_good_periods = 0;
+      realtime_set_level(realtime_level-1);
+    }
+  }
+  else {
+    realtime_good_periods = 0;
+  }
+
+  realtime_busy_time = 0;
+  realtime_pictures = 0;
+  realtime_late = false;
+}
+
+
+void decoder_context::realtime_set_level(int level)
+{
+  if (level != realtime_level) {
+    realtime_num_adjustments++;
+  }
+
+  realtime_level = level;
+
+
+  // first step: skip the filters on non-reference pictures
+  // (only at this step, the filters are never skipped while temporal layers are dropped)
+
+  int filterLevels = (param_realtime_skip_filters ? 1 : 0);
+
+  realtime_skip_filters = (filterLevels>0 && level==1);
+
+
+  // further steps: drop temporal layers
+
+  int highestTID = get_highest_TID();
+  int tid = libde265_max(0, libde265_min(highestTID, limit_HighestTid)
+                         - libde265_max(0, level - filterLevels));
+
+  if (framedrop_tab[100].tid != highestTID) {
+    compute_framedrop_table();
+  }
+
+  framerate_ratio = framedrop_tid_index[tid];
+  calc_tid_and_framerate_ratio();
+}
+
+
+void decoder_context::get_realtime_status(de265_realtime_status* status) const
+{
+  status->level = realtime_level;
+  status->load  = realtime_load;
+  status->current_TID = current_HighestTid;
+  status->skipping_filters = realtime_skip_filters;
+  status->num_adjustments = realtime_num_adjustments;
 }
 
 
@@ -35,7 +35,9 @@
 #include "libde265/acceleration.h"
 #include "libde265/nal-parser.h"
 
+#include <deque>
 #include <memory>
+#include <mutex>
 
 #define DE265_MAX_VPS_SETS 16   // this is the maximum as defined in the standard
 #define DE265_MAX_SPS_SETS 16   // this is the maximum as defined in the standard
@@ -43,6 +45,8 @@
 
 #define MAX_WARNINGS 20
 
+#define MAX_PENDING_HASH_CHECKS 2 // pictures whose hash is checked in the background
+
 
 class slice_segment_header;
 class image_unit;
@@ -55,6 +59,8 @@ class thread_context
 public:
   thread_context();
 
+  void reset(); // prepare for decoding a new substream
+
   int CtbAddrInRS;
   int CtbAddrInTS;
 
@@ -117,6 +123,10 @@ public:
   slice_unit* sliceunit;
   thread_task* task; // executing thread_task or NULL if not multi-threaded
 
+  // per-stage timing of the running slice data decoding (see begin_slice_data_timing())
+  int64_t slice_data_start; // 0: timing disabled
+  int64_t stage_time[DE265_NUMBER_OF_DECODE_STAGES];
+
 private:
   thread_context(const thread_context&); // not allowed
   const thread_context& operator=(const thread_context&); // not allowed
@@ -124,6 +134,34 @@ private:
 
 
 
+/* Keeps unused thread_contexts for later slices and pictures, such that their large
+   coefficient buffers are not allocated for every slice segment. The contexts are
+   aligned to cache lines. Only to be used from the main decoding thread. */
+class thread_context_pool
+{
+ public:
+  thread_context_pool();
+  ~thread_context_pool();
+
+  LIBDE265_CHECK_RESULT thread_context* get();
+  void put(thread_context*);
+
+  /* Free all unused contexts. Returns the number of bytes released. */
+  int64_t release_unused();
+
+  // Memory of all contexts, including those in use.
+  int64_t get_memory_usage() const { return nAllocated * (int64_t)sizeof(thread_context); }
+
+ private:
+  std::vector<thread_context*> free_contexts;
+  int nAllocated;
+
+  thread_context_pool(const thread_context_pool&); // not allowed
+  const thread_context_pool& operator=(const thread_context_pool&); // not allowed
+};
+
+
+
 class error_queue
 {
  public:
@@ -169,17 +207,16 @@ public:
   int first_decoded_CTB_RS; // TODO
   int last_decoded_CTB_RS;  // TODO
 
-  void allocate_thread_contexts(int n);
+  // Thread contexts are taken from the decoder's thread_context_pool.
+  LIBDE265_CHECK_RESULT de265_error allocate_thread_contexts(int n);
   thread_context* get_thread_context(int n) {
-    assert(n < nThreadContexts);
-    return &thread_contexts[n];
+    assert(n < (int)thread_contexts.size());
+    return thread_contexts[n];
   }
-  int num_thread_contexts() const { return nThreadContexts; }
+  int num_thread_contexts() const { return thread_contexts.size(); }
 
 private:
-  thread_context* thread_contexts; /* NOTE: cannot use std::vector, because thread_context has
-                                      no copy constructor. */
-  int nThreadContexts;
+  std::vector<thread_context*> thread_contexts;
 
 public:
   decoder_context* ctx;
@@ -197,7 +234,26 @@ public:
   ~image_unit();
 
   de265_image* img;
-  de265_image  sao_output; // if SAO is used, this is allocated and used as SAO output buffer
+  de265_image* sao_output; // if SAO is used, this is taken from the DPB pool and used as SAO output buffer
+
+  int temporal_id;
+
+  bool end_of_picture_decoded; // the last CTB of the picture has been decoded
+
+  bool skip_filters;      // no deblocking/SAO (decided when the picture is started)
+  int num_final_CTB_rows; // CTB rows already passed to the row callback
+
+  // Deblocking and SAO in the worker threads. The tasks are queued while the picture is
+  // decoded, for the CTB rows whose input is produced by the tasks queued before them.
+  bool parallel_filters;
+  bool deblocking_tasks;
+  bool sao_tasks;         // sao_output is set
+  int  num_deblk_V_rows_queued;
+  int  num_deblk_H_rows_queued;
+  int  num_sao_rows_queued;
+  int  num_prefilter_rows_marked; // CTB rows marked as decoded by mark_CTB_rows_decoded()
+
+  bool is_tile_decoded(int tileId) const { return img->is_tile_decoded(tileId); }
 
   std::vector<slice_unit*> slice_units;
   std::vector<sei_message> suffix_SEIs;
@@ -321,6 +377,7 @@ class decoder_context : public base_context {
   de265_error decode_NAL(NAL_unit* nal);
 
   de265_error decode(int* more);
+  de265_error decode_next(int* more);
   de265_error decode_some(bool* did_work);
 
   de265_error decode_slice_unit_sequential(image_unit* imgunit, slice_unit* sliceunit);
@@ -352,6 +409,14 @@ class decoder_context : public base_context {
 
   bool param_disable_deblocking;
   bool param_disable_sao;
+  bool param_headers_only;  // skip slice data, only build the picture index
+  bool param_keyframes_only; // drop all non-IRAP pictures and SEIs (set with set_keyframes_only())
+  bool param_skip_filters_non_reference; // no deblocking/SAO on image_unit::Leaf pictures
+  int  param_skip_filters_min_TID;       // no deblocking/SAO from this temporal layer, -1: off
+  bool param_keep_full_motion_field; // do not compress motion fields of decoded pictures
+  bool param_low_latency_output;     // output pictures as soon as their last CTB is decoded
+  bool param_stage_timing;           // measure the time spent in each decoding stage
+  int64_t param_memory_budget;       // in bytes, 0: unlimited
   //bool param_disable_mc_residual_idct;  // not implemented yet
   //bool param_disable_intra_residual_idct;  // not implemented yet
 
@@ -360,14 +425,25 @@ class decoder_context : public base_context {
   de265_image_allocation param_image_allocation_functions;
   void*                  param_image_allocation_userdata;
 
+  // used by the library's own image allocation functions
+  de265_image_allocator  param_image_allocator;
+  int                    param_image_numa_node;  // -1: no binding
+
 
   // --- input stream data ---
 
   NAL_Parser nal_parser;
 
 
+  // --- decoding scratch memory ---
+
+  thread_context_pool thread_contexts;
+
+
   int get_num_worker_threads() const { return num_worker_threads; }
 
+  void set_keyframes_only(bool enable);
+
   /* */ de265_image* get_image(int dpb_index)       { return dpb.get_image(dpb_index); }
   const de265_image* get_image(int dpb_index) const { return dpb.get_image(dpb_index); }
 
@@ -375,7 +451,36 @@ class decoder_context : public base_context {
 
   de265_image* get_next_picture_in_output_queue() { return dpb.get_next_picture_in_output_queue(); }
   int          num_pictures_in_output_queue() const { return dpb.num_pictures_in_output_queue(); }
-  void         pop_next_picture_in_output_queue() { dpb.pop_next_picture_in_output_queue(); }
+  void         pop_next_picture_in_output_queue();
+
+  de265_image* take_sao_output_image(const seq_parameter_set& sps) { return dpb.take_sao_output_image(sps); }
+
+
+  // --- stream probing and seeking ---
+
+  std::vector<de265_picture_info> picture_index;  // sorted by stream offset
+
+  void add_picture_info(const de265_picture_info& info);
+
+  de265_error seek(bool toPTS, de265_PTS pts, int frame, int64_t* restart_offset);
+
+ private:
+  enum { SeekNone, SeekToPTS, SeekToFrame } seek_mode;
+  de265_PTS seek_target_pts;
+  int       seek_target_frame;
+  bool      seek_target_reached;
+  bool      seek_skip_picture;  // do not decode current picture
+  bool      seek_hide_picture;  // decode current picture, but do not output it
+
+  int  current_picture_number;  // in decoding order
+  int  next_picture_number;
+  bool stream_position_known;   // false after reset(), picture index is not extended then
+
+  int64_t access_unit_offset;   // stream offset of the first NAL of the current access unit
+  bool    access_unit_prefix;   // NALs preceding the first slice of the next picture were seen
+
+  void update_access_unit_offset(const NAL_unit* nal, const nal_header& nal_hdr);
+  void update_seek_state(const NAL_unit* nal, int temporal_id);
 
  private:
   de265_error read_vps_NAL(bitreader&);
@@ -432,6 +537,128 @@ class decoder_context : public base_context {
   void compute_framedrop_table();
   void calc_tid_and_framerate_ratio();
 
+
+ public:
+  // --- real-time governor ---
+
+  void set_realtime_frame_interval(int interval_us);
+  void report_output_lateness(int lateness_us);
+  void get_realtime_status(de265_realtime_status*) const;
+
+  bool param_realtime_skip_filters; // the governor may skip filters on non-reference pictures
+
+ private:
+  int64_t realtime_frame_interval;  // in us, 0: governor off
+
+  int  realtime_level;              // 0: full quality, each level is one degradation step
+  bool realtime_skip_filters;       // set by the governor on its first level
+  int  realtime_load;               // in percent, of the last control period
+  int  realtime_num_adjustments;
+
+  // measurements of the current control period
+  int64_t realtime_busy_time;       // time spent in decode()
+  int     realtime_pictures;        // pictures started (decoded or dropped)
+  bool    realtime_late;            // a late output picture was reported
+  int     realtime_good_periods;    // consecutive periods with enough headroom
+
+  void realtime_count_picture();
+  void realtime_set_level(int level);
+
+
+ public:
+  // --- output latency (last slice NAL arrival -> output queue) ---
+
+  void get_latency_statistics(de265_latency_statistics*) const;
+  void reset_latency_statistics();
+
+ private:
+  int     latency_num_pictures;
+  int64_t latency_last;
+  int64_t latency_sum;
+  int64_t latency_max;
+
+
+ public:
+  // --- per-stage timing ---
+
+  void get_statistics(de265_statistics*) const;
+  void reset_statistics();
+
+  // time of a stage that is not yet assigned to a picture (NAL parsing, slice headers)
+  void add_pending_stage_time(enum de265_decode_stage stage, int64_t start_time) {
+    pending_stage_time[stage] += monotonic_time_ns() - start_time;
+  }
+
+ private:
+  int64_t pending_stage_time[DE265_NUMBER_OF_DECODE_STAGES];
+
+  int     stats_num_pictures;
+  int64_t stats_last_picture[DE265_NUMBER_OF_DECODE_STAGES];
+  int64_t stats_total[DE265_NUMBER_OF_DECODE_STAGES];
+
+  void account_stage_times(const de265_image* img);
+
+
+ public:
+  // --- thread-pool tracing ---
+
+  void set_thread_tracing(bool enable);
+  bool is_thread_tracing() const { return thread_pool_.trace != NULL; }
+  de265_error write_thread_trace(const char* filename);
+
+ private:
+  thread_trace thread_trace_;
+
+
+ public:
+  // --- row callback ---
+
+  void set_row_callback(de265_row_callback callback, void* userdata);
+  bool has_row_callback() const { return row_callback != NULL; }
+
+  /* Pass the CTB rows that are final now to the row callback. 'progress' is the stage
+     that the caller has just completed (CTB_PROGRESS_*). Only the last stage of the
+     picture reports rows, taking the samples from 'pixels'. */
+  void report_final_CTB_rows(image_unit* imgunit, const de265_image* pixels, int progress);
+
+  // Pass all remaining rows (after the post-processing filters).
+  void report_remaining_CTB_rows(image_unit* imgunit);
+
+ private:
+  de265_row_callback row_callback;
+  void*              row_callback_userdata;
+  std::mutex         row_callback_mutex;
+
+  int  final_CTB_progress(const image_unit* imgunit) const;
+  void call_row_callback(image_unit* imgunit, const de265_image* pixels, int nRows);
+
+
+ public:
+  // --- region of interest ---
+
+  void set_region_of_interest(int x, int y, int width, int height, int margin);
+  void set_region_of_interest_tiles(const int* tile_indices, int num_tiles);
+
+ private:
+  int roi_x, roi_y, roi_width, roi_height; // width/height 0: no region
+  int roi_margin;
+  std::vector<int> roi_tiles;               // selected tile indices (instead of a region)
+
+  void select_ROI_tiles(image_unit* imgunit) const;
+
+
+ private:
+  // --- picture hash checks on the worker threads ---
+
+  std::deque<sei_hash_check*> pending_hash_checks;
+
+  void start_hash_check(const sei_message* sei, de265_image* img);
+
+  /* Remove the finished checks and wait until at most 'max_pending' checks are left.
+     Returns the first hash mismatch. */
+  de265_error finish_hash_checks(int max_pending);
+  void discard_hash_checks(); // wait for all checks, ignoring the results
+
  private:
   // --- decoded picture buffer ---
 
@@ -443,6 +670,33 @@ class decoder_context : public base_context {
   bool HandleCraAsBlaFlag;
   bool FirstAfterEndOfSequenceNAL;
 
+  slice_segment_header* headers_only_shdr; // last slice header in headers-only mode (owned)
+
+
+ public:
+  // --- memory accounting ---
+
+  void get_memory_usage(de265_memory_usage* usage) const;
+
+  /* Check whether 'additional_bytes' fit into the memory budget. If not, pooled
+     memory is released first. */
+  bool memory_budget_allows(int64_t additional_bytes);
+
+  /* Back-pressure: false if the next picture does not fit into the memory budget and
+     the application can make room by releasing output pictures. */
+  bool has_memory_for_next_picture();
+
+  /* Persistent scratch buffer for in-place SAO. */
+  uint8_t* get_sao_scratch_buffer(int size);
+
+ private:
+  int num_memory_degradations;
+
+  uint8_t* sao_scratch;
+  int      sao_scratch_size;
+
+  int64_t estimate_picture_memory(const seq_parameter_set& sps) const;
+
   int  PicOrderCntMsb;
   int prevPicOrderCntLsb;  // at precTid0Pic
   int prevPicOrderCntMsb;  // at precTid0Pic
@@ -512,7 +766,12 @@ class decoder_context : public base_context {
                                      slice_unit* sliceunit,
                                      int progress);
 
-  void process_picture_order_count(slice_segment_header* hdr);
+  void update_NoRaslOutputFlag();
+  int  process_picture_order_count(slice_segment_header* hdr, int nuh_temporal_id);
+  void probe_slice_segment_header(slice_segment_header* hdr, const NAL_unit* nal,
+                                  const nal_header* nal_hdr);
+  void add_picture_index_entry(const slice_segment_header* hdr, const NAL_unit* nal,
+                               const nal_header* nal_hdr, int poc);
   int generate_unavailable_reference_picture(const seq_parameter_set* sps,
                                              int POC, bool longTerm);
   void process_reference_picture_set(slice_segment_header* hdr);
@@ -521,7 +780,13 @@ class decoder_context : public base_context {
 
   void remove_images_from_dpb(const std::vector<int>& removeImageList);
   void run_postprocessing_filters_sequential(struct de265_image* img);
+  void start_postprocessing_filters(image_unit* imgunit);
+  void add_postprocessing_tasks(image_unit* imgunit, int nRowsDecoded);
+  void mark_CTB_rows_decoded(image_unit* imgunit, int nRows);
+  void wait_for_slice_decoding_tasks(image_unit* imgunit, slice_unit* sliceunit,
+                                     int nRowsDecoded);
   void run_postprocessing_filters_parallel(image_unit* img);
+  bool skip_postprocessing_filters(const image_unit* imgunit) const;
 };
 
 
@@ -22,22 +22,53 @@
 #include "decctx.h"
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
+#include <mutex>
 
 
 #define DPB_DEFAULT_MAX_IMAGES  30
+#define DPB_DEFAULT_POOL_IMAGES 4
+
+
+/* Guards the application reference counts of all images and the image pools.
+   A single mutex is sufficient, as it is only taken once per picture. */
+static std::mutex image_mutex;
 
 
 decoded_picture_buffer::decoded_picture_buffer()
 {
   max_images_in_DPB  = DPB_DEFAULT_MAX_IMAGES;
   norm_images_in_DPB = DPB_DEFAULT_MAX_IMAGES;
+  max_images_in_pool = DPB_DEFAULT_POOL_IMAGES;
 }
 
 
 decoded_picture_buffer::~decoded_picture_buffer()
 {
-  for (int i=0;i<dpb.size();i++)
-    delete dpb[i];
+  std::lock_guard<std::mutex> lock(image_mutex);
+
+  // Images still referenced by the application are deleted by their last unref.
+
+  for (int i=0;i<(int)dpb.size();i++) {
+    if (dpb[i]->app_refcount > 0) {
+      dpb[i]->detached = true;
+      detached_images.push_back(dpb[i]);
+    }
+    else {
+      delete dpb[i];
+    }
+  }
+
+  for (int i=0;i<(int)detached_images.size();i++) {
+    detached_images[i]->owner_dpb = NULL;
+    detached_images[i]->decctx = NULL;
+  }
+
+  for (int i=0;i<(int)image_pool.size();i++)
+    delete image_pool[i];
+
+  for (int i=0;i<(int)motion_field_pool.size();i++)
+    delete motion_field_pool[i];
 }
 
 
@@ -161,6 +192,7 @@ void decoded_picture_buffer::output_next_picture_in_reorder_buffer()
 
   // put image into output queue
 
+  reorder_output_queue[minIdx]->output_time = monotonic_time_us();
   image_output_queue.push_back(reorder_output_queue[minIdx]);
 
 
@@ -192,7 +224,7 @@ void decoded_picture_buffer::clear()
       {
         dpb[i]->PicOutputFlag = false;
         dpb[i]->PicState = UnusedForReference;
-        dpb[i]->release();
+        dpb[i]->release_slices();
       }
   }
 
@@ -208,17 +240,55 @@ int decoded_picture_buffer::new_image(std::shared_ptr<const seq_parameter_set> s
   loginfo(LogHeaders,"DPB::new_image\n");
   log_dpb_content();
 
+  std::lock_guard<std::mutex> lock(image_mutex);
+
   // --- search for a free slot in the DPB ---
 
+  /* Prefer a free slot whose buffers already match the picture format. Its pixel planes,
+     metadata and progress locks can then be reused without any reallocation.
+     Slots with images that are still referenced by the application are used last. */
+
   int free_image_buffer_idx = -1;
   for (int i=0;i<dpb.size();i++) {
     if (dpb[i]->can_be_released()) {
-      dpb[i]->release(); /* TODO: this is surely not the best place to free the image, but
-                            we have to do it here because releasing it in de265_release_image()
-                            would break the API compatibility. */
+      bool referenced = (dpb[i]->app_refcount > 0);
 
-      free_image_buffer_idx = i;
-      break;
+      if (free_image_buffer_idx == -1 ||
+          (dpb[free_image_buffer_idx]->app_refcount > 0 && !referenced)) {
+        free_image_buffer_idx = i;
+      }
+
+      if (!referenced && dpb[i]->has_buffers_for(*sps)) {
+        free_image_buffer_idx = i;
+        break;
+      }
+    }
+  }
+
+
+  // If no free slot matches, get a matching image from the pool.
+  // A referenced image is moved out of the DPB and replaced by a fresh one.
+
+  if (free_image_buffer_idx == -1 ||
+      dpb[free_image_buffer_idx]->app_refcount > 0 ||
+      !dpb[free_image_buffer_idx]->has_buffers_for(*sps)) {
+    de265_image* pooled_img = take_image_from_pool(*sps);
+
+    if (pooled_img == NULL &&
+        free_image_buffer_idx != -1 &&
+        dpb[free_image_buffer_idx]->app_refcount > 0) {
+      pooled_img = new de265_image;
+    }
+
+    if (pooled_img) {
+      if (free_image_buffer_idx == -1) {
+        free_image_buffer_idx = dpb.size();
+        dpb.push_back(pooled_img);
+      }
+      else {
+        retire_image(dpb[free_image_buffer_idx]);
+        dpb[free_image_buffer_idx] = pooled_img;
+      }
     }
   }
 
@@ -230,7 +300,7 @@ int decoded_picture_buffer::new_image(std::shared_ptr<const seq_parameter_set> s
       free_image_buffer_idx != dpb.size()-1 &&     // last slot not reused in this alloc
       dpb.back()->can_be_released())               // last slot is free
     {
-      delete dpb.back();
+      retire_image(dpb.back());
       dpb.pop_back();
     }
 
@@ -247,6 +317,20 @@ int decoded_picture_buffer::new_image(std::shared_ptr<const seq_parameter_set> s
 
   de265_image* img = dpb[free_image_buffer_idx];
 
+  if (!img->has_full_motion_field()) {
+    MetaDataArray<PBMotion> no_full_field;
+    MetaDataArray<PBMotion>* full_field = &no_full_field;
+
+    for (int i=0;i<(int)motion_field_pool.size();i++) {
+      if (motion_field_pool[i]->data != NULL) {
+        full_field = motion_field_pool[i];
+        break;
+      }
+    }
+
+    img->restore_full_motion_field(*full_field);
+  }
+
   int w = sps->pic_width_in_luma_samples;
   int h = sps->pic_height_in_luma_samples;
 
@@ -267,6 +351,237 @@ int decoded_picture_buffer::new_image(std::shared_ptr<const seq_parameter_set> s
 }
 
 
+de265_image* decoded_picture_buffer::take_image_from_pool(const seq_parameter_set& sps)
+{
+  for (int i=0;i<(int)image_pool.size();i++) {
+    if (image_pool[i]->has_buffers_for(sps)) {
+      de265_image* img = image_pool[i];
+      image_pool[i] = image_pool.back();
+      image_pool.pop_back();
+      return img;
+    }
+  }
+
+  return NULL;
+}
+
+
+void decoded_picture_buffer::return_image_to_pool(de265_image* img)
+{
+  img->release_slices();
+
+  if ((int)image_pool.size() < max_images_in_pool) {
+    image_pool.push_back(img);
+  }
+  else {
+    delete img;
+  }
+}
+
+
+void decoded_picture_buffer::compress_motion_field(de265_image* img)
+{
+  MetaDataArray<PBMotion>* full_field = NULL;
+
+  for (int i=0;i<(int)motion_field_pool.size();i++) {
+    if (motion_field_pool[i]->data == NULL) {
+      full_field = motion_field_pool[i];
+      break;
+    }
+  }
+
+  if (full_field == NULL) {
+    full_field = new MetaDataArray<PBMotion>;
+    motion_field_pool.push_back(full_field);
+  }
+
+  img->compress_motion_field(*full_field);
+}
+
+
+void decoded_picture_buffer::get_memory_usage(int64_t* pixel_bytes,
+                                              int64_t* metadata_bytes) const
+{
+  std::lock_guard<std::mutex> lock(image_mutex);
+
+  int64_t pixels=0, metadata=0;
+
+  for (int i=0;i<(int)dpb.size();i++) {
+    pixels   += dpb[i]->get_pixel_memory_size();
+    metadata += dpb[i]->get_metadata_memory_size();
+  }
+
+  for (int i=0;i<(int)image_pool.size();i++) {
+    pixels   += image_pool[i]->get_pixel_memory_size();
+    metadata += image_pool[i]->get_metadata_memory_size();
+  }
+
+  for (int i=0;i<(int)detached_images.size();i++) {
+    pixels   += detached_images[i]->get_pixel_memory_size();
+    metadata += detached_images[i]->get_metadata_memory_size();
+  }
+
+  for (int i=0;i<(int)motion_field_pool.size();i++) {
+    metadata += (int64_t)motion_field_pool[i]->data_size * sizeof(PBMotion);
+  }
+
+  *pixel_bytes    = pixels;
+  *metadata_bytes = metadata;
+}
+
+
+bool decoded_picture_buffer::has_reusable_image(const seq_parameter_set& sps) const
+{
+  std::lock_guard<std::mutex> lock(image_mutex);
+
+  for (int i=0;i<(int)dpb.size();i++) {
+    if (dpb[i]->can_be_released() &&
+        dpb[i]->app_refcount == 0 &&
+        dpb[i]->has_buffers_for(sps)) {
+      return true;
+    }
+  }
+
+  for (int i=0;i<(int)image_pool.size();i++) {
+    if (image_pool[i]->has_buffers_for(sps)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+int64_t decoded_picture_buffer::trim_pools()
+{
+  std::lock_guard<std::mutex> lock(image_mutex);
+
+  int64_t released = 0;
+
+  for (int i=0;i<(int)image_pool.size();i++) {
+    released += image_pool[i]->get_pixel_memory_size();
+    released += image_pool[i]->get_metadata_memory_size();
+    delete image_pool[i];
+  }
+  image_pool.clear();
+
+  for (int i=0;i<(int)motion_field_pool.size();i++) {
+    released += (int64_t)motion_field_pool[i]->data_size * sizeof(PBMotion);
+    delete motion_field_pool[i];
+  }
+  motion_field_pool.clear();
+
+  return released;
+}
+
+
+de265_image* decoded_picture_buffer::take_sao_output_image(const seq_parameter_set& sps)
+{
+  std::lock_guard<std::mutex> lock(image_mutex);
+
+  // Prefer planes without metadata, which cannot be used for decoded pictures.
+
+  int idx = -1;
+  for (int i=0;i<(int)image_pool.size();i++) {
+    if (image_pool[i]->has_pixel_buffers_for(sps)) {
+      idx = i;
+
+      if (!image_pool[i]->has_buffers_for(sps)) {
+        break;
+      }
+    }
+  }
+
+  if (idx == -1) {
+    return new de265_image;
+  }
+
+  de265_image* img = image_pool[idx];
+  image_pool[idx] = image_pool.back();
+  image_pool.pop_back();
+  return img;
+}
+
+
+void decoded_picture_buffer::return_sao_output_image(de265_image* img)
+{
+  std::lock_guard<std::mutex> lock(image_mutex);
+
+  // planes from custom allocators are handed back to the application
+
+  if (!img->has_pixel_buffers_for(img->get_sps())) {
+    delete img;
+    return;
+  }
+
+  return_image_to_pool(img);
+}
+
+
+bool decoded_picture_buffer::has_sao_output_image(const seq_parameter_set& sps) const
+{
+  std::lock_guard<std::mutex> lock(image_mutex);
+
+  for (int i=0;i<(int)image_pool.size();i++) {
+    if (image_pool[i]->has_pixel_buffers_for(sps)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+void decoded_picture_buffer::retire_image(de265_image* img)
+{
+  if (img->app_refcount > 0) {
+    img->detached  = true;
+    img->owner_dpb = this;
+    detached_images.push_back(img);
+  }
+  else {
+    return_image_to_pool(img);
+  }
+}
+
+
+void decoded_picture_buffer::ref_image(de265_image* img)
+{
+  std::lock_guard<std::mutex> lock(image_mutex);
+
+  img->app_refcount++;
+}
+
+
+void decoded_picture_buffer::unref_image(de265_image* img)
+{
+  std::lock_guard<std::mutex> lock(image_mutex);
+
+  assert(img->app_refcount > 0);
+  img->app_refcount--;
+
+  if (img->app_refcount > 0 || !img->detached) {
+    return;
+  }
+
+
+  // last reference to a detached image -> give it back to its DPB, or free it
+
+  decoded_picture_buffer* owner = img->owner_dpb;
+  if (owner) {
+    std::vector<de265_image*>& detached = owner->detached_images;
+    detached.erase(std::remove(detached.begin(), detached.end(), img), detached.end());
+
+    img->detached  = false;
+    img->owner_dpb = NULL;
+    owner->return_image_to_pool(img);
+  }
+  else {
+    delete img;
+  }
+}
+
+
 void decoded_picture_buffer::pop_next_picture_in_output_queue()
 {
   image_output_queue.pop_front();
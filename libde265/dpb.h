@@ -96,6 +96,47 @@ public:
   void pop_next_picture_in_output_queue();
 
 
+  /* Replace the motion field of a decoded picture with the compressed 16x16 field.
+     The full-resolution field is kept for the next picture. */
+  void compress_motion_field(de265_image* img);
+
+
+  // --- memory accounting ---
+
+  /* Memory of all pictures in the DPB, in its pools and of detached pictures that are
+     still referenced by the application. */
+  void get_memory_usage(int64_t* pixel_bytes, int64_t* metadata_bytes) const;
+
+  /* Whether a picture for this SPS can be placed without allocating new memory. */
+  bool has_reusable_image(const seq_parameter_set& sps) const;
+
+  /* Free all pooled images and motion fields. Returns the number of bytes released. */
+  int64_t trim_pools();
+
+
+  // --- SAO output pictures ---
+
+  /* The parallel SAO writes into a separate picture, whose pixel planes are then exchanged
+     with the decoded picture. Its planes are taken from the image pool and given back
+     afterwards, so that they are not allocated again for each picture.
+     Returns an empty image if the pool has no matching planes. */
+  de265_image* take_sao_output_image(const seq_parameter_set& sps);
+  void return_sao_output_image(de265_image* img);
+
+  /* Whether the image pool holds pixel planes for the SAO output of this SPS. */
+  bool has_sao_output_image(const seq_parameter_set& sps) const;
+
+
+  // --- application references ---
+
+  /* Pictures referenced by the application stay valid after they were released
+     from the output queue. When the decoder does not need such a picture anymore,
+     it is moved out of the DPB and its slot gets a fresh image from the pool, so
+     that holding pictures does not stall decoding. These may be called from any thread. */
+  static void ref_image(de265_image* img);
+  static void unref_image(de265_image* img);
+
+
   // --- debug ---
 
   void log_dpb_content() const;
@@ -110,6 +151,24 @@ private:
   std::vector<struct de265_image*> reorder_output_queue;
   std::deque<struct de265_image*>  image_output_queue;
 
+  /* Images that were removed from the DPB. They keep their pixel planes and
+     metadata so that they can be reused for a following picture of the same format
+     without allocating new memory. */
+  std::vector<struct de265_image*> image_pool;
+  int max_images_in_pool;
+
+  // Full-resolution motion fields that were removed from decoded pictures.
+  // Only accessed from the decoding thread.
+  std::vector<MetaDataArray<PBMotion>*> motion_field_pool;
+
+  // Referenced images that were moved out of the DPB.
+  std::vector<struct de265_image*> detached_images;
+
+  // These have to be called with the image mutex held.
+  de265_image* take_image_from_pool(const seq_parameter_set& sps);
+  void return_image_to_pool(de265_image* img);
+  void retire_image(de265_image* img);
+
 private:
   decoded_picture_buffer(const decoded_picture_buffer&); // no copy
   decoded_picture_buffer& operator=(const decoded_picture_buffer&); // no copy
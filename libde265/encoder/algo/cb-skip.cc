@@ -66,7 +66,9 @@ enc_cb* Algo_CB_Skip_BruteForce::analyze(encoder_context* ectx,
     // set skip flag
 
     cb->PredMode = MODE_SKIP;
+    cb->PartMode = PART_2Nx2N;
     ectx->img->set_pred_mode(cb->x,cb->y, cb->log2Size, cb->PredMode);
+    ectx->img->set_PartMode(cb->x,cb->y, cb->PartMode);
 
     // encode CB
 
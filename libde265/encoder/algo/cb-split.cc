@@ -154,8 +154,10 @@ enc_cb* Algo_CB_Split_BruteForce::analyze(encoder_context* ectx,
   if (option_split) {
     option_split.begin();
 
+    // cb_input may have been deleted in the no-split analysis (when it was replaced by
+    // a better option), but the copy has the same downPtr.
     enc_cb* cb = option_split.get_node();
-    *cb_input->downPtr = cb;
+    *cb->downPtr = cb;
 
     cb = encode_cb_split(ectx, option_split.get_context(), cb);
 
@@ -24,6 +24,21 @@
 #include "libde265/encoder/encoder-context.h"
 
 
+/* The options that were analyzed after the best one have linked their own node into
+   the coding tree and, for CBs, written their metadata into the image. Restore both.
+ */
+static void relink_best_node(encoder_context* ectx, enc_cb* cb)
+{
+  *cb->downPtr = cb;
+  cb->write_to_image(ectx->img);
+}
+
+static void relink_best_node(encoder_context* ectx, enc_tb* tb)
+{
+  *tb->downPtr = tb;
+}
+
+
 template <class node>
 CodingOptions<node>::CodingOptions(encoder_context* ectx, node* _node, context_model_table& tab)
 {
@@ -156,6 +171,8 @@ node* CodingOptions<node>::return_best_rdo_node()
 
   *mContextModelInput = mOptions[bestRDO].context;
 
+  relink_best_node(mECtx, mOptions[bestRDO].mNode);
+
 
   // delete all CBs except the best one
 
@@ -55,7 +55,8 @@ enc_cb* Algo_CTB_QScale_Constant::analyze(encoder_context* ectx,
   enc_cb* result_cb = mChildAlgo->analyze(ectx,ctxModel,cb);
   ascend();
 
-  *cb->downPtr = result_cb;
+  // 'cb' may have been replaced (and deleted) by the child algorithm
+  *result_cb->downPtr = result_cb;
 
   return result_cb;
 }
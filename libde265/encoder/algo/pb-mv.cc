@@ -22,14 +22,76 @@
 
 
 #include "libde265/encoder/algo/pb-mv.h"
+#include "libde265/encoder/algo/tb-split.h"
 #include "libde265/encoder/algo/coding-options.h"
 #include "libde265/encoder/encoder-context.h"
+#include "libde265/encoder/encoder-syntax.h"
 #include <assert.h>
 #include <limits>
 #include <math.h>
 
 
 
+enc_cb* Algo_PB_MV::code_prediction_and_residual(encoder_context* ectx,
+                                                 context_model_table& ctxModel,
+                                                 enc_cb* cb,
+                                                 int PBidx, int x,int y,int w,int h)
+{
+  // the syntax writer only supports 2Nx2N inter CBs, hence the residual is coded for this PB
+  assert(cb->PartMode == PART_2Nx2N);
+
+  const PBMotion& vec = cb->inter.pb[PBidx].motion;
+
+  ectx->img->set_mv_info(x,y,w,h, vec);
+
+  // The prediction is written into the image. It is copied into the TBs by tb-split.
+
+  generate_inter_prediction_samples(ectx, ectx->shdr, ectx->img,
+                                    cb->x,cb->y, // int xC,int yC,
+                                    x-cb->x,y-cb->y, // int xB,int yB,
+                                    1<<cb->log2Size, // int nCS,
+                                    w,h, // int nPbW,int nPbH,
+                                    &vec);
+
+
+  // rate for sending the motion vector
+
+  CABAC_encoder_estim estim;
+  estim.set_context_models(&ctxModel);
+
+  encode_prediction_unit(ectx, &estim, cb, PBidx, x,y,w,h);
+
+
+  // code residual
+
+  assert(mTBSplitAlgo);
+
+  int IntraSplitFlag = 0;
+  int MaxTrafoDepth = ectx->get_sps().max_transform_hierarchy_depth_inter;
+
+  enc_tb* tb = new enc_tb(cb->x,cb->y,cb->log2Size,cb);
+  tb->downPtr = &cb->transform_tree;
+
+  descend(cb,"residual");
+  cb->transform_tree = mTBSplitAlgo->analyze(ectx, ctxModel, ectx->imgdata->input, tb,
+                                             0, MaxTrafoDepth, IntraSplitFlag);
+  ascend();
+
+  cb->inter.rqt_root_cbf = ! cb->transform_tree->isZeroBlock();
+
+  encode_rqt_root_cbf(ectx, &estim, cb->inter.rqt_root_cbf);
+
+  cb->distortion = cb->transform_tree->distortion;
+  cb->rate       = estim.getRDBits();
+
+  if (cb->inter.rqt_root_cbf) {
+    cb->rate += cb->transform_tree->rate;
+  }
+
+  return cb;
+}
+
+
 enc_cb* Algo_PB_MV_Test::analyze(encoder_context* ectx,
                                  context_model_table& ctxModel,
                                  enc_cb* cb,
@@ -91,61 +153,15 @@ enc_cb* Algo_PB_MV_Test::analyze(encoder_context* ectx,
   vec.predFlag[0] = 1;
   vec.predFlag[1] = 0;
 
-  ectx->img->set_mv_info(x,y,w,h, vec);
-
-  /* TMP REMOVE: ectx->prediction does not exist anymore
-  generate_inter_prediction_samples(ectx, ectx->shdr, ectx->prediction,
-                                    cb->x,cb->y, // int xC,int yC,
-                                    0,0,         // int xB,int yB,
-                                    1<<cb->log2Size, // int nCS,
-                                    1<<cb->log2Size,
-                                    1<<cb->log2Size, // int nPbW,int nPbH,
-                                    &vec);
-  */
-
-  // TODO estimate rate for sending MV
-
-  int IntraSplitFlag = 0;
-  int MaxTrafoDepth = ectx->get_sps().max_transform_hierarchy_depth_inter;
-
-  mCodeResidual=true;
-  if (mCodeResidual) {
-    assert(mTBSplitAlgo);
-    assert(false);
-    /*
-    cb->transform_tree = mTBSplitAlgo->analyze(ectx,ctxModel, ectx->imgdata->input, NULL, cb,
-                                               cb->x,cb->y,cb->x,cb->y, cb->log2Size,0,
-                                               0, MaxTrafoDepth, IntraSplitFlag);
-    */
-
-    cb->inter.rqt_root_cbf = ! cb->transform_tree->isZeroBlock();
-
-    cb->distortion = cb->transform_tree->distortion;
-    cb->rate       = cb->transform_tree->rate;
-  }
-  else {
-    const de265_image* input = ectx->imgdata->input;
-    /* TODO TMP REMOVE: prediction does not exist anymore
-    de265_image* img   = ectx->prediction;
-    int x0 = cb->x;
-    int y0 = cb->y;
-    int tbSize = 1<<cb->log2Size;
-
-    cb->distortion = compute_distortion_ssd(input, img, x0,y0, cb->log2Size, 0);
-    cb->rate = 5; // fake (MV)
-
-    cb->inter.rqt_root_cbf = 0;
-    */
-  }
-
-  return cb;
+  return code_prediction_and_residual(ectx, ctxModel, cb, PBidx, x,y,w,h);
 }
 
 
 
 
-int sad(const uint8_t* p1,int stride1,
-        const uint8_t* p2,int stride2,
+template <class pixel_t>
+int sad(const pixel_t* p1,int stride1,
+        const pixel_t* p2,int stride2,
         int w,int h)
 {
   int cost=0;
@@ -203,29 +219,30 @@ enc_cb* Algo_PB_MV_Search::analyze(encoder_context* ectx,
 
   int mincost = 0x7fffffff;
 
-  double lambda = 10.0;
+  // the SAD grows with the sample range
+  double lambda = 10.0 * (1<<(ectx->img->get_bit_depth(0)-8));
 
   double *bits_h = new double[2*hrange+1];
   double *bits_v = new double[2*vrange+1];
 
   for (int i=-hrange;i<=hrange;i++) {
-    int diff = (i - mvp[0].x);
+    int diff = ((i<<2) - mvp[0].x); // MVD in quarter-pel units
     int b;
 
     if (diff==0) { b=0; }
     else if (diff==1 || diff==-1) { b=2; }
-    else { b=abs_value(b+2); }
+    else { b=2*ceil_log2(abs_value(diff))+2; }
 
     bits_h[i+hrange]=b;
   }
 
   for (int i=-vrange;i<=vrange;i++) {
-    int diff = (i - mvp[0].y);
+    int diff = ((i<<2) - mvp[0].y); // MVD in quarter-pel units
     int b;
 
     if (diff==0) { b=0; }
     else if (diff==1 || diff==-1) { b=2; }
-    else { b=abs_value(b+2); }
+    else { b=2*ceil_log2(abs_value(diff))+2; }
 
     bits_v[i+vrange]=b;
   }
@@ -235,11 +252,21 @@ enc_cb* Algo_PB_MV_Search::analyze(encoder_context* ectx,
       {
         if (mx<0 || mx+pbW>w || my<0 || my+pbH>h) continue;
 
-        int cost = sad(refimg->get_image_plane_at_pos(0,mx,my),
-                       refimg->get_image_stride(0),
-                       inputimg->get_image_plane_at_pos(0,x,y),
-                       inputimg->get_image_stride(0),
-                       pbW,pbH);
+        int cost;
+        if (ectx->img->high_bit_depth(0)) {
+          cost = sad((const uint16_t*)refimg->get_image_plane_at_pos_any_depth(0,mx,my),
+                     refimg->get_image_stride(0),
+                     (const uint16_t*)inputimg->get_image_plane_at_pos_any_depth(0,x,y),
+                     inputimg->get_image_stride(0),
+                     pbW,pbH);
+        }
+        else {
+          cost = sad(refimg->get_image_plane_at_pos(0,mx,my),
+                     refimg->get_image_stride(0),
+                     inputimg->get_image_plane_at_pos(0,x,y),
+                     inputimg->get_image_stride(0),
+                     pbW,pbH);
+        }
 
         int bits = bits_h[mx-x+hrange] + bits_v[my-y+vrange];
 
@@ -263,56 +290,8 @@ enc_cb* Algo_PB_MV_Search::analyze(encoder_context* ectx,
   vec.predFlag[0] = 1;
   vec.predFlag[1] = 0;
 
-  ectx->img->set_mv_info(x,y,pbW,pbH, vec);
-
-  /* TMP REMOVE: ectx->prediction does not exist anymore
-  generate_inter_prediction_samples(ectx, ectx->shdr, ectx->prediction,
-                                    cb->x,cb->y, // int xC,int yC,
-                                    0,0,         // int xB,int yB,
-                                    1<<cb->log2Size, // int nCS,
-                                    1<<cb->log2Size,
-                                    1<<cb->log2Size, // int nPbW,int nPbH,
-                                    &vec);
-  */
-
-  // --- create residual ---
-
-
-
-  // TODO estimate rate for sending MV
-
-  int IntraSplitFlag = 0;
-  int MaxTrafoDepth = ectx->get_sps().max_transform_hierarchy_depth_inter;
-
-  mCodeResidual=true;
-  if (mCodeResidual) {
-    assert(false);
-    /*
-    cb->transform_tree = mTBSplitAlgo->analyze(ectx,ctxModel, ectx->imgdata->input, NULL, cb,
-                                               cb->x,cb->y,cb->x,cb->y, cb->log2Size,0,
-                                               0, MaxTrafoDepth, IntraSplitFlag);
-    */
-
-    cb->inter.rqt_root_cbf = ! cb->transform_tree->isZeroBlock();
-
-    cb->distortion = cb->transform_tree->distortion;
-    cb->rate       = cb->transform_tree->rate;
-  }
-  else {
-    const de265_image* input = ectx->imgdata->input;
-    de265_image* img   = ectx->img;
-    int x0 = cb->x;
-    int y0 = cb->y;
-    int tbSize = 1<<cb->log2Size;
-
-    cb->distortion = compute_distortion_ssd(input, img, x0,y0, cb->log2Size, 0);
-    cb->rate = 5; // fake (MV)
-
-    cb->inter.rqt_root_cbf = 0;
-  }
-
   delete[] bits_h;
   delete[] bits_v;
 
-  return cb;
+  return code_prediction_and_residual(ectx, ctxModel, cb, PBidx, x,y,pbW,pbH);
 }
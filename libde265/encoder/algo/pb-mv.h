@@ -52,6 +52,14 @@ class Algo_PB_MV : public Algo_PB
 
  protected:
   Algo_TB_Split* mTBSplitAlgo;
+
+  /* Generate the prediction for the motion of the PB and code the residual with the
+     child algorithm. Sets rate and distortion of the CB.
+   */
+  enc_cb* code_prediction_and_residual(encoder_context*,
+                                       context_model_table&,
+                                       enc_cb* cb,
+                                       int PBidx, int x,int y,int w,int h);
 };
 
 
@@ -80,8 +88,6 @@ class option_MVTestMode : public choice_option<enum MVTestMode>
 class Algo_PB_MV_Test : public Algo_PB_MV
 {
  public:
- Algo_PB_MV_Test() : mCodeResidual(false) { }
-
   struct params
   {
     params() {
@@ -108,8 +114,6 @@ class Algo_PB_MV_Test : public Algo_PB_MV
 
  private:
   params mParams;
-
-  bool mCodeResidual;
 };
 
 
@@ -138,8 +142,6 @@ class option_MVSearchAlgo : public choice_option<enum MVSearchAlgo>
 class Algo_PB_MV_Search : public Algo_PB_MV
 {
  public:
- Algo_PB_MV_Search() : mCodeResidual(false) { }
-
   struct params
   {
     params() {
@@ -170,8 +172,6 @@ class Algo_PB_MV_Search : public Algo_PB_MV
 
  private:
   params mParams;
-
-  bool mCodeResidual;
 };
 
 #endif
@@ -69,10 +69,11 @@ float get_intra_pred_mode_bits(const enum IntraPredMode candidates[3],
 
 
 
-float estim_TB_bitrate(const encoder_context* ectx,
-                       const de265_image* input,
-                       const enc_tb* tb,
-                       enum TBBitrateEstimMethod method)
+template <class pixel_t>
+static float estim_TB_bitrate_internal(const encoder_context* ectx,
+                                       const de265_image* input,
+                                       const enc_tb* tb,
+                                       enum TBBitrateEstimMethod method)
 {
   int x0 = tb->x;
   int y0 = tb->y;
@@ -83,18 +84,18 @@ float estim_TB_bitrate(const encoder_context* ectx,
   switch (method)
     {
     case TBBitrateEstim_SSD:
-      return SSD(input->get_image_plane_at_pos(0, x0,y0),
+      return SSD((const pixel_t*)input->get_image_plane_at_pos_any_depth(0, x0,y0),
                  input->get_image_stride(0),
-                 tb->intra_prediction[0]->get_buffer_u8(),
-                 tb->intra_prediction[0]->getStride(),
+                 tb->prediction[0]->get_buffer<pixel_t>(),
+                 tb->prediction[0]->getStride(),
                  blkSize, blkSize);
       break;
 
     case TBBitrateEstim_SAD:
-      return SAD(input->get_image_plane_at_pos(0, x0,y0),
+      return SAD((const pixel_t*)input->get_image_plane_at_pos_any_depth(0, x0,y0),
                  input->get_image_stride(0),
-                 tb->intra_prediction[0]->get_buffer_u8(),
-                 tb->intra_prediction[0]->getStride(),
+                 tb->prediction[0]->get_buffer<pixel_t>(),
+                 tb->prediction[0]->getStride(),
                  blkSize, blkSize);
       break;
 
@@ -110,11 +111,20 @@ float estim_TB_bitrate(const encoder_context* ectx,
         assert(blkSize <= 64);
 
         diff_blk(diff,blkSize,
-                 input->get_image_plane_at_pos(0, x0,y0), input->get_image_stride(0),
-                 tb->intra_prediction[0]->get_buffer_u8(),
-                 tb->intra_prediction[0]->getStride(),
+                 (const pixel_t*)input->get_image_plane_at_pos_any_depth(0, x0,y0), input->get_image_stride(0),
+                 tb->prediction[0]->get_buffer<pixel_t>(),
+                 tb->prediction[0]->getStride(),
                  blkSize);
 
+        // The transforms are the 8-bit versions. Bring a residual of a higher bit depth into
+        // their range. The estimate is only used to compare the prediction modes.
+        int bdShift = ectx->img->get_bit_depth(0) - 8;
+        if (bdShift > 0) {
+          for (int i=0;i<blkSize*blkSize;i++) {
+            diff[i] >>= bdShift;
+          }
+        }
+
         void (*transform)(int16_t *coeffs, const int16_t *src, ptrdiff_t stride);
 
 
@@ -170,6 +180,20 @@ float estim_TB_bitrate(const encoder_context* ectx,
 }
 
 
+float estim_TB_bitrate(const encoder_context* ectx,
+                       const de265_image* input,
+                       const enc_tb* tb,
+                       enum TBBitrateEstimMethod method)
+{
+  if (ectx->img->high_bit_depth(0)) {
+    return estim_TB_bitrate_internal<uint16_t>(ectx, input, tb, method);
+  }
+  else {
+    return estim_TB_bitrate_internal<uint8_t>(ectx, input, tb, method);
+  }
+}
+
+
 
 enc_tb*
 Algo_TB_IntraPredMode_BruteForce::analyze(encoder_context* ectx,
@@ -312,7 +336,8 @@ Algo_TB_IntraPredMode_MinResidual::analyze(encoder_context* ectx,
       intraMode = getPredMode(0);
     }
     else {
-      tb->intra_prediction[0] = std::make_shared<small_image_buffer>(log2TbSize, sizeof(uint8_t));
+      tb->prediction[0] = std::make_shared<small_image_buffer>(log2TbSize,
+                                                               ectx->img->get_bytes_per_pixel(0));
 
       for (int idx=0;idx<nPredModesEnabled();idx++) {
         enum IntraPredMode mode = getPredMode(idx);
@@ -428,7 +453,8 @@ Algo_TB_IntraPredMode_FastBrute::analyze(encoder_context* ectx,
     std::vector< std::pair<enum IntraPredMode,float> > distortions;
 
     int log2TbSize = tb->log2Size;
-    tb->intra_prediction[0] = std::make_shared<small_image_buffer>(log2TbSize, sizeof(uint8_t));
+    tb->prediction[0] = std::make_shared<small_image_buffer>(log2TbSize,
+                                                             ectx->img->get_bytes_per_pixel(0));
 
     for (int idx=0;idx<35;idx++)
       if (idx!=candidates[0] && idx!=candidates[1] && idx!=candidates[2] &&
@@ -506,7 +532,7 @@ Algo_TB_IntraPredMode_FastBrute::analyze(encoder_context* ectx,
                                                          opt_tb->intra_mode,
                                                          intraModeC,
                                                          option[i].get_context(),
-                                                         tb->blkIdx == 0);
+                                                         opt_tb->blkIdx == 0);
 
       opt_tb->rate_withoutCbfChroma += intraPredModeBits;
       opt_tb->rate += intraPredModeBits;
@@ -106,20 +106,28 @@ void compute_residual_channel(encoder_context* ectx, enc_tb* tb, const de265_ima
     mode = tb->intra_mode_chroma;
   }
 
-  // decode intra prediction
+  tb->prediction[cIdx] = std::make_shared<small_image_buffer>(log2Size, sizeof(pixel_t));
 
-  tb->intra_prediction[cIdx] = std::make_shared<small_image_buffer>(log2Size, sizeof(pixel_t));
+  if (tb->cb->PredMode == MODE_INTRA) {
+    // decode intra prediction
 
-  decode_intra_prediction_from_tree(ectx->img, tb, ectx->ctbs, ectx->get_sps(), cIdx);
+    decode_intra_prediction_from_tree(ectx->img, tb, ectx->ctbs, ectx->get_sps(), cIdx);
+  }
+  else {
+    // the inter prediction of the whole CB has been generated into the image by the PB algorithm
+
+    PixelAccessor predPixels(*tb->prediction[cIdx], x,y);
+    predPixels.copyFromImage(ectx->img, cIdx);
+  }
 
   // create residual buffer and compute differences
 
   tb->residual[cIdx] = std::make_shared<small_image_buffer>(log2Size, sizeof(int16_t));
 
   diff_blk<pixel_t>(tb->residual[cIdx]->get_buffer_s16(), blkSize,
-                    input->get_image_plane_at_pos(cIdx,x,y),
+                    (const pixel_t*)input->get_image_plane_at_pos_any_depth(cIdx,x,y),
                     input->get_image_stride(cIdx),
-                    tb->intra_prediction[cIdx]->get_buffer<pixel_t>(), blkSize,
+                    tb->prediction[cIdx]->get_buffer<pixel_t>(), blkSize,
                     blkSize);
 }
 
@@ -204,7 +212,10 @@ Algo_TB_Split_BruteForce::analyze(encoder_context* ectx,
     //tb_no_split = new enc_tb(*tb);
     *tb->downPtr = tb_no_split;
 
-    if (cb->PredMode == MODE_INTRA) {
+    if (ectx->img->high_bit_depth(0)) {
+      compute_residual<uint16_t>(ectx, tb_no_split, input, tb->blkIdx);
+    }
+    else {
       compute_residual<uint8_t>(ectx, tb_no_split, input, tb->blkIdx);
     }
 
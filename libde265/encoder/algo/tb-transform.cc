@@ -44,6 +44,18 @@ void diff_blk(int16_t* out,int out_stride,
       }
 }
 
+void diff_blk(int16_t* out,int out_stride,
+              const uint16_t* a_ptr, int a_stride,
+              const uint16_t* b_ptr, int b_stride,
+              int blkSize)
+{
+  for (int by=0;by<blkSize;by++)
+    for (int bx=0;bx<blkSize;bx++)
+      {
+        out[by*out_stride+bx] = a_ptr[by*a_stride+bx] - b_ptr[by*b_stride+bx];
+      }
+}
+
 
 static bool has_nonzero_value(const int16_t* data, int n)
 {
@@ -63,49 +75,13 @@ void compute_transform_coeffs(encoder_context* ectx,
                               const enc_cb* cb,
                               int cIdx)
 {
-  int xC = x0;
-  int yC = y0;
   int tbSize = 1<<log2TbSize;
-  if (cIdx>0) { xC>>=1; yC>>=1; }
 
   enum PredMode predMode = cb->PredMode;
 
-  int16_t blk[32*32]; // residual
-  int16_t* residual;
-
-
-  //printf("transform-coeffs %d;%d size:%d cIdx:%d\n", tb->x,tb->y,1<<tb->log2Size,cIdx);
-
-  // --- do intra prediction ---
-
-  if (predMode==MODE_INTRA) {
-    residual = tb->residual[cIdx]->get_buffer_s16();
-
-    //printf("intra residual: %p stride: %d\n",residual, tb->residual[cIdx]->get_stride());
-  }
-  else {
-    // --- subtract prediction from input image ---
-
-    /* TMP REMOVE: ectx->prediction does not exist anymore
-
-    uint8_t* pred = ectx->prediction->get_image_plane(cIdx);
-    int stride = ectx->prediction->get_image_stride(cIdx);
-
-    //printBlk("input",input->get_image_plane_at_pos(cIdx,xC,yC), tbSize, input->get_image_stride(cIdx));
-    //printBlk("prediction", pred,tbSize, stride);
-
-    diff_blk(blk,tbSize,
-             input->get_image_plane_at_pos(cIdx,xC,yC), input->get_image_stride(cIdx),
-             &pred[yC*stride+xC],stride, tbSize);
-
-    residual=blk;
-    */
-
-    //printBlk("residual", blk,tbSize,tbSize);
-  }
-
-
+  // residual of intra or inter prediction (computed in tb-split)
 
+  const int16_t* residual = tb->residual[cIdx]->get_buffer_s16();
 
 
   // --- forward transform ---
@@ -116,18 +92,22 @@ void compute_transform_coeffs(encoder_context* ectx,
   // transformation mode (DST or DCT)
 
   int trType;
-  if (cIdx==0 && log2TbSize==2 && predMode==MODE_INTRA) trType=1; // TODO: inter mode
+  if (cIdx==0 && log2TbSize==2 && predMode==MODE_INTRA) trType=1;
   else trType=0;
 
 
   // do forward transform
 
-  fwd_transform(&ectx->acceleration, tb->coeff[cIdx], tbSize, log2TbSize, trType,  residual, tbSize);
+  int bit_depth = ectx->get_sps().get_bit_depth(cIdx);
+
+  fwd_transform(&ectx->acceleration, tb->coeff[cIdx], tbSize, log2TbSize, trType,  residual, tbSize,
+                bit_depth);
 
 
   // --- quantization ---
 
-  quant_coefficients(tb->coeff[cIdx], tb->coeff[cIdx], log2TbSize,  cb->qp, true);
+  int qP = get_component_qp_prime(ectx->get_sps(), ectx->get_pps(), cb->qp, cIdx);
+  quant_coefficients(tb->coeff[cIdx], tb->coeff[cIdx], log2TbSize,  qP, true, bit_depth);
 
 
   // set CBF to 0 if there are no non-zero coefficients
@@ -245,10 +225,19 @@ enc_tb* Algo_TB_Transform::analyze(encoder_context* ectx,
   // measure distortion
 
   int tbSize = 1<<log2TbSize;
-  tb->distortion = SSD(input->get_image_plane_at_pos(0, x0,y0), input->get_image_stride(0),
-                       tb->reconstruction[0]->get_buffer_u8(),
-                       tb->reconstruction[0]->getStride(),
-                       tbSize, tbSize);
+  if (ectx->img->high_bit_depth(0)) {
+    tb->distortion = SSD((const uint16_t*)input->get_image_plane_at_pos_any_depth(0, x0,y0),
+                         input->get_image_stride(0),
+                         tb->reconstruction[0]->get_buffer_u16(),
+                         tb->reconstruction[0]->getStride(),
+                         tbSize, tbSize);
+  }
+  else {
+    tb->distortion = SSD(input->get_image_plane_at_pos(0, x0,y0), input->get_image_stride(0),
+                         tb->reconstruction[0]->get_buffer_u8(),
+                         tb->reconstruction[0]->getStride(),
+                         tbSize, tbSize);
+  }
 
   return tb;
 }
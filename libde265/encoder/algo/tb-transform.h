@@ -45,6 +45,11 @@ void diff_blk(int16_t* out,int out_stride,
               const uint8_t* b_ptr, int b_stride,
               int blkSize);
 
+void diff_blk(int16_t* out,int out_stride,
+              const uint16_t* a_ptr, int a_stride,
+              const uint16_t* b_ptr, int b_stride,
+              int blkSize);
+
 
 // ========== TB split decision ==========
 
@@ -129,12 +129,15 @@ de265_error encoder_context::encode_headers()
 
   // VPS
 
-  vps->set_defaults(Profile_Main, 6,2);
+  enum profile_idc profile = (image_bit_depth > 8 ? Profile_Main10 : Profile_Main);
+
+  vps->set_defaults(profile, 6,2);
 
 
   // SPS
 
   sps->set_defaults();
+  sps->profile_tier_level_.general.set_defaults(profile, 6,2);
   sps->set_CB_log2size_range( Log2(params.min_cb_size), Log2(params.max_cb_size));
   sps->set_TB_log2size_range( Log2(params.min_tb_size), Log2(params.max_tb_size));
   sps->max_transform_hierarchy_depth_intra = params.max_transform_hierarchy_depth_intra;
@@ -144,6 +147,11 @@ de265_error encoder_context::encode_headers()
     sps->chroma_format_idc = CHROMA_444;
   }
 
+  sps->bit_depth_luma   = image_bit_depth;
+  sps->bit_depth_chroma = image_bit_depth;
+
+  sps->sample_adaptive_offset_enabled_flag = params.sao;
+
   sps->set_resolution(image_width, image_height);
   sop->set_SPS_header_values();
   de265_error err = sps->compute_derived_values(true);
@@ -159,12 +167,38 @@ de265_error encoder_context::encode_headers()
   pps->sps = sps; //sps.get();
   pps->pic_init_qp = algo.getPPS_QP();
 
-  // turn off deblocking filter
+  // deblocking filter (with the default beta and tc)
   pps->deblocking_filter_control_present_flag = true;
   pps->deblocking_filter_override_enabled_flag = false;
-  pps->pic_disable_deblocking_filter_flag = true;
+  pps->pic_disable_deblocking_filter_flag = !params.deblocking;
   pps->pps_loop_filter_across_slices_enabled_flag = false;
 
+  // slices, tiles and WPP
+
+  if (params.tile_columns > sps->PicWidthInCtbsY ||
+      params.tile_rows    > sps->PicHeightInCtbsY) {
+    fprintf(stderr,"more tiles than CTBs in the picture\n");
+    exit(10);
+  }
+
+  // Main profile does not allow tiles together with WPP, and our slices are made of
+  // complete CTB rows, which do not fit into tiles.
+  bool tiles = (params.tile_columns > 1 || params.tile_rows > 1);
+  if (tiles && (params.entropy_coding_sync || params.slice_ctb_rows > 0)) {
+    fprintf(stderr,"tiles cannot be combined with WPP or slices\n");
+    exit(10);
+  }
+
+  pps->entropy_coding_sync_enabled_flag = params.entropy_coding_sync;
+
+  if (tiles) {
+    pps->tiles_enabled_flag = true;
+    pps->num_tile_columns = params.tile_columns;
+    pps->num_tile_rows    = params.tile_rows;
+    pps->uniform_spacing_flag = true;
+    pps->loop_filter_across_tiles_enabled_flag = false;
+  }
+
   pps->set_derived_values(sps.get());
 
 
@@ -219,6 +253,7 @@ de265_error encoder_context::encode_picture_from_input_buffer()
     const image_data* id = picbuf.peek_next_picture_to_encode();
     image_width  = id->input->get_width();
     image_height = id->input->get_height();
+    image_bit_depth = id->input->BitDepth_Y; // input images without SPS have 8 bits
     image_spec_is_defined = true;
 
     ctbs.alloc(image_width, image_height, Log2(params.max_cb_size));
@@ -229,12 +264,14 @@ de265_error encoder_context::encode_picture_from_input_buffer()
     algo.setParams(params);
 
 
-    // TODO: must be <30, because Y->C mapping (tab8_22) is not implemented yet
     int qp = algo.getPPS_QP();
 
     //lambda = ectx->params.lambda;
     lambda = 0.0242 * pow(1.27245, qp);
 
+    // the SSD distortion grows with the square of the sample range
+    lambda *= 1<<(2*(image_bit_depth-8));
+
     parameters_have_been_set = true;
   }
 
@@ -263,28 +300,28 @@ de265_error encoder_context::encode_picture_from_input_buffer()
 
   // slice
 
-  imgdata->shdr.slice_deblocking_filter_disabled_flag = true;
+  imgdata->shdr.slice_deblocking_filter_disabled_flag = pps->pic_disable_deblocking_filter_flag;
   imgdata->shdr.slice_loop_filter_across_slices_enabled_flag = false;
+  imgdata->shdr.slice_sao_luma_flag   = sps->sample_adaptive_offset_enabled_flag;
+  imgdata->shdr.slice_sao_chroma_flag = sps->sample_adaptive_offset_enabled_flag;
   imgdata->shdr.compute_derived_values(pps.get());
 
   imgdata->shdr.pps = pps;
 
   //shdr.slice_pic_order_cnt_lsb = poc & 0xFF;
 
-  imgdata->nal.write(cabac_encoder);
-  imgdata->shdr.write(this, cabac_encoder, sps.get(), pps.get(), imgdata->nal.nal_unit_type);
-  cabac_encoder.add_trailing_bits();
-  cabac_encoder.flush_VLC();
-
 
-  // encode image
+  // encode image (slice data of all slice segments)
 
   cabac_encoder.init_CABAC();
   double psnr = encode_image(this,imgdata->input, algo);
   loginfo(LogEncoder,"  PSNR-Y: %f\n", psnr);
-  cabac_encoder.flush_CABAC();
-  cabac_encoder.add_trailing_bits();
-  cabac_encoder.flush_VLC();
+
+  // The entry points are only known after encoding the slice data. Take the data out
+  // of the bitstream buffer and put it behind the slice headers below.
+  std::vector<uint8_t> slice_data(cabac_encoder.data(),
+                                  cabac_encoder.data() + cabac_encoder.size());
+  cabac_encoder.reset();
 
 
   // set reconstruction image
@@ -295,16 +332,53 @@ de265_error encoder_context::encode_picture_from_input_buffer()
   this->imgdata = NULL;
   this->shdr = NULL;
 
-  // build output packet
+  // build output packets, one per slice segment
 
-  en265_packet* pck = create_packet(EN265_PACKET_SLICE);
-  pck->input_image    = imgdata->input;
-  pck->reconstruction = imgdata->reconstruction;
-  pck->frame_number   = imgdata->frame_number;
-  pck->nal_unit_type  = (enum en265_nal_unit_type)imgdata->nal.nal_unit_type;
-  pck->nuh_layer_id   = imgdata->nal.nuh_layer_id;
-  pck->nuh_temporal_id= imgdata->nal.nuh_temporal_id;
-  output_packets.push_back(pck);
+  int segmentStart = 0;
+
+  for (size_t i=0;i<slice_segments.size();i++) {
+    const slice_segment_data& segment = slice_segments[i];
+    slice_segment_header& shdr = imgdata->shdr;
+
+    shdr.first_slice_segment_in_pic_flag = (i==0);
+    shdr.slice_segment_address = segment.slice_segment_address;
+    shdr.SliceAddrRS = segment.slice_segment_address;
+
+    shdr.entry_point_offset = segment.entry_point_offset;
+    shdr.num_entry_point_offsets = shdr.entry_point_offset.size();
+
+    shdr.offset_len = 1;
+    for (int k=0;k<shdr.num_entry_point_offsets;k++) {
+      int substreamSize = shdr.entry_point_offset[k] - (k>0 ? shdr.entry_point_offset[k-1] : 0);
+      while ((1<<shdr.offset_len) < substreamSize) {
+        shdr.offset_len++;
+      }
+    }
+
+    imgdata->nal.write(cabac_encoder);
+    shdr.write(this, cabac_encoder, sps.get(), pps.get(), imgdata->nal.nal_unit_type);
+    cabac_encoder.add_trailing_bits();
+    cabac_encoder.flush_VLC();
+
+    cabac_encoder.append_data(slice_data.data() + segmentStart, segment.data_end - segmentStart);
+    segmentStart = segment.data_end;
+
+    en265_packet* pck = create_packet(EN265_PACKET_SLICE);
+    pck->nal_unit_type  = (enum en265_nal_unit_type)imgdata->nal.nal_unit_type;
+    pck->nuh_layer_id   = imgdata->nal.nuh_layer_id;
+    pck->nuh_temporal_id= imgdata->nal.nuh_temporal_id;
+
+    // Only the last packet refers to the picture, because releasing that packet
+    // marks the picture as output.
+    if (i==slice_segments.size()-1) {
+      pck->input_image    = imgdata->input;
+      pck->reconstruction = imgdata->reconstruction;
+      pck->frame_number   = imgdata->frame_number;
+      pck->final_slice    = 1;
+    }
+
+    output_packets.push_back(pck);
+  }
 
 
   picbuf.mark_encoding_finished(imgdata->frame_number);
@@ -57,7 +57,8 @@ class encoder_context : public base_context
   EncoderCore_Custom algo;
 
   int image_width, image_height;
-  bool image_spec_is_defined;  // whether we know the input image size
+  int image_bit_depth;
+  bool image_spec_is_defined;  // whether we know the input image size and bit depth
 
   void* param_image_allocation_userdata;
   /*
@@ -77,6 +78,16 @@ class encoder_context : public base_context
 
   CTBTreeMatrix ctbs;
 
+  // Slice segments of the current picture. encode_image() writes the slice data of all
+  // segments into 'cabac_encoder' and notes here where each segment and substream ends.
+  struct slice_segment_data {
+    int slice_segment_address;           // first CTB (raster scan)
+    int data_end;                        // end of the slice data in the bitstream buffer
+    std::vector<int> entry_point_offset; // substream starts, relative to the slice data
+  };
+
+  std::vector<slice_segment_data> slice_segments;
+
   // temporary memory for motion compensated pixels (when CB-algo passes this down to TB-algo)
   //uint8_t prediction[3][64*64]; // stride: 1<<(cb->log2Size)
   //int prediction_x0,prediction_y0;
@@ -24,6 +24,9 @@
 #include "libde265/encoder/encoder-core.h"
 #include "libde265/encoder/encoder-context.h"
 #include "libde265/encoder/encoder-syntax.h"
+#include "libde265/encoder/encoder-sao.h"
+#include "libde265/deblock.h"
+#include "libde265/sao.h"
 #include <assert.h>
 #include <limits>
 #include <math.h>
@@ -177,18 +180,44 @@ double encode_image(encoder_context* ectx,
   double mse=0;
 
 
-  // encode CTB by CTB
+  // encode CTB by CTB (in tile scan order)
 
   ectx->ctbs.clear();
 
-  for (int y=0;y<ectx->get_sps().PicHeightInCtbsY;y++)
-    for (int x=0;x<ectx->get_sps().PicWidthInCtbsY;x++)
+  const seq_parameter_set& sps = ectx->get_sps();
+  const pic_parameter_set& pps = ectx->get_pps();
+  const int sliceCtbRows = ectx->params.slice_ctb_rows;
+
+  encoder_context::slice_segment_data segment;
+  segment.slice_segment_address = 0;
+  int segmentStart = ectx->cabac_encoder.size();
+
+  ectx->slice_segments.clear();
+
+  // WPP: context models after the second CTB of the row above
+  context_model_table wppCtxModels;
+
+  for (int ctbAddrTS=0;ctbAddrTS<sps.PicSizeInCtbsY;ctbAddrTS++)
       {
-        ectx->img->set_SliceAddrRS(x, y, ectx->shdr->SliceAddrRS);
+        int ctbAddrRS = pps.CtbAddrTStoRS[ctbAddrTS];
+        int x = ctbAddrRS % sps.PicWidthInCtbsY;
+        int y = ctbAddrRS / sps.PicWidthInCtbsY;
+
+        ectx->img->set_SliceAddrRS(x, y, segment.slice_segment_address);
 
         int x0 = x<<Log2CtbSize;
         int y0 = y<<Log2CtbSize;
 
+        // slice header of the CTB (for the in-loop filters)
+
+        if (ctbAddrRS == segment.slice_segment_address) {
+          slice_segment_header* segmentHeader = new slice_segment_header(*ectx->shdr);
+          segmentHeader->SliceAddrRS = segment.slice_segment_address;
+          ectx->img->add_slice_segment_header(segmentHeader);
+        }
+
+        ectx->img->set_SliceHeaderIndex(x0,y0, ectx->img->slices.size()-1);
+
         logtrace(LogSlice,"encode CTB at %d %d\n",x0,y0);
 
         // make a copy of the context model that we can modify for testing alternatives
@@ -261,6 +290,14 @@ double encode_image(encoder_context* ectx,
         cb->debug_assertTreeConsistency(ectx->img);
         */
 
+        if (ectx->shdr->slice_sao_luma_flag || ectx->shdr->slice_sao_chroma_flag) {
+          sao_info saoinfo;
+
+          cb->writeReconstructionToImage(ectx->img, &sps);
+          choose_sao_parameters(ectx, input, x,y, &saoinfo);
+          ectx->img->set_sao_info(x,y, &saoinfo);
+        }
+
         encode_ctb(ectx, &ectx->cabac_encoder, cb, x,y);
 
         //printf("================================================== WRITE\n");
@@ -278,9 +315,65 @@ double encode_image(encoder_context* ectx,
         }
 
 
-        int last = (y==ectx->get_sps().PicHeightInCtbsY-1 &&
-                    x==ectx->get_sps().PicWidthInCtbsY-1);
-        ectx->cabac_encoder.write_CABAC_term_bit(last);
+        bool lastInPicture = (ctbAddrTS == sps.PicSizeInCtbsY-1);
+
+        // slices always start at the beginning of a CTB row (slices cannot be combined with tiles)
+        bool endOfSlice = (lastInPicture ||
+                           (sliceCtbRows > 0 &&
+                            x == sps.PicWidthInCtbsY-1 &&
+                            (y+1) % sliceCtbRows == 0));
+
+        bool endOfSubstream = (!endOfSlice &&
+                               ((pps.entropy_coding_sync_enabled_flag &&
+                                 x == sps.PicWidthInCtbsY-1) ||
+                                (pps.tiles_enabled_flag &&
+                                 pps.TileId[ctbAddrTS] != pps.TileId[ctbAddrTS+1])));
+
+        ectx->cabac_encoder.write_CABAC_term_bit(endOfSlice); // end_of_slice_segment_flag
+
+        if (pps.entropy_coding_sync_enabled_flag && x==1) {
+          wppCtxModels = ectx->cabac_ctx_models.copy();
+        }
+
+        if (endOfSubstream) {
+          ectx->cabac_encoder.write_CABAC_term_bit(1); // end_of_subset_one_bit
+        }
+
+        if (endOfSlice || endOfSubstream) {
+          ectx->cabac_encoder.flush_CABAC();
+          ectx->cabac_encoder.add_trailing_bits();
+          ectx->cabac_encoder.flush_VLC();
+
+          if (endOfSubstream) {
+            segment.entry_point_offset.push_back(ectx->cabac_encoder.size() - segmentStart);
+          }
+          else {
+            segment.data_end = ectx->cabac_encoder.size();
+            ectx->slice_segments.push_back(segment);
+
+            if (!lastInPicture) {
+              segment.slice_segment_address = pps.CtbAddrTStoRS[ctbAddrTS+1];
+              segment.entry_point_offset.clear();
+              segmentStart = segment.data_end;
+            }
+          }
+
+
+          // restart the CABAC coder for the next substream
+
+          if (!lastInPicture) {
+            ectx->cabac_encoder.init_CABAC();
+
+            if (endOfSubstream &&
+                pps.entropy_coding_sync_enabled_flag &&
+                sps.PicWidthInCtbsY > 1) {
+              ectx->cabac_ctx_models = wppCtxModels.copy();
+            }
+            else {
+              ectx->cabac_ctx_models.init(ectx->shdr->initType, ectx->shdr->SliceQPY);
+            }
+          }
+        }
 
         //delete cb;
 
@@ -305,6 +398,16 @@ double encode_image(encoder_context* ectx,
 
   ectx->ctbs.writeReconstructionToImage(ectx->img, &ectx->get_sps());
 
+
+  // in-loop filters (the filtered picture is the reference for the following pictures)
+
+  if (!ectx->shdr->slice_deblocking_filter_disabled_flag) {
+    ectx->ctbs.writeTransformTreesToImage(ectx->img);
+    apply_deblocking_filter(ectx->img);
+  }
+
+  apply_sample_adaptive_offset(ectx->img);
+
 #if 0
   std::ofstream ostr("out.pgm");
   ostr << "P5\n" << ectx->img->get_width() << " " << ectx->img->get_height() << "\n255\n";
@@ -313,7 +416,7 @@ double encode_image(encoder_context* ectx,
   }
 #endif
 
-  double psnr = 10*log10(255.0*255.0 / mse);
+  double psnr = PSNR(mse, ectx->get_sps().BitDepth_Y);
 
 #if 0
   double psnr2 = PSNR(MSE(input->get_image_plane(0), input->get_image_stride(0),
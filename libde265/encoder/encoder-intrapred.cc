@@ -140,11 +140,11 @@ void intra_border_computer_ctbtree<pixel_t>::fill_from_ctbtree(const enc_tb* blk
         if (availableN) {
           PixelAccessor pa = cb->transform_tree->getPixels(xN,yN, this->cIdx, *this->sps);
 
-          if (!this->nAvail) this->firstValue = pa[this->yB+y][this->xB-1];
+          if (!this->nAvail) this->firstValue = pa.get_row<pixel_t>(this->yB+y)[this->xB-1];
 
           for (int i=0;i<4;i++) {
             this->available[-y+i-1] = availableN;
-            this->out_border[-y+i-1] = pa[this->yB+y-i][this->xB-1];
+            this->out_border[-y+i-1] = pa.get_row<pixel_t>(this->yB+y-i)[this->xB-1];
           }
 
           this->nAvail+=4;
@@ -175,7 +175,7 @@ void intra_border_computer_ctbtree<pixel_t>::fill_from_ctbtree(const enc_tb* blk
       if (availableN) {
         PixelAccessor pa = cb->transform_tree->getPixels(xN,yN, this->cIdx, *this->sps);
 
-        this->out_border[0] = pa[this->yB-1][this->xB-1];
+        this->out_border[0] = pa.get_row<pixel_t>(this->yB-1)[this->xB-1];
         this->available[0] = availableN;
 
         if (!this->nAvail) this->firstValue = this->out_border[0];
@@ -214,10 +214,10 @@ void intra_border_computer_ctbtree<pixel_t>::fill_from_ctbtree(const enc_tb* blk
         if (availableN) {
           PixelAccessor pa = cb->transform_tree->getPixels(xN,yN, this->cIdx, *this->sps);
 
-          if (!this->nAvail) this->firstValue = pa[this->yB-1][this->xB+x];
+          if (!this->nAvail) this->firstValue = pa.get_row<pixel_t>(this->yB-1)[this->xB+x];
 
           for (int i=0;i<4;i++) {
-            this->out_border[x+i+1] = pa[this->yB-1][this->xB+x+i];
+            this->out_border[x+i+1] = pa.get_row<pixel_t>(this->yB-1)[this->xB+x+i];
             this->available[x+i+1] = availableN;
           }
 
@@ -279,8 +279,8 @@ void decode_intra_prediction_from_tree_internal(const de265_image* img,
   if (cIdx==0) intraPredMode = tb->intra_mode;
   else         intraPredMode = tb->intra_mode_chroma;
 
-  pixel_t* dst = tb->intra_prediction[cIdx]->get_buffer<pixel_t>();
-  int dstStride = tb->intra_prediction[cIdx]->getStride();
+  pixel_t* dst = tb->prediction[cIdx]->get_buffer<pixel_t>();
+  int dstStride = tb->prediction[cIdx]->getStride();
 
   pixel_t  border_pixels_mem[4*MAX_INTRA_PRED_BLOCK_SIZE+1];
   pixel_t* border_pixels = &border_pixels_mem[2*MAX_INTRA_PRED_BLOCK_SIZE];
@@ -313,8 +313,7 @@ void decode_intra_prediction_from_tree_internal(const de265_image* img,
     break;
   default:
     {
-      //int bit_depth = img->get_bit_depth(cIdx);
-      int bit_depth = 8; // TODO
+      int bit_depth = img->get_bit_depth(cIdx);
 
       bool disableIntraBoundaryFilter =
         (sps.range_extension.implicit_rdpcm_enabled_flag &&
@@ -334,7 +333,10 @@ void decode_intra_prediction_from_tree(const de265_image* img,
                                        const seq_parameter_set& sps,
                                        int cIdx)
 {
-  // TODO: high bit depths
-
-  decode_intra_prediction_from_tree_internal<uint8_t>(img ,tb, ctbs, sps, cIdx);
+  if (img->high_bit_depth(cIdx)) {
+    decode_intra_prediction_from_tree_internal<uint16_t>(img ,tb, ctbs, sps, cIdx);
+  }
+  else {
+    decode_intra_prediction_from_tree_internal<uint8_t>(img ,tb, ctbs, sps, cIdx);
+  }
 }
@@ -51,6 +51,27 @@ encoder_params::encoder_params()
 
   sop_structure.set_ID("sop-structure");
 
+  entropy_coding_sync.set_ID("wpp");
+  entropy_coding_sync.set_default(false);
+  entropy_coding_sync.set_description("wavefront parallel processing (one substream per CTB row)");
+
+  tile_columns.set_ID("tile-columns"); tile_columns.set_range(1,DE265_MAX_TILE_COLUMNS);
+  tile_columns.set_default(1);
+  tile_rows.set_ID("tile-rows"); tile_rows.set_range(1,DE265_MAX_TILE_ROWS);
+  tile_rows.set_default(1);
+
+  slice_ctb_rows.set_ID("slice-ctb-rows"); slice_ctb_rows.set_minimum(0);
+  slice_ctb_rows.set_default(0);
+  slice_ctb_rows.set_description("start a new slice every n CTB rows (0: one slice per picture)");
+
+  deblocking.set_ID("deblocking");
+  deblocking.set_default(false);
+  deblocking.set_description("enable the deblocking filter");
+
+  sao.set_ID("sao");
+  sao.set_default(false);
+  sao.set_description("enable sample adaptive offset (edge offsets only)");
+
   mAlgo_TB_IntraPredMode.set_ID("TB-IntraPredMode");
   mAlgo_TB_IntraPredMode_Subset.set_ID("TB-IntraPredMode-subset");
   mAlgo_CB_IntraPartMode.set_ID("CB-IntraPartMode");
@@ -72,6 +93,14 @@ void encoder_params::registerParams(config_parameters& config)
 
   config.add_option(&sop_structure);
 
+  config.add_option(&entropy_coding_sync);
+  config.add_option(&tile_columns);
+  config.add_option(&tile_rows);
+  config.add_option(&slice_ctb_rows);
+
+  config.add_option(&deblocking);
+  config.add_option(&sao);
+
   config.add_option(&mAlgo_TB_IntraPredMode);
   config.add_option(&mAlgo_TB_IntraPredMode_Subset);
   config.add_option(&mAlgo_CB_IntraPartMode);
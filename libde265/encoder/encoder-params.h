@@ -96,6 +96,20 @@ struct encoder_params
   sop_creator_trivial_low_delay::params mSOP_LowDelay;
 
 
+  // slices, tiles and WPP (substreams with entry points)
+
+  option_bool entropy_coding_sync;
+  option_int  tile_columns;
+  option_int  tile_rows;
+  option_int  slice_ctb_rows; // 0: one slice per picture
+
+
+  // in-loop filters
+
+  option_bool deblocking;
+  option_bool sao;
+
+
   // --- Algo_TB_IntraPredMode
 
   option_ALGO_TB_IntraPredMode        mAlgo_TB_IntraPredMode;
@@ -0,0 +1,191 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "encoder/encoder-sao.h"
+#include "encoder/encoder-context.h"
+#include "util.h"
+
+#include <string.h>
+
+
+// sums of (input - reconstruction) for the four edge categories of one EO class
+struct eo_statistics
+{
+  int64_t diff[4];
+  int     count[4];
+};
+
+
+template <class pixel_t>
+static void collect_eo_statistics(const de265_image* input, const de265_image* img,
+                                  int cIdx, int xC,int yC, int ctbW,int ctbH,
+                                  int eoClass, eo_statistics* stats)
+{
+  static const int hPos[4][2] = { { -1,1 }, { 0,0 }, { -1,1 }, { 1,-1 } };
+  static const int vPos[4][2] = { {  0,0 }, { -1,1 }, { -1,1 }, { -1,1 } };
+
+  const pixel_t* in  = (const pixel_t*)input->get_image_plane(cIdx);
+  const pixel_t* rec = (const pixel_t*)img->get_image_plane(cIdx);
+  const int inStride  = input->get_image_stride(cIdx);
+  const int recStride = img->get_image_stride(cIdx);
+
+  const int width  = img->get_width(cIdx);
+  const int height = img->get_height(cIdx);
+
+  memset(stats, 0, sizeof(eo_statistics));
+
+  for (int y=yC;y<yC+ctbH;y++)
+    for (int x=xC;x<xC+ctbW;x++) {
+      int xa = x+hPos[eoClass][0], ya = y+vPos[eoClass][0];
+      int xb = x+hPos[eoClass][1], yb = y+vPos[eoClass][1];
+
+      if (xa<0 || ya<0 || xb<0 || yb<0 ||
+          xa>=width || ya>=height || xb>=width || yb>=height) {
+        continue;
+      }
+
+      int p = rec[x+y*recStride];
+      int edgeIdx = 2 + Sign(p - rec[xa+ya*recStride]) + Sign(p - rec[xb+yb*recStride]);
+
+      if (edgeIdx==2) {
+        continue;
+      }
+
+      // index into saoOffsetVal[]
+      int category = (edgeIdx<2 ? edgeIdx : edgeIdx-1);
+
+      stats->diff[category] += in[x+y*inStride] - p;
+      stats->count[category]++;
+    }
+}
+
+
+/* Choose the offsets for the statistics of one component. Categories 0 and 1 (local
+   minima) only allow positive offsets, categories 2 and 3 only negative ones.
+   Returns the change of the distortion plus the rate of the offsets (weighted by lambda).
+ */
+static double choose_eo_offsets(const eo_statistics& stats, int maxOffset, double lambda,
+                                int8_t offsets[4])
+{
+  double totalCost = 0;
+
+  for (int i=0;i<4;i++) {
+    offsets[i] = 0;
+
+    int64_t diff = stats.diff[i];
+    int count = stats.count[i];
+
+    if (count==0) {
+      totalCost += lambda; // sao_offset_abs = 0
+      continue;
+    }
+
+    int offset = (int)((diff + (diff>=0 ? count/2 : -count/2)) / count);
+
+    if (i<2) { offset = Clip3(0, maxOffset, offset); }
+    else     { offset = Clip3(-maxOffset, 0, offset); }
+
+    // try smaller offsets, as these are cheaper to code
+
+    double bestCost = lambda;
+    for (int o=offset; o!=0; o += (o>0 ? -1 : 1)) {
+      int bits = abs(o) + (abs(o)<maxOffset ? 1 : 0);
+      double cost = (double)count*o*o - 2.0*o*diff + lambda*bits;
+
+      if (cost < bestCost) {
+        bestCost = cost;
+        offsets[i] = o;
+      }
+    }
+
+    totalCost += bestCost;
+  }
+
+  return totalCost;
+}
+
+
+void choose_sao_parameters(encoder_context* ectx, const de265_image* input,
+                           int xCtb,int yCtb, sao_info* saoinfo)
+{
+  const seq_parameter_set& sps = ectx->get_sps();
+  const de265_image* img = ectx->img;
+
+  memset(saoinfo, 0, sizeof(sao_info));
+
+  int nComponents = (sps.ChromaArrayType == CHROMA_MONO ? 1 : 3);
+
+  // luma is decided alone, Cb and Cr share the SAO type and EO class
+
+  for (int firstComp=0; firstComp<nComponents; firstComp += (firstComp==0 ? 1 : 2)) {
+    int lastComp = (firstComp==0 ? 0 : 2);
+
+    if ((firstComp==0 && !ectx->shdr->slice_sao_luma_flag) ||
+        (firstComp>0  && !ectx->shdr->slice_sao_chroma_flag)) {
+      continue;
+    }
+
+    int bitDepth  = sps.get_bit_depth(firstComp);
+    int maxOffset = (1<<(libde265_min(bitDepth,10)-5))-1;
+
+    double bestCost = ectx->lambda * 1; // sao_type_idx = 0
+    int    bestClass = -1;
+    int8_t bestOffsets[3][4];
+
+    for (int eoClass=0; eoClass<4; eoClass++) {
+      double cost = ectx->lambda * (2+2); // sao_type_idx, sao_eo_class
+      int8_t offsets[3][4];
+
+      for (int cIdx=firstComp; cIdx<=lastComp; cIdx++) {
+        int nSW = (1<<sps.Log2CtbSizeY) >> sps.get_chroma_shift_W(cIdx);
+        int nSH = (1<<sps.Log2CtbSizeY) >> sps.get_chroma_shift_H(cIdx);
+
+        int xC = xCtb*nSW;
+        int yC = yCtb*nSH;
+        int ctbW = libde265_min(nSW, img->get_width(cIdx)  - xC);
+        int ctbH = libde265_min(nSH, img->get_height(cIdx) - yC);
+
+        eo_statistics stats;
+        if (img->high_bit_depth(cIdx)) {
+          collect_eo_statistics<uint16_t>(input,img, cIdx, xC,yC, ctbW,ctbH, eoClass, &stats);
+        }
+        else {
+          collect_eo_statistics<uint8_t>(input,img, cIdx, xC,yC, ctbW,ctbH, eoClass, &stats);
+        }
+
+        cost += choose_eo_offsets(stats, maxOffset, ectx->lambda, offsets[cIdx]);
+      }
+
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestClass = eoClass;
+        memcpy(bestOffsets, offsets, sizeof(offsets));
+      }
+    }
+
+    if (bestClass >= 0) {
+      for (int cIdx=firstComp; cIdx<=lastComp; cIdx++) {
+        saoinfo->SaoTypeIdx |= 2 << (2*cIdx);
+        saoinfo->SaoEoClass |= bestClass << (2*cIdx);
+        memcpy(saoinfo->saoOffsetVal[cIdx], bestOffsets[cIdx], 4);
+      }
+    }
+  }
+}
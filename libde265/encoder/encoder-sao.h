@@ -0,0 +1,34 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DE265_ENCODER_SAO_H
+#define DE265_ENCODER_SAO_H
+
+#include "libde265/image.h"
+#include "libde265/slice.h"
+
+/* Choose the SAO parameters of a CTB by comparing its reconstruction in ectx->img
+   with the input image. Only edge offsets are used. The statistics are taken before
+   deblocking, as the parameters have to be known when the CTB is written.
+ */
+void choose_sao_parameters(class encoder_context* ectx, const de265_image* input,
+                           int xCtb,int yCtb, sao_info* saoinfo);
+
+#endif
@@ -1350,9 +1350,9 @@ void encode_merge_idx(encoder_context* ectx,
 }
 
 
-static inline void encode_rqt_root_cbf(encoder_context* ectx,
-                                       CABAC_encoder* cabac,
-                                       int rqt_root_cbf)
+void encode_rqt_root_cbf(encoder_context* ectx,
+                         CABAC_encoder* cabac,
+                         int rqt_root_cbf)
 {
   logtrace(LogSymbols,"$1 rqt_root_cbf=%d\n",rqt_root_cbf);
   cabac->write_CABAC_bit(CONTEXT_MODEL_RQT_ROOT_CBF, rqt_root_cbf);
@@ -1701,6 +1701,110 @@ void encode_quadtree(encoder_context* ectx,
 }
 
 
+static void encode_sao_merge_flag(CABAC_encoder* cabac, int flag)
+{
+  logtrace(LogSymbols,"$1 sao_merge_flag=%d\n",flag);
+  cabac->write_CABAC_bit(CONTEXT_MODEL_SAO_MERGE_FLAG, flag);
+}
+
+
+static void encode_sao_type_idx(CABAC_encoder* cabac, int SaoTypeIdx)
+{
+  logtrace(LogSymbols,"$1 sao_type_idx=%d\n",SaoTypeIdx);
+
+  cabac->write_CABAC_bit(CONTEXT_MODEL_SAO_TYPE_IDX, SaoTypeIdx != 0);
+
+  if (SaoTypeIdx != 0) {
+    cabac->write_CABAC_bypass(SaoTypeIdx==2);
+  }
+}
+
+
+/* Write the SAO parameters of the CTB, as stored in the image. The parameters are merged
+   with the left or upper CTB when they are equal.
+ */
+static void encode_sao(encoder_context* ectx,
+                       CABAC_encoder* cabac,
+                       int xCtb,int yCtb)
+{
+  const de265_image* img = ectx->img;
+  const seq_parameter_set& sps = ectx->get_sps();
+  const pic_parameter_set& pps = ectx->get_pps();
+  const slice_segment_header* shdr = ectx->shdr;
+
+  const sao_info* saoinfo = img->get_sao_info(xCtb,yCtb);
+
+  int ctbAddrRS   = xCtb + yCtb*sps.PicWidthInCtbsY;
+  int sliceAddrRS = img->get_SliceAddrRS(xCtb,yCtb);
+
+  if (xCtb>0) {
+    bool leftCtbInSliceSeg = (ctbAddrRS > sliceAddrRS);
+    bool leftCtbInTile = (pps.TileIdRS[ctbAddrRS] == pps.TileIdRS[ctbAddrRS-1]);
+
+    if (leftCtbInSliceSeg && leftCtbInTile) {
+      int sao_merge_left_flag = (memcmp(saoinfo, img->get_sao_info(xCtb-1,yCtb),
+                                        sizeof(sao_info)) == 0);
+      encode_sao_merge_flag(cabac, sao_merge_left_flag);
+
+      if (sao_merge_left_flag) {
+        return;
+      }
+    }
+  }
+
+  if (yCtb>0) {
+    bool upCtbInSliceSeg = (ctbAddrRS - sps.PicWidthInCtbsY >= sliceAddrRS);
+    bool upCtbInTile = (pps.TileIdRS[ctbAddrRS] == pps.TileIdRS[ctbAddrRS-sps.PicWidthInCtbsY]);
+
+    if (upCtbInSliceSeg && upCtbInTile) {
+      int sao_merge_up_flag = (memcmp(saoinfo, img->get_sao_info(xCtb,yCtb-1),
+                                      sizeof(sao_info)) == 0);
+      encode_sao_merge_flag(cabac, sao_merge_up_flag);
+
+      if (sao_merge_up_flag) {
+        return;
+      }
+    }
+  }
+
+  int nChroma = (sps.ChromaArrayType == CHROMA_MONO ? 1 : 3);
+
+  for (int cIdx=0; cIdx<nChroma; cIdx++) {
+    if ((shdr->slice_sao_luma_flag && cIdx==0) ||
+        (shdr->slice_sao_chroma_flag && cIdx>0)) {
+
+      int SaoTypeIdx = (saoinfo->SaoTypeIdx >> (2*cIdx)) & 0x3;
+
+      if (cIdx<2) {
+        encode_sao_type_idx(cabac, SaoTypeIdx);
+      }
+
+      if (SaoTypeIdx != 0) {
+        int bitDepth = sps.get_bit_depth(cIdx);
+        int cMax = (1<<(libde265_min(bitDepth,10)-5))-1;
+
+        for (int i=0;i<4;i++) {
+          cabac->write_CABAC_TU_bypass(abs(saoinfo->saoOffsetVal[cIdx][i]), cMax);
+        }
+
+        if (SaoTypeIdx==1) {
+          for (int i=0;i<4;i++) {
+            if (saoinfo->saoOffsetVal[cIdx][i] != 0) {
+              cabac->write_CABAC_bypass(saoinfo->saoOffsetVal[cIdx][i] < 0);
+            }
+          }
+
+          cabac->write_CABAC_FL_bypass(saoinfo->sao_band_position[cIdx], 5);
+        }
+        else if (cIdx<2) {
+          cabac->write_CABAC_FL_bypass((saoinfo->SaoEoClass >> (2*cIdx)) & 0x3, 2);
+        }
+      }
+    }
+  }
+}
+
+
 void encode_ctb(encoder_context* ectx,
                 CABAC_encoder* cabac,
                 enc_cb* cb, int ctbX,int ctbY)
@@ -1723,6 +1827,10 @@ void encode_ctb(encoder_context* ectx,
   de265_image* img = ectx->img;
   int log2ctbSize = img->get_sps().Log2CtbSizeY;
 
+  if (ectx->shdr->slice_sao_luma_flag || ectx->shdr->slice_sao_chroma_flag) {
+    encode_sao(ectx,cabac, ctbX,ctbY);
+  }
+
   encode_quadtree(ectx,cabac, cb, ctbX<<log2ctbSize, ctbY<<log2ctbSize, log2ctbSize, 0, true);
 }
 
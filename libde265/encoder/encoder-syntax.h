@@ -77,6 +77,15 @@ void encode_cu_skip_flag(encoder_context* ectx,
                          const enc_cb* cb,
                          bool skip);
 
+void encode_prediction_unit(encoder_context* ectx,
+                            CABAC_encoder* cabac,
+                            const enc_cb* cb, int pbIdx,
+                            int x0,int y0, int w, int h);
+
+void encode_rqt_root_cbf(encoder_context* ectx,
+                         CABAC_encoder* cabac,
+                         int rqt_root_cbf);
+
 void encode_cbf_luma(CABAC_encoder* cabac,
                      bool zeroTrafoDepth, int cbf_luma);
 
@@ -134,59 +134,23 @@ void enc_tb::reconstruct_tb(encoder_context* ectx,
 
   if (!reconstruction[cIdx]) {
 
-    reconstruction[cIdx] = std::make_shared<small_image_buffer>(log2TbSize, sizeof(uint8_t));
+    reconstruction[cIdx] = std::make_shared<small_image_buffer>(log2TbSize,
+                                                                img->get_bytes_per_pixel(cIdx));
 
     if (cb->PredMode == MODE_SKIP) {
       PixelAccessor dstPixels(*reconstruction[cIdx], xC,yC);
       dstPixels.copyFromImage(img, cIdx);
     }
     else { // not SKIP mode
-      if (cb->PredMode == MODE_INTRA) {
+      // The intra or inter prediction has been stored in the TB by tb-split.
 
-        //enum IntraPredMode intraPredMode  = img->get_IntraPredMode(x0,y0);
-        enum IntraPredMode intraPredMode  = intra_mode;
-
-        if (cIdx>0) {
-          intraPredMode = intra_mode_chroma;
-        }
-
-        //printf("reconstruct TB (%d;%d): intra mode (cIdx=%d) = %d\n",xC,yC,cIdx,intraPredMode);
-
-        //decode_intra_prediction(img, xC,yC,  intraPredMode, 1<< log2TbSize   , cIdx);
-
-        //printf("access intra-prediction of TB %p\n",this);
-
-        intra_prediction[cIdx]->copy_to(*reconstruction[cIdx]);
-        /*
-          copy_subimage(img->get_image_plane_at_pos(cIdx,xC,yC),
-          img->get_image_stride(cIdx),
-          intra_prediction[cIdx]->get_buffer<uint8_t>(), 1<<log2TbSize,
-          1<<log2TbSize, 1<<log2TbSize);
-        */
-      }
-      else {
-        assert(0); // -> TODO: now only store in tb_enc
-
-        int size = 1<<log2TbSize;
-
-        uint8_t* dst_ptr  = img->get_image_plane_at_pos(cIdx, xC,  yC  );
-        int dst_stride  = img->get_image_stride(cIdx);
-
-        /* TODO TMP HACK: prediction does not exist anymore
-        uint8_t* src_ptr  = ectx->prediction->get_image_plane_at_pos(cIdx, xC,  yC  );
-        int src_stride  = ectx->prediction->get_image_stride(cIdx);
-
-        for (int y=0;y<size;y++) {
-          for (int x=0;x<size;x++) {
-            dst_ptr[y*dst_stride+x] = src_ptr[y*src_stride+x];
-          }
-        }
-        */
-      }
+      prediction[cIdx]->copy_to(*reconstruction[cIdx]);
 
       ALIGNED_16(int16_t) dequant_coeff[32*32];
 
-      if (cbf[cIdx]) dequant_coefficients(dequant_coeff, coeff[cIdx], log2TbSize, cb->qp);
+      int qP = get_component_qp_prime(ectx->get_sps(), ectx->get_pps(), cb->qp, cIdx);
+      int bit_depth = img->get_bit_depth(cIdx);
+      if (cbf[cIdx]) dequant_coefficients(dequant_coeff, coeff[cIdx], log2TbSize, qP, bit_depth);
 
       if (0 && cbf[cIdx]) {
         printf("--- quantized coeffs ---\n");
@@ -201,14 +165,23 @@ void enc_tb::reconstruct_tb(encoder_context* ectx,
       int stride  = img->get_image_stride(cIdx);
 #endif
 
-      int trType = (cIdx==0 && log2TbSize==2); // TODO: inter
+      int trType = (cIdx==0 && log2TbSize==2 && cb->PredMode==MODE_INTRA);
 
       //printf("--- prediction %d %d / %d ---\n",x0,y0,cIdx);
       //printBlk("prediction",ptr,1<<log2TbSize,stride);
 
-      if (cbf[cIdx]) inv_transform(&ectx->acceleration,
-                                   reconstruction[cIdx]->get_buffer<uint8_t>(), 1<<log2TbSize,
-                                   dequant_coeff, log2TbSize,   trType);
+      if (cbf[cIdx]) {
+        if (bit_depth>8) {
+          inv_transform(&ectx->acceleration,
+                        reconstruction[cIdx]->get_buffer<uint16_t>(), 1<<log2TbSize,
+                        dequant_coeff, log2TbSize,   trType, bit_depth);
+        }
+        else {
+          inv_transform(&ectx->acceleration,
+                        reconstruction[cIdx]->get_buffer<uint8_t>(), 1<<log2TbSize,
+                        dequant_coeff, log2TbSize,   trType, bit_depth);
+        }
+      }
 
       //printBlk("RECO",reconstruction[cIdx]->get_buffer_u8(),1<<log2TbSize,
       //         reconstruction[cIdx]->getStride());
@@ -333,12 +306,8 @@ enc_cb::~enc_cb()
 }
 
 
-/*
 void enc_cb::write_to_image(de265_image* img) const
 {
-  //printf("write_to_image %d %d size:%d\n",x,y,1<<log2Size);
-
-
   if (!split_cu_flag) {
     img->set_log2CbSize(x,y,log2Size, true);
     img->set_ctDepth(x,y,log2Size, ctDepth);
@@ -412,7 +381,37 @@ void enc_cb::write_to_image(de265_image* img) const
     }
   }
 }
-*/
+
+void enc_cb::write_transform_trees_to_image(de265_image* img) const
+{
+  if (split_cu_flag) {
+    for (int i=0;i<4;i++) {
+      if (children[i]) {
+        children[i]->write_transform_trees_to_image(img);
+      }
+    }
+  }
+  else {
+    img->clear_split_transform_flags(x,y,log2Size);
+    transform_tree->write_to_image(img, 0);
+  }
+}
+
+
+void enc_tb::write_to_image(de265_image* img, int trafoDepth) const
+{
+  if (split_transform_flag) {
+    img->set_split_transform_flag(x,y,trafoDepth);
+
+    for (int i=0;i<4;i++) {
+      children[i]->write_to_image(img, trafoDepth+1);
+    }
+  }
+  else if (cbf[0]) {
+    img->set_nonzero_coefficient(x,y,log2Size);
+  }
+}
+
 
 void enc_cb::reconstruct(encoder_context* ectx, de265_image* img) const
 {
@@ -491,16 +490,16 @@ void enc_tb::debug_dumpTree(int flags, int indent) const
       }
   }
 
-  if (flags & DUMPTREE_INTRA_PREDICTION) {
+  if (flags & DUMPTREE_PREDICTION) {
     for (int i=0;i<3;i++)
-      if (intra_prediction[i]) {
+      if (prediction[i]) {
         //if (i==0) print_border(debug_intra_border+64, NULL, 1<<log2Size);
 
-        std::cout << indentStr << "| Intra prediction, channel " << i << ":\n";
+        std::cout << indentStr << "| Prediction, channel " << i << ":\n";
         printBlk(NULL,
-                 intra_prediction[i]->get_buffer_u8(),
-                 intra_prediction[i]->getWidth(),
-                 intra_prediction[i]->getStride(),
+                 prediction[i]->get_buffer_u8(),
+                 prediction[i]->getWidth(),
+                 prediction[i]->getStride(),
                  indentStr + "| ");
       }
   }
@@ -644,6 +643,13 @@ void CTBTreeMatrix::writeReconstructionToImage(de265_image* img,
   }
 }
 
+void CTBTreeMatrix::writeTransformTreesToImage(de265_image* img) const
+{
+  for (int i=0;i<mCTBs.size();i++) {
+    mCTBs[i]->write_transform_trees_to_image(img);
+  }
+}
+
 void enc_cb::writeReconstructionToImage(de265_image* img,
                                         const seq_parameter_set* sps) const
 {
@@ -745,22 +751,26 @@ PixelAccessor enc_tb::getPixels(int x,int y, int cIdx, const seq_parameter_set&
 
 void PixelAccessor::copyToImage(de265_image* img, int cIdx) const
 {
-  uint8_t* p = img->get_image_plane_at_pos(cIdx, mXMin, mYMin);
-  int stride = img->get_image_stride(cIdx);
+  assert(img->get_bytes_per_pixel(cIdx) == mBytesPerPixel);
+
+  uint8_t* p = (uint8_t*)img->get_image_plane_at_pos_any_depth(cIdx, mXMin, mYMin);
+  int stride = img->get_image_stride(cIdx) * mBytesPerPixel;
 
   for (int y=0;y<mHeight;y++) {
-    memcpy(p, mBase+mXMin+(y+mYMin)*mStride, mWidth);
+    memcpy(p, mBase+(mXMin+(y+mYMin)*mStride)*mBytesPerPixel, mWidth*mBytesPerPixel);
     p += stride;
   }
 }
 
 void PixelAccessor::copyFromImage(const de265_image* img, int cIdx)
 {
-  const uint8_t* p = img->get_image_plane_at_pos(cIdx, mXMin, mYMin);
-  int stride = img->get_image_stride(cIdx);
+  assert(img->get_bytes_per_pixel(cIdx) == mBytesPerPixel);
+
+  const uint8_t* p = (const uint8_t*)img->get_image_plane_at_pos_any_depth(cIdx, mXMin, mYMin);
+  int stride = img->get_image_stride(cIdx) * mBytesPerPixel;
 
   for (int y=0;y<mHeight;y++) {
-    memcpy(mBase+mXMin+(y+mYMin)*mStride, p, mWidth);
+    memcpy(mBase+(mXMin+(y+mYMin)*mStride)*mBytesPerPixel, p, mWidth*mBytesPerPixel);
     p += stride;
   }
 }
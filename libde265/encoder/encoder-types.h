@@ -55,6 +55,7 @@ class small_image_buffer
   int getHeight() const { return mHeight; }
 
   int getStride() const { return mStride; } // pixels per row
+  int getBytesPerPixel() const { return mBytesPerRow / mStride; }
 
  private:
   uint8_t*  mBuf;
@@ -81,7 +82,7 @@ public:
   uint8_t  log2Size : 3;
 
 
-  static const int DUMPTREE_INTRA_PREDICTION = (1<<0);
+  static const int DUMPTREE_PREDICTION       = (1<<0);
   static const int DUMPTREE_RESIDUAL         = (1<<1);
   static const int DUMPTREE_RECONSTRUCTION   = (1<<2);
   static const int DUMPTREE_ALL              = 0xFFFF;
@@ -96,15 +97,19 @@ class PixelAccessor
   PixelAccessor(small_image_buffer& buf, int x0,int y0) {
     mBase = buf.get_buffer_u8();
     mStride = buf.getStride();
+    mBytesPerPixel = buf.getBytesPerPixel();
     mXMin = x0;
     mYMin = y0;
     mWidth = buf.getWidth();
     mHeight= buf.getHeight();
 
-    mBase -= x0 + y0*mStride;
+    mBase -= (x0 + y0*mStride) * mBytesPerPixel;
   }
 
-  const uint8_t* operator[](int y) const { return mBase+y*mStride; }
+  // row 'y' of the image, indexed with the image x coordinate
+  template <class pixel_t> const pixel_t* get_row(int y) const {
+    return (const pixel_t*)(mBase + y*mStride*mBytesPerPixel);
+  }
 
   int getLeft() const { return mXMin; }
   int getWidth() const { return mWidth; }
@@ -123,10 +128,12 @@ class PixelAccessor
   short   mStride;
   short   mXMin,  mYMin;
   uint8_t mWidth, mHeight;
+  uint8_t mBytesPerPixel;
 
   PixelAccessor() {
     mBase = NULL;
     mStride = mXMin = mYMin = mWidth = mHeight = 0;
+    mBytesPerPixel = 1;
   }
 };
 
@@ -154,11 +161,11 @@ class enc_tb : public enc_node
   uint8_t cbf[3];
 
 
-  /* intra_prediction and residual is filled in tb-split, because this is where we decide
-     on the final block-size the TB is coded with.
+  /* prediction (intra or inter) and residual is filled in tb-split, because this is
+     where we decide on the final block-size the TB is coded with.
    */
   //mutable uint8_t debug_intra_border[2*64+1];
-  std::shared_ptr<small_image_buffer> intra_prediction[3];
+  std::shared_ptr<small_image_buffer> prediction[3];
   std::shared_ptr<small_image_buffer> residual[3];
 
   /* Reconstruction is computed on-demand in writeMetadata().
@@ -186,6 +193,9 @@ class enc_tb : public enc_node
 
   void set_cbf_flags_from_children();
 
+  // write the transform tree (split flags, luma blocks with coefficients) into the image
+  void write_to_image(de265_image*, int trafoDepth) const;
+
   void reconstruct(encoder_context* ectx, de265_image* img) const;
   void debug_writeBlack(encoder_context* ectx, de265_image* img) const;
 
@@ -310,6 +320,16 @@ public:
   // can only be called on the lowest-level CB (with TB-tree as its direct child)
   const enc_tb* getTB(int x,int y) const;
 
+  /* Write the CB metadata (sizes, prediction modes, motion) of the whole subtree
+     into the image, where the motion vector prediction reads it from.
+   */
+  void write_to_image(de265_image*) const;
+
+  /* Write the transform trees of the subtree into the image, where the deblocking
+     filter reads the transform block edges from.
+   */
+  void write_transform_trees_to_image(de265_image*) const;
+
   void writeReconstructionToImage(de265_image* img,
                                   const seq_parameter_set* sps) const;
 
@@ -330,8 +350,6 @@ public:
   }
 
  private:
-  //void write_to_image(de265_image*) const;
-
   static alloc_pool mMemPool;
 };
 
@@ -375,6 +393,8 @@ class CTBTreeMatrix
   void writeReconstructionToImage(de265_image* img,
                                   const seq_parameter_set*) const;
 
+  void writeTransformTreesToImage(de265_image* img) const;
+
  private:
   std::vector<enc_cb*> mCTBs;
   int mWidthCtbs;
@@ -409,10 +409,16 @@ void transform_4x4_luma_add_16_fallback(uint16_t *dst, const int16_t *coeffs, pt
 
 
 void fdst_4x4_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
+{
+  fdst_4x4_16_fallback(coeffs, input, stride, 8);
+}
+
+
+void fdst_4x4_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth)
 {
   int16_t g[4*4];
 
-  int BD = 8;
+  int BD = bit_depth;
   int shift1 = Log2(4) + BD -9;
   int shift2 = Log2(4) + 6;
 
@@ -904,8 +910,8 @@ void transform_32x32_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdi
 }
 
 
-static void transform_fdct_8(int16_t* coeffs, int nT,
-                             const int16_t *input, ptrdiff_t stride)
+static void transform_fdct(int16_t* coeffs, int nT,
+                           const int16_t *input, ptrdiff_t stride, int bit_depth)
 {
   /*
     Each sum over a basis vector sums nT elements, which is compensated by
@@ -938,7 +944,7 @@ static void transform_fdct_8(int16_t* coeffs, int nT,
     will be wider accordingly, but the widths after the shifts are the same.
   */
 
-  int BitDepth = 8;
+  int BitDepth = bit_depth;
 
   //          / compensate everything | / effective word length |
   int shift1 = Log2(nT) + 6 + BitDepth  - 15;
@@ -983,22 +989,42 @@ static void transform_fdct_8(int16_t* coeffs, int nT,
 
 void fdct_4x4_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
 {
-  transform_fdct_8(coeffs, 4, input,stride);
+  transform_fdct(coeffs, 4, input,stride, 8);
 }
 
 void fdct_8x8_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
 {
-  transform_fdct_8(coeffs, 8, input,stride);
+  transform_fdct(coeffs, 8, input,stride, 8);
 }
 
 void fdct_16x16_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
 {
-  transform_fdct_8(coeffs, 16, input,stride);
+  transform_fdct(coeffs, 16, input,stride, 8);
 }
 
 void fdct_32x32_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
 {
-  transform_fdct_8(coeffs, 32, input,stride);
+  transform_fdct(coeffs, 32, input,stride, 8);
+}
+
+void fdct_4x4_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth)
+{
+  transform_fdct(coeffs, 4, input,stride, bit_depth);
+}
+
+void fdct_8x8_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth)
+{
+  transform_fdct(coeffs, 8, input,stride, bit_depth);
+}
+
+void fdct_16x16_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth)
+{
+  transform_fdct(coeffs, 16, input,stride, bit_depth);
+}
+
+void fdct_32x32_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth)
+{
+  transform_fdct(coeffs, 32, input,stride, bit_depth);
 }
 
 
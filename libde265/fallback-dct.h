@@ -88,6 +88,12 @@ void fdct_8x8_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride
 void fdct_16x16_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
 void fdct_32x32_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
 
+void fdst_4x4_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth);
+void fdct_4x4_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth);
+void fdct_8x8_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth);
+void fdct_16x16_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth);
+void fdct_32x32_16_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride, int bit_depth);
+
 void hadamard_4x4_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
 void hadamard_8x8_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
 void hadamard_16x16_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
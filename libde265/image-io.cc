@@ -44,7 +44,7 @@ ImageSource_YUV::~ImageSource_YUV()
 }
 
 
-bool ImageSource_YUV::set_input_file(const char* filename, int w,int h)
+bool ImageSource_YUV::set_input_file(const char* filename, int w,int h, int bitDepth)
 {
   assert(mFH==NULL);
 
@@ -55,8 +55,20 @@ bool ImageSource_YUV::set_input_file(const char* filename, int w,int h)
 
   width =w;
   height=h;
+  this->bitDepth = bitDepth;
   mReachedEndOfFile = false;
 
+  if (bitDepth > 8) {
+    mFormat = std::make_shared<seq_parameter_set>();
+    mFormat->set_defaults();
+    mFormat->bit_depth_luma   = bitDepth;
+    mFormat->bit_depth_chroma = bitDepth;
+    mFormat->set_resolution(w,h);
+    if (mFormat->compute_derived_values(true) != DE265_OK) {
+      return false;
+    }
+  }
+
   return true;
 }
 
@@ -66,32 +78,34 @@ de265_image* ImageSource_YUV::read_next_image()
   if (mReachedEndOfFile) return NULL;
 
   de265_image* img = new de265_image;
-  img->alloc_image(width,height,de265_chroma_420, NULL, false,
+  img->alloc_image(width,height,de265_chroma_420, mFormat, false,
                    NULL, /*NULL,*/ 0, NULL, false);
   assert(img); // TODO: error handling
 
   // --- load image ---
 
+  const int bpp = (bitDepth+7)/8;
+
   uint8_t* p;
   int stride;
 
-  p = img->get_image_plane(0);  stride = img->get_image_stride(0);
+  p = img->get_image_plane(0);  stride = img->get_image_stride(0) * bpp;
   for (int y=0;y<height;y++) {
-    if (fread(p+y*stride,1,width,mFH) != width) {
+    if (fread(p+y*stride,bpp,width,mFH) != width) {
       goto check_eof;
     }
   }
 
-  p = img->get_image_plane(1);  stride = img->get_image_stride(1);
+  p = img->get_image_plane(1);  stride = img->get_image_stride(1) * bpp;
   for (int y=0;y<height/2;y++) {
-    if (fread(p+y*stride,1,width/2,mFH) != width/2) {
+    if (fread(p+y*stride,bpp,width/2,mFH) != width/2) {
       goto check_eof;
     }
   }
 
-  p = img->get_image_plane(2);  stride = img->get_image_stride(2);
+  p = img->get_image_plane(2);  stride = img->get_image_stride(2) * bpp;
   for (int y=0;y<height/2;y++) {
-    if (fread(p+y*stride,1,width/2,mFH) != width/2) {
+    if (fread(p+y*stride,bpp,width/2,mFH) != width/2) {
       goto check_eof;
     }
   }
@@ -126,7 +140,7 @@ de265_image* ImageSource_YUV::get_image(bool block)
 
 void ImageSource_YUV::skip_frames(int n)
 {
-  int imageSize = width*height*3/2;
+  int imageSize = width*height*3/2 * ((bitDepth+7)/8);
   fseek(mFH,n * imageSize, SEEK_CUR);
 }
 
@@ -159,19 +173,23 @@ void ImageSink_YUV::send_image(const de265_image* img)
   int width = img->get_width();
   int height= img->get_height();
 
-  p = img->get_image_plane(0);  stride = img->get_image_stride(0);
+  // images without SPS have 8 bits, so take the bit depth from the image itself
+  const int luma_bpp   = (img->BitDepth_Y+7)/8;
+  const int chroma_bpp = (img->BitDepth_C+7)/8;
+
+  p = img->get_image_plane(0);  stride = img->get_image_stride(0) * luma_bpp;
   for (int y=0;y<height;y++) {
-    fwrite(p+y*stride,1,width,mFH);
+    fwrite(p+y*stride,luma_bpp,width,mFH);
   }
 
-  p = img->get_image_plane(1);  stride = img->get_image_stride(1);
+  p = img->get_image_plane(1);  stride = img->get_image_stride(1) * chroma_bpp;
   for (int y=0;y<height/2;y++) {
-    fwrite(p+y*stride,1,width/2,mFH);
+    fwrite(p+y*stride,chroma_bpp,width/2,mFH);
   }
 
-  p = img->get_image_plane(2);  stride = img->get_image_stride(2);
+  p = img->get_image_plane(2);  stride = img->get_image_stride(2) * chroma_bpp;
   for (int y=0;y<height/2;y++) {
-    fwrite(p+y*stride,1,width/2,mFH);
+    fwrite(p+y*stride,chroma_bpp,width/2,mFH);
   }
 }
 
@@ -51,7 +51,8 @@ class ImageSource_YUV : public ImageSource
   LIBDE265_API ImageSource_YUV();
   virtual LIBDE265_API ~ImageSource_YUV();
 
-  bool LIBDE265_API set_input_file(const char* filename, int w,int h);
+  // Samples of more than 8 bits are read as 16 bit values (native byte order).
+  bool LIBDE265_API set_input_file(const char* filename, int w,int h, int bitDepth=8);
 
   //virtual ImageStatus  get_status();
   virtual LIBDE265_API de265_image* get_image(bool block=true);
@@ -65,6 +66,10 @@ class ImageSource_YUV : public ImageSource
   bool mReachedEndOfFile;
 
   int width,height;
+  int bitDepth;
+
+  // sample format of the images with more than 8 bits (images without SPS have 8 bits)
+  std::shared_ptr<seq_parameter_set> mFormat;
 
   de265_image* read_next_image();
 };
@@ -27,11 +27,13 @@
 
 #include <limits>
 
-
-#ifdef HAVE_MALLOC_H
-#include <malloc.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #endif
 
+
 #ifdef HAVE_SSE4_1
 // SSE code processes 128bit per iteration and thus might read more data
 // than is later actually used.
@@ -42,26 +44,6 @@
 
 #define STANDARD_ALIGNMENT 16
 
-#ifdef HAVE___MINGW_ALIGNED_MALLOC
-#define ALLOC_ALIGNED(alignment, size)         __mingw_aligned_malloc((size), (alignment))
-#define FREE_ALIGNED(mem)                      __mingw_aligned_free((mem))
-#elif _WIN32
-#define ALLOC_ALIGNED(alignment, size)         _aligned_malloc((size), (alignment))
-#define FREE_ALIGNED(mem)                      _aligned_free((mem))
-#elif defined(HAVE_POSIX_MEMALIGN)
-static inline void *ALLOC_ALIGNED(size_t alignment, size_t size) {
-    void *mem = NULL;
-    if (posix_memalign(&mem, alignment, size) != 0) {
-        return NULL;
-    }
-    return mem;
-};
-#define FREE_ALIGNED(mem)                      free((mem))
-#else
-#define ALLOC_ALIGNED(alignment, size)      memalign((alignment), (size))
-#define FREE_ALIGNED(mem)                   free((mem))
-#endif
-
 #define ALLOC_ALIGNED_16(size)              ALLOC_ALIGNED(16, size)
 
 static const int alignment = 16;
@@ -104,33 +86,139 @@ LIBDE265_API void de265_free_image_plane(struct de265_image* img, int cIdx)
 }
 
 
+#define CACHE_LINE_SIZE  64
+#define HUGE_PAGE_SIZE   (2*1024*1024)
+#define NUMA_PAGE_SIZE   4096
+
+/* Allocate a pixel plane with the layout selected by DE265_DECODER_PARAM_IMAGE_ALLOCATOR
+   and DE265_DECODER_PARAM_IMAGE_NUMA_NODE. The memory is freed with FREE_ALIGNED(). */
+static void* alloc_plane_memory(size_t size, enum de265_image_allocator allocator, int numa_node)
+{
+  if (allocator == de265_image_allocator_standard && numa_node < 0) {
+    return ALLOC_ALIGNED_16(size);
+  }
+
+  size_t alignment = CACHE_LINE_SIZE;
+  bool huge_pages = false;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  huge_pages = (allocator == de265_image_allocator_huge_pages && size >= HUGE_PAGE_SIZE);
+#endif
+
+  if (huge_pages) {
+    alignment = HUGE_PAGE_SIZE;
+  }
+  else if (numa_node >= 0) {
+    alignment = NUMA_PAGE_SIZE;  // NUMA policies are set for whole pages
+  }
+
+  size = (size + alignment-1) & ~(alignment-1);
+
+  void* mem = ALLOC_ALIGNED(alignment, size);
+  if (mem == NULL) {
+    return NULL;
+  }
+
+#ifdef __linux__
+#ifdef MADV_HUGEPAGE
+  if (huge_pages) {
+    madvise(mem, size, MADV_HUGEPAGE);  // only a hint, the plane also works with small pages
+  }
+#endif
+
+#ifdef SYS_mbind
+  if (numa_node >= 0 && numa_node < 64) {
+    const int      mpol_preferred = 1;
+    const unsigned mpol_mf_move   = 1<<1;
+
+    unsigned long nodemask = 1UL << numa_node;
+    syscall(SYS_mbind, mem, size, mpol_preferred, &nodemask, sizeof(nodemask)*8, mpol_mf_move);
+  }
+#endif
+#endif
+
+  return mem;
+}
+
+
+/* Stride in pixels. Except for the standard allocator, lines start at cache-line
+   boundaries and the line length in bytes is no multiple of 1 KB, such that vertically
+   adjacent pixels do not fall into the same cache set. */
+static int plane_stride(int width, int alignment, int bytes_per_pixel,
+                        enum de265_image_allocator allocator)
+{
+  if (allocator == de265_image_allocator_standard) {
+    return (width + alignment-1) / alignment * alignment;
+  }
+
+  int stride = (width + CACHE_LINE_SIZE-1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+  if ((stride * bytes_per_pixel) % 1024 == 0) {
+    stride += CACHE_LINE_SIZE / bytes_per_pixel;
+  }
+
+  return stride;
+}
+
+
 static int  de265_image_get_buffer(de265_decoder_context* ctx,
                                    de265_image_spec* spec, de265_image* img, void* userdata)
 {
+  enum de265_image_allocator allocator = de265_image_allocator_standard;
+  int numa_node = -1;
+
+  if (img->decctx) {
+    allocator = img->decctx->param_image_allocator;
+    numa_node = img->decctx->param_image_numa_node;
+  }
+
   const int rawChromaWidth  = spec->width  / img->SubWidthC;
   const int rawChromaHeight = spec->height / img->SubHeightC;
 
-  int luma_stride   = (spec->width    + spec->alignment-1) / spec->alignment * spec->alignment;
-  int chroma_stride = (rawChromaWidth + spec->alignment-1) / spec->alignment * spec->alignment;
-
   assert(img->BitDepth_Y >= 8 && img->BitDepth_Y <= 16);
   assert(img->BitDepth_C >= 8 && img->BitDepth_C <= 16);
 
-  int luma_bpl   = luma_stride   * ((img->BitDepth_Y+7)/8);
-  int chroma_bpl = chroma_stride * ((img->BitDepth_C+7)/8);
+  int luma_bpp   = (img->BitDepth_Y+7)/8;
+  int chroma_bpp = (img->BitDepth_C+7)/8;
+
+  // Decoded pictures get a border for motion compensation (see extend_borders()).
+  // The left border is rounded up such that the lines stay aligned.
+
+  int border = (img->decctx ? MC_BORDER : 0);
+
+  int line_alignment = (allocator == de265_image_allocator_standard ?
+                        spec->alignment : CACHE_LINE_SIZE);
+
+  int luma_border_left   = (border * luma_bpp + line_alignment-1)
+    / line_alignment * line_alignment / luma_bpp;
+  int chroma_border_x    = border / img->SubWidthC;
+  int chroma_border_y    = border / img->SubHeightC;
+  int chroma_border_left = (chroma_border_x * chroma_bpp + line_alignment-1)
+    / line_alignment * line_alignment / chroma_bpp;
+
+  int luma_stride   = plane_stride(luma_border_left + spec->width + border,
+                                   spec->alignment, luma_bpp, allocator);
+  int chroma_stride = plane_stride(chroma_border_left + rawChromaWidth + chroma_border_x,
+                                   spec->alignment, chroma_bpp, allocator);
+
+  int luma_bpl   = luma_stride   * luma_bpp;
+  int chroma_bpl = chroma_stride * chroma_bpp;
 
-  int luma_height   = spec->height;
-  int chroma_height = rawChromaHeight;
+  int luma_height   = spec->height   + 2*border;
+  int chroma_height = rawChromaHeight + 2*chroma_border_y;
 
   bool alloc_failed = false;
 
   uint8_t* p[3] = { 0,0,0 };
-  p[0] = (uint8_t *)ALLOC_ALIGNED_16(luma_height   * luma_bpl   + MEMORY_PADDING);
+  p[0] = (uint8_t *)alloc_plane_memory(luma_height * luma_bpl + MEMORY_PADDING,
+                                       allocator, numa_node);
   if (p[0]==NULL) { alloc_failed=true; }
 
   if (img->get_chroma_format() != de265_chroma_mono) {
-    p[1] = (uint8_t *)ALLOC_ALIGNED_16(chroma_height * chroma_bpl + MEMORY_PADDING);
-    p[2] = (uint8_t *)ALLOC_ALIGNED_16(chroma_height * chroma_bpl + MEMORY_PADDING);
+    p[1] = (uint8_t *)alloc_plane_memory(chroma_height * chroma_bpl + MEMORY_PADDING,
+                                         allocator, numa_node);
+    p[2] = (uint8_t *)alloc_plane_memory(chroma_height * chroma_bpl + MEMORY_PADDING,
+                                         allocator, numa_node);
 
     if (p[1]==NULL || p[2]==NULL) { alloc_failed=true; }
   }
@@ -149,9 +237,18 @@ static int  de265_image_get_buffer(de265_decoder_context* ctx,
     return 0;
   }
 
-  img->set_image_plane(0, p[0], luma_stride, NULL);
-  img->set_image_plane(1, p[1], chroma_stride, NULL);
-  img->set_image_plane(2, p[2], chroma_stride, NULL);
+  int luma_origin   = (border * luma_stride + luma_border_left) * luma_bpp;
+  int chroma_origin = (chroma_border_y * chroma_stride + chroma_border_left) * chroma_bpp;
+
+  img->set_image_plane(0, p[0] + luma_origin, luma_stride, NULL);
+  img->set_image_plane(1, p[1] ? p[1] + chroma_origin : NULL, chroma_stride, NULL);
+  img->set_image_plane(2, p[2] ? p[2] + chroma_origin : NULL, chroma_stride, NULL);
+
+  for (int i=0;i<3;i++) {
+    img->set_plane_memory(i, p[i]);
+  }
+
+  img->border_reserved = border;
 
   return 1;
 }
@@ -160,9 +257,10 @@ static void de265_image_release_buffer(de265_decoder_context* ctx,
                                        de265_image* img, void* userdata)
 {
   for (int i=0;i<3;i++) {
-    uint8_t* p = (uint8_t*)img->get_image_plane(i);
+    uint8_t* p = img->get_plane_memory(i);
     if (p) {
       FREE_ALIGNED(p);
+      img->set_plane_memory(i, NULL);
     }
   }
 }
@@ -173,6 +271,12 @@ de265_image_allocation de265_image::default_image_allocation = {
   de265_image_release_buffer
 };
 
+static bool is_default_allocation(const de265_image_allocation& alloc)
+{
+  return (alloc.get_buffer     == de265_image_get_buffer &&
+          alloc.release_buffer == de265_image_release_buffer);
+}
+
 
 void de265_image::set_image_plane(int cIdx, uint8_t* mem, int stride, void *userdata)
 {
@@ -203,10 +307,14 @@ de265_image::de265_image()
     pixels[c] = NULL;
     pixels_confwin[c] = NULL;
     plane_user_data[c] = NULL;
+    plane_memory[c] = NULL;
   }
 
   width=height=0;
 
+  border_reserved = 0;
+  mc_border = 0;
+
   pts = 0;
   user_data = NULL;
 
@@ -214,11 +322,24 @@ de265_image::de265_image()
 
   integrity = INTEGRITY_NOT_DECODED;
 
+  motion_field_compressed = false;
+
+  decoded_tiles.clear();
+
+  app_refcount = 0;
+  detached = false;
+  owner_dpb = NULL;
+
   picture_order_cnt_lsb = -1; // undefined
   PicOrderCntVal = -1; // undefined
   PicState = UnusedForReference;
   PicOutputFlag = false;
 
+  last_NAL_arrival_time = 0;
+  output_time = 0;
+
+  reset_stage_times();
+
   nThreadsQueued   = 0;
   nThreadsRunning  = 0;
   nThreadsBlocked  = 0;
@@ -242,11 +363,38 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
 
   if (sps) { this->sps = sps; }
 
-  release(); /* TODO: review code for efficient allocation when arrays are already
-                allocated to the requested size. Without the release, the old image-data
-                will not be freed. */
+  de265_image_allocation new_allocation_functions;
+  if (dctx && useCustomAllocFunc) {
+    new_allocation_functions = dctx->param_image_allocation_functions;
+  }
+  else {
+    new_allocation_functions = de265_image::default_image_allocation;
+  }
+
+  // Pixel planes from our own allocator are kept when the format does not change.
+  // Planes from custom allocators are always handed back to the application.
+
+  int newBitDepth_Y = (sps==NULL) ? 8 : sps->BitDepth_Y;
+  int newBitDepth_C = (sps==NULL) ? 8 : sps->BitDepth_C;
+
+  bool reuse_planes = (pixels[0] != NULL &&
+                       is_default_allocation(image_allocation_functions) &&
+                       is_default_allocation(new_allocation_functions) &&
+                       width  == w &&
+                       height == h &&
+                       chroma_format == c &&
+                       BitDepth_Y == newBitDepth_Y &&
+                       BitDepth_C == newBitDepth_C);
+
+  if (reuse_planes) {
+    release_slices();
+  }
+  else {
+    release();
+  }
 
   ID = s_next_image_ID++;
+  mc_border = 0;  // the border is filled again after decoding
   removed_at_picture_id = std::numeric_limits<int32_t>::max();
 
   decctx = dctx;
@@ -343,8 +491,8 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
   spec.visible_height= height_confwin;
 
 
-  BitDepth_Y = (sps==NULL) ? 8 : sps->BitDepth_Y;
-  BitDepth_C = (sps==NULL) ? 8 : sps->BitDepth_C;
+  BitDepth_Y = newBitDepth_Y;
+  BitDepth_C = newBitDepth_C;
 
   bpp_shift[0] = (BitDepth_Y <= 8) ? 0 : 1;
   bpp_shift[1] = (BitDepth_C <= 8) ? 0 : 1;
@@ -371,18 +519,17 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
       image_allocation_functions.release_buffer = NULL;
     }
   }
-  else*/ if (decctx && useCustomAllocFunc) {
-    image_allocation_functions = decctx->param_image_allocation_functions;
-  }
-  else {
-    image_allocation_functions = de265_image::default_image_allocation;
+  else*/ {
+    image_allocation_functions = new_allocation_functions;
   }
 
   bool mem_alloc_success = true;
 
   if (image_allocation_functions.get_buffer != NULL) {
-    mem_alloc_success = image_allocation_functions.get_buffer(decctx, &spec, this,
-                                                              alloc_userdata);
+    if (!reuse_planes) {
+      mem_alloc_success = image_allocation_functions.get_buffer(decctx, &spec, this,
+                                                                alloc_userdata);
+    }
 
     pixels_confwin[0] = pixels[0] + left*WinUnitX + top*WinUnitY*stride;
     pixels_confwin[1] = pixels[1] + left + top*chroma_stride;
@@ -418,6 +565,11 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
 
     // pb info
 
+    if (motion_field_compressed) {
+      MetaDataArray<PBMotion> no_full_field;
+      restore_full_motion_field(no_full_field);
+    }
+
     int puWidth  = sps->PicWidthInMinCbsY  << (sps->Log2MinCbSizeY -2);
     int puHeight = sps->PicHeightInMinCbsY << (sps->Log2MinCbSizeY -2);
 
@@ -436,15 +588,16 @@ de265_error de265_image::alloc_image(int w,int h, enum de265_chroma c,
 
     mem_alloc_success &= deblk_info.alloc(deblk_w, deblk_h, 2);
 
-    // CTB info
+    // CTB info (progress locks are only recreated when the number of CTBs changes)
 
-    if (ctb_info.data_size != sps->PicSizeInCtbsY)
-      {
-        delete[] ctb_progress;
+    int old_ctb_info_size = ctb_info.data_size;
 
-        mem_alloc_success &= ctb_info.alloc(sps->PicWidthInCtbsY, sps->PicHeightInCtbsY,
-                                            sps->Log2CtbSizeY);
+    mem_alloc_success &= ctb_info.alloc(sps->PicWidthInCtbsY, sps->PicHeightInCtbsY,
+                                        sps->Log2CtbSizeY);
 
+    if (ctb_progress == NULL || ctb_info.data_size != old_ctb_info_size)
+      {
+        delete[] ctb_progress;
         ctb_progress = new de265_progress_lock[ ctb_info.data_size ];
       }
 
@@ -499,10 +652,76 @@ void de265_image::release()
           pixels[i] = NULL;
           pixels_confwin[i] = NULL;
         }
+
+      border_reserved = 0;
+      mc_border = 0;
+    }
+
+  release_slices();
+}
+
+
+template <class pixel_t>
+static void extend_plane_border(pixel_t* plane, int stride, int width, int height,
+                                int border_x, int border_y)
+{
+  // left and right border
+
+  for (int y=0;y<height;y++) {
+    pixel_t* line = plane + y*stride;
+
+    for (int x=1;x<=border_x;x++) {
+      line[-x] = line[0];
+      line[width-1+x] = line[width-1];
+    }
+  }
+
+  // top and bottom border, including the corners
+
+  const pixel_t* top    = plane - border_x;
+  const pixel_t* bottom = plane - border_x + (height-1)*stride;
+  int lineSize = (width + 2*border_x) * sizeof(pixel_t);
+
+  for (int y=1;y<=border_y;y++) {
+    memcpy(plane - border_x - y*stride,              top,    lineSize);
+    memcpy(plane - border_x + (height-1+y)*stride,   bottom, lineSize);
+  }
+}
+
+
+void de265_image::extend_borders()
+{
+  if (border_reserved==0) {
+    return;
+  }
+
+  int nPlanes = (chroma_format == de265_chroma_mono ? 1 : 3);
+
+  for (int c=0;c<nPlanes;c++) {
+    int border_x = border_reserved;
+    int border_y = border_reserved;
+
+    if (c>0) {
+      border_x /= SubWidthC;
+      border_y /= SubHeightC;
     }
 
-  // free slices
+    if (high_bit_depth(c)) {
+      extend_plane_border((uint16_t*)pixels[c], get_image_stride(c),
+                          get_width(c), get_height(c), border_x, border_y);
+    }
+    else {
+      extend_plane_border(pixels[c], get_image_stride(c),
+                          get_width(c), get_height(c), border_x, border_y);
+    }
+  }
+
+  mc_border = border_reserved;
+}
+
 
+void de265_image::release_slices()
+{
   for (int i=0;i<slices.size();i++) {
     delete slices[i];
   }
@@ -510,6 +729,67 @@ void de265_image::release()
 }
 
 
+bool de265_image::has_buffers_for(const seq_parameter_set& sps) const
+{
+  return (has_pixel_buffers_for(sps) &&
+          ctb_info.data_size == sps.PicSizeInCtbsY &&
+          ctb_progress != NULL);
+}
+
+
+bool de265_image::has_pixel_buffers_for(const seq_parameter_set& sps) const
+{
+  return (pixels[0] != NULL &&
+          is_default_allocation(image_allocation_functions) &&
+          width  == sps.pic_width_in_luma_samples &&
+          height == sps.pic_height_in_luma_samples &&
+          chroma_format == (enum de265_chroma)sps.chroma_format_idc &&
+          BitDepth_Y == sps.BitDepth_Y &&
+          BitDepth_C == sps.BitDepth_C);
+}
+
+
+int64_t de265_image::get_pixel_memory_size() const
+{
+  if (pixels[0]==NULL) {
+    return 0;
+  }
+
+  int64_t bytes = (int64_t)stride * (height + 2*border_reserved) * ((BitDepth_Y+7)/8);
+
+  if (chroma_format != de265_chroma_mono) {
+    int chroma_border_rows = 2*border_reserved / SubHeightC;
+    bytes += 2 * (int64_t)chroma_stride * (chroma_height + chroma_border_rows) * ((BitDepth_C+7)/8);
+  }
+
+  return bytes;
+}
+
+
+template <class DataUnit> static int64_t metadata_size(const MetaDataArray<DataUnit>& a)
+{
+  return (int64_t)a.data_size * sizeof(DataUnit);
+}
+
+int64_t de265_image::get_metadata_memory_size() const
+{
+  int64_t bytes = (metadata_size(ctb_info) +
+                   metadata_size(cb_info) +
+                   metadata_size(pb_info) +
+                   metadata_size(pb_info_compressed_storage) +
+                   metadata_size(intraPredMode) +
+                   metadata_size(intraPredModeC) +
+                   metadata_size(tu_info) +
+                   metadata_size(deblk_info));
+
+  if (ctb_progress) {
+    bytes += (int64_t)ctb_info.data_size * sizeof(de265_progress_lock);
+  }
+
+  return bytes;
+}
+
+
 void de265_image::fill_image(int y,int cb,int cr)
 {
   if (y>=0) {
@@ -602,10 +882,13 @@ void de265_image::exchange_pixel_data_with(de265_image& b)
     std::swap(pixels[i], b.pixels[i]);
     std::swap(pixels_confwin[i], b.pixels_confwin[i]);
     std::swap(plane_user_data[i], b.plane_user_data[i]);
+    std::swap(plane_memory[i], b.plane_memory[i]);
   }
 
   std::swap(stride, b.stride);
   std::swap(chroma_stride, b.chroma_stride);
+  std::swap(border_reserved, b.border_reserved);
+  std::swap(mc_border, b.mc_border);
   std::swap(image_allocation_functions, b.image_allocation_functions);
 }
 
@@ -667,19 +950,21 @@ void de265_image::thread_finishes(const thread_task* task)
   de265_mutex_unlock(&mutex);
 }
 
-void de265_image::wait_for_progress(thread_task* task, int ctbx,int ctby, int progress)
+int64_t de265_image::wait_for_progress(thread_task* task, int ctbx,int ctby, int progress)
 {
   const int ctbW = sps->PicWidthInCtbsY;
 
-  wait_for_progress(task, ctbx + ctbW*ctby, progress);
+  return wait_for_progress(task, ctbx + ctbW*ctby, progress);
 }
 
-void de265_image::wait_for_progress(thread_task* task, int ctbAddrRS, int progress)
+int64_t de265_image::wait_for_progress(thread_task* task, int ctbAddrRS, int progress)
 {
-  if (task==NULL) { return; }
+  if (task==NULL) { return 0; }
 
   de265_progress_lock* progresslock = &ctb_progress[ctbAddrRS];
   if (progresslock->get_progress() < progress) {
+    int64_t start = ((decctx->param_stage_timing || task->trace) ? monotonic_time_ns() : 0);
+
     thread_blocks();
 
     assert(task!=NULL);
@@ -693,6 +978,59 @@ void de265_image::wait_for_progress(thread_task* task, int ctbAddrRS, int progre
     progresslock->wait_for_progress(progress);
     task->state = thread_task::Running;
     thread_unblocks();
+
+    if (start) {
+      int64_t end = monotonic_time_ns();
+
+      if (task->trace) {
+        const int ctbW = sps->PicWidthInCtbsY;
+        task->trace->add_blocked(task->worker, start, end,
+                                 ctbAddrRS % ctbW, ctbAddrRS / ctbW, progress);
+      }
+
+      if (decctx->param_stage_timing) {
+        return end - start;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+void de265_image::mark_tile_CTB_progress(int tileId, int progress)
+{
+  const int ctbW = sps->PicWidthInCtbsY;
+
+  int tx = tileId % pps->num_tile_columns;
+  int ty = tileId / pps->num_tile_columns;
+
+  for (int y=pps->rowBd[ty]; y<pps->rowBd[ty+1]; y++)
+    for (int x=pps->colBd[tx]; x<pps->colBd[tx+1]; x++) {
+      ctb_progress[x+y*ctbW].set_progress(progress);
+    }
+}
+
+
+/* Within a tile, the CTBs of a row are finished from left to right. Hence, it suffices
+   to wait for the last CTB of the row in each tile column.
+ */
+int64_t de265_image::wait_for_CTB_row(thread_task* task, int ctby, int progress)
+{
+  int64_t waitTime = 0;
+
+  for (int i=0;i<pps->num_tile_columns;i++) {
+    waitTime += wait_for_progress(task, pps->colBd[i+1]-1, ctby, progress);
+  }
+
+  return waitTime;
+}
+
+
+void de265_image::reset_stage_times()
+{
+  for (int i=0;i<DE265_NUMBER_OF_DECODE_STAGES;i++) {
+    stage_time[i] = 0;
   }
 }
 
@@ -706,6 +1044,15 @@ void de265_image::wait_for_completion()
   de265_mutex_unlock(&mutex);
 }
 
+bool de265_image::is_completed()
+{
+  de265_mutex_lock(&mutex);
+  bool completed = (nThreadsFinished==nThreadsTotal);
+  de265_mutex_unlock(&mutex);
+
+  return completed;
+}
+
 bool de265_image::debug_is_completed() const
 {
   return nThreadsFinished==nThreadsTotal;
@@ -750,6 +1097,51 @@ void de265_image::set_mv_info(int x,int y, int nPbW,int nPbH, const PBMotion& mv
 }
 
 
+void de265_image::compress_motion_field(MetaDataArray<PBMotion>& out_full)
+{
+  assert(!motion_field_compressed);
+
+  // 16x16 units, each taking the motion of its top-left 4x4 block (H.265 8.5.3.2.8)
+
+  const int log2Ratio = 4 - pb_info.log2unitSize;
+
+  int w = (pb_info.width_in_units  + (1<<log2Ratio)-1) >> log2Ratio;
+  int h = (pb_info.height_in_units + (1<<log2Ratio)-1) >> log2Ratio;
+
+  if (!pb_info_compressed_storage.alloc(w,h, 4)) {
+    return; // keep the full field, which is always valid
+  }
+
+  for (int y=0;y<h;y++) {
+    const PBMotion* src = &pb_info[ (y<<log2Ratio) * pb_info.width_in_units ];
+    PBMotion* dst = &pb_info_compressed_storage[ y*w ];
+
+    for (int x=0;x<w;x++) {
+      dst[x] = src[x<<log2Ratio];
+    }
+  }
+
+  pb_info.swap(pb_info_compressed_storage);
+  pb_info_compressed_storage.swap(out_full);
+
+  motion_field_compressed = true;
+}
+
+
+void de265_image::restore_full_motion_field(MetaDataArray<PBMotion>& full)
+{
+  if (motion_field_compressed) {
+    // keep the compressed array allocated for the next compression
+    pb_info.swap(pb_info_compressed_storage);
+    motion_field_compressed = false;
+  }
+
+  if (pb_info.data == NULL) {
+    pb_info.swap(full);
+  }
+}
+
+
 bool de265_image::available_zscan(int xCurr,int yCurr, int xN,int yN) const
 {
   if (xN<0 || yN<0) return false;
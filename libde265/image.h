@@ -30,6 +30,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <memory>
+#include <utility>
+#include <atomic>
 #ifdef HAVE_STDBOOL_H
 #include <stdbool.h>
 #endif
@@ -65,6 +67,8 @@ enum PictureState {
 #define SEI_HASH_CORRECT   1
 #define SEI_HASH_INCORRECT 2
 
+#define MC_BORDER 80  // replicated border around decoded pictures (luma samples)
+
 #define TU_FLAG_NONZERO_COEFF  (1<<7)
 #define TU_FLAG_SPLIT_TRANSFORM_MASK  0x1F
 
@@ -82,6 +86,7 @@ enum PictureState {
 #define CTB_PROGRESS_SAO       4
 
 class decoder_context;
+class decoded_picture_buffer;
 
 template <class DataUnit> class MetaDataArray
 {
@@ -114,6 +119,14 @@ template <class DataUnit> class MetaDataArray
     if (data) memset(data, 0, sizeof(DataUnit) * data_size);
   }
 
+  void swap(MetaDataArray& other) {
+    std::swap(data, other.data);
+    std::swap(data_size, other.data_size);
+    std::swap(log2unitSize, other.log2unitSize);
+    std::swap(width_in_units, other.width_in_units);
+    std::swap(height_in_units, other.height_in_units);
+  }
+
   const DataUnit& get(int x,int y) const {
     int unitX = x>>log2unitSize;
     int unitY = y>>log2unitSize;
@@ -236,8 +249,28 @@ struct de265_image {
 
   bool is_allocated() const { return pixels[0] != NULL; }
 
+  /* Whether the pixel planes and metadata of this image can be reused without
+     reallocation for a new picture of the given SPS. */
+  bool has_buffers_for(const seq_parameter_set& sps) const;
+
+  /* Same, but only for the pixel planes. */
+  bool has_pixel_buffers_for(const seq_parameter_set& sps) const;
+
+  // Memory held by this image, for the decoder's memory accounting.
+  int64_t get_pixel_memory_size() const;
+  int64_t get_metadata_memory_size() const;
+
   void release();
 
+  /* Fill the reserved border around the pixel planes by replicating the outermost
+     samples. Afterwards, motion compensation can read up to mc_border samples
+     outside of the picture directly from the planes. */
+  void extend_borders();
+
+  /* Free the per-picture data (slice headers), but keep pixel planes and metadata
+     allocated so that the image can be reused by a following alloc_image(). */
+  void release_slices();
+
   void set_headers(std::shared_ptr<video_parameter_set> _vps,
                    std::shared_ptr<seq_parameter_set>   _sps,
                    std::shared_ptr<pic_parameter_set>   _pps) {
@@ -358,6 +391,17 @@ private:
   int chroma_width, chroma_height;
   int stride, chroma_stride;
 
+  uint8_t* plane_memory[3];  // start of the plane allocations of the library's own allocator
+
+public:
+  uint8_t* get_plane_memory(int cIdx) const { return plane_memory[cIdx]; }
+  void set_plane_memory(int cIdx, uint8_t* mem) { plane_memory[cIdx] = mem; }
+
+  /* Border around the pixel planes (in luma samples, chroma is subsampled), reserved by
+     the library's own allocator. mc_border is non-zero when the border content is valid. */
+  int border_reserved;
+  int mc_border;
+
 public:
   uint8_t BitDepth_Y, BitDepth_C;
   uint8_t SubWidthC, SubHeightC;
@@ -383,6 +427,18 @@ public:
 
   int32_t removed_at_picture_id;
 
+  int64_t last_NAL_arrival_time; // arrival of the last slice NAL (us, monotonic)
+  int64_t output_time;           // when the picture entered the output queue
+
+  // time spent in each decoding stage (ns), only with DE265_DECODER_PARAM_STAGE_TIMING
+  std::atomic<int64_t> stage_time[DE265_NUMBER_OF_DECODE_STAGES];
+
+  void add_stage_time(enum de265_decode_stage stage, int64_t ns) {
+    stage_time[stage].fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  void reset_stage_times();
+
   const video_parameter_set& get_vps() const { return *vps; }
   const seq_parameter_set& get_sps() const { return *sps; }
   const pic_parameter_set& get_pps() const { return *pps; }
@@ -411,7 +467,9 @@ private:
 
   MetaDataArray<CTB_info>    ctb_info;
   MetaDataArray<CB_ref_info> cb_info;
-  MetaDataArray<PBMotion>    pb_info;
+  MetaDataArray<PBMotion>    pb_info;         // 4x4 while decoding, 16x16 when compressed
+  MetaDataArray<PBMotion>    pb_info_compressed_storage;
+  bool motion_field_compressed;
   MetaDataArray<uint8_t>     intraPredMode;
   MetaDataArray<uint8_t>     intraPredModeC;
   MetaDataArray<uint8_t>     tu_info;
@@ -439,6 +497,18 @@ public:
 
   nal_header nal_hdr;
 
+  std::vector<bool> decoded_tiles; // tiles in the region of interest, empty: all tiles
+
+  bool is_tile_decoded(int tileId) const {
+    return decoded_tiles.empty() || decoded_tiles[tileId];
+  }
+
+  // --- application references (de265_image_ref / de265_image_unref) ---
+
+  int  app_refcount;  // guarded by the DPB image mutex
+  bool detached;      // referenced image that was moved out of the DPB
+  decoded_picture_buffer* owner_dpb; // DPB that gets a detached image back (NULL: delete)
+
   // --- multi core ---
 
   de265_progress_lock* ctb_progress; // ctb_info_size
@@ -449,6 +519,8 @@ public:
     }
   }
 
+  void mark_tile_CTB_progress(int tileId, int progress);
+
 
   void thread_start(int nThreads);
   void thread_run(const thread_task*);
@@ -459,10 +531,17 @@ public:
      will push this image to the output queue and free all decoder data. */
   void thread_finishes(const thread_task*);
 
-  void wait_for_progress(thread_task* task, int ctbx,int ctby, int progress);
-  void wait_for_progress(thread_task* task, int ctbAddrRS, int progress);
+  /* Returns the time (ns) that the task was blocked, if stage timing is enabled.
+     It is up to the caller to account this time. When the task is traced, the
+     blocking is also added to the thread trace. */
+  int64_t wait_for_progress(thread_task* task, int ctbx,int ctby, int progress);
+  int64_t wait_for_progress(thread_task* task, int ctbAddrRS, int progress);
+
+  // Wait until all CTBs of a row reached 'progress' (also when tiles are decoded in parallel).
+  int64_t wait_for_CTB_row(thread_task* task, int ctby, int progress);
 
   void wait_for_completion();  // block until image is decoded by background threads
+  bool is_completed();         // whether all background threads have finished
   bool debug_is_completed() const;
   int  num_threads_active() const { return nThreadsRunning + nThreadsBlocked; } // for debug only
 
@@ -855,6 +934,18 @@ public:
 
   void set_mv_info(int x,int y, int nPbW,int nPbH, const PBMotion& mv);
 
+  /* After a picture has been decoded, its motion is only needed for collocated MV
+     prediction, which reads it at 16x16 granularity. This replaces pb_info with the
+     subsampled field and moves the full-resolution field into 'out_full', so that its
+     memory can be reused for the next picture. */
+  void compress_motion_field(MetaDataArray<PBMotion>& out_full);
+
+  /* Undo compress_motion_field() before the image is reused. If the image has no
+     full-resolution motion field, it takes over 'full' (which may be empty). */
+  void restore_full_motion_field(MetaDataArray<PBMotion>& full);
+
+  bool has_full_motion_field() const { return !motion_field_compressed && pb_info.data != NULL; }
+
   // --- value logging ---
 
   void printBlk(int x0,int y0, int cIdx, int log2BlkSize);
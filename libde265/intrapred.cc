@@ -340,6 +340,18 @@ void decode_intra_prediction(de265_image* img,
 }
 
 
+template void decode_intra_prediction_internal<uint8_t>(de265_image* img,
+                                                       int xB0,int yB0,
+                                                       enum IntraPredMode intraPredMode,
+                                                       uint8_t* dst, int dstStride,
+                                                       int nT, int cIdx);
+template void decode_intra_prediction_internal<uint16_t>(de265_image* img,
+                                                        int xB0,int yB0,
+                                                        enum IntraPredMode intraPredMode,
+                                                        uint16_t* dst, int dstStride,
+                                                        int nT, int cIdx);
+
+
 // TODO: remove this
 template <> void decode_intra_prediction<uint8_t>(de265_image* img,
                                                   int xB0,int yB0,
@@ -91,6 +91,14 @@ void decode_intra_prediction(de265_image* img,
                              enum IntraPredMode intraPredMode,
                              int nT, int cIdx);
 
+// for callers that know the sample type of the component (instantiated for uint8_t/uint16_t)
+template <class pixel_t>
+void decode_intra_prediction_internal(de265_image* img,
+                                      int xB0,int yB0,
+                                      enum IntraPredMode intraPredMode,
+                                      pixel_t* dst, int dstStride,
+                                      int nT, int cIdx);
+
 // TODO: remove this
 template <class pixel_t> void decode_intra_prediction(de265_image* img,
                                                       int xB0,int yB0,
@@ -50,7 +50,7 @@ void mc_luma(const base_context* ctx,
              const seq_parameter_set* sps, int mv_x, int mv_y,
              int xP,int yP,
              int16_t* out, int out_stride,
-             const pixel_t* ref, int ref_stride,
+             const pixel_t* ref, int ref_stride, int ref_border,
              int nPbW, int nPbH, int bitDepth_L)
 {
   int xFracL = mv_x & 3;
@@ -68,12 +68,17 @@ void mc_luma(const base_context* ctx,
   int w = sps->pic_width_in_luma_samples;
   int h = sps->pic_height_in_luma_samples;
 
+  // Samples in the replicated border of the reference can be read directly.
+  // Only beyond it, we have to clip the coordinates.
+
+  const int b = ref_border;
+
   ALIGNED_16(int16_t) mcbuffer[MAX_CU_SIZE * (MAX_CU_SIZE+7)];
 
   if (xFracL==0 && yFracL==0) {
 
-    if (xIntOffsL >= 0 && yIntOffsL >= 0 &&
-        nPbW+xIntOffsL <= w && nPbH+yIntOffsL <= h) {
+    if (xIntOffsL >= -b && yIntOffsL >= -b &&
+        nPbW+xIntOffsL <= w+b && nPbH+yIntOffsL <= h+b) {
 
       ctx->acceleration.put_hevc_qpel(out, out_stride,
                                       &ref[yIntOffsL*ref_stride + xIntOffsL],
@@ -131,10 +136,10 @@ void mc_luma(const base_context* ctx,
     const pixel_t* src_ptr;
     int src_stride;
 
-    if (-extra_left + xIntOffsL >= 0 &&
-        -extra_top  + yIntOffsL >= 0 &&
-        nPbW+extra_right  + xIntOffsL < w &&
-        nPbH+extra_bottom + yIntOffsL < h) {
+    if (-extra_left + xIntOffsL >= -b &&
+        -extra_top  + yIntOffsL >= -b &&
+        nPbW+extra_right  + xIntOffsL < w+b &&
+        nPbH+extra_bottom + yIntOffsL < h+b) {
       src_ptr = &ref[xIntOffsL + yIntOffsL*ref_stride];
       src_stride = ref_stride;
     }
@@ -176,7 +181,7 @@ void mc_chroma(const base_context* ctx,
                int mv_x, int mv_y,
                int xP,int yP,
                int16_t* out, int out_stride,
-               const pixel_t* ref, int ref_stride,
+               const pixel_t* ref, int ref_stride, int ref_border,
                int nPbWC, int nPbHC, int bit_depth_C)
 {
   // chroma sample interpolation process (8.5.3.2.2.2)
@@ -188,6 +193,9 @@ void mc_chroma(const base_context* ctx,
   int wC = sps->pic_width_in_luma_samples /sps->SubWidthC;
   int hC = sps->pic_height_in_luma_samples/sps->SubHeightC;
 
+  const int bx = ref_border / sps->SubWidthC;  // replicated border of the reference
+  const int by = ref_border / sps->SubHeightC;
+
   mv_x *= 2 / sps->SubWidthC;
   mv_y *= 2 / sps->SubHeightC;
 
@@ -200,8 +208,8 @@ void mc_chroma(const base_context* ctx,
   ALIGNED_32(int16_t mcbuffer[MAX_CU_SIZE*(MAX_CU_SIZE+7)]);
 
   if (xFracC == 0 && yFracC == 0) {
-    if (xIntOffsC>=0 && nPbWC+xIntOffsC<=wC &&
-        yIntOffsC>=0 && nPbHC+yIntOffsC<=hC) {
+    if (xIntOffsC>=-bx && nPbWC+xIntOffsC<=wC+bx &&
+        yIntOffsC>=-by && nPbHC+yIntOffsC<=hC+by) {
       ctx->acceleration.put_hevc_epel(out, out_stride,
                                       &ref[xIntOffsC + yIntOffsC*ref_stride], ref_stride,
                                       nPbWC,nPbHC, 0,0, NULL, bit_depth_C);
@@ -229,8 +237,8 @@ void mc_chroma(const base_context* ctx,
     int extra_right  = 2;
     int extra_bottom = 2;
 
-    if (xIntOffsC>=1 && nPbWC+xIntOffsC<=wC-2 &&
-        yIntOffsC>=1 && nPbHC+yIntOffsC<=hC-2) {
+    if (xIntOffsC>=1-bx && nPbWC+xIntOffsC<=wC-2+bx &&
+        yIntOffsC>=1-by && nPbHC+yIntOffsC<=hC-2+by) {
       src_ptr = &ref[xIntOffsC + yIntOffsC*ref_stride];
       src_stride = ref_stride;
     }
@@ -273,8 +281,158 @@ void mc_chroma(const base_context* ctx,
 
 
 
+template <class pixel_t>
+static void copy_prediction(pixel_t* dst, int dst_stride,
+                            const pixel_t* src, int src_stride,
+                            int nPbW, int nPbH)
+{
+  for (int y=0;y<nPbH;y++) {
+    memcpy(dst + y*dst_stride, src + y*src_stride, nPbW*sizeof(pixel_t));
+  }
+}
+
+
+template <class pixel_t>
+static void average_prediction(pixel_t* dst, int dst_stride,
+                               const pixel_t* src0, int src0_stride,
+                               const pixel_t* src1, int src1_stride,
+                               int nPbW, int nPbH)
+{
+  for (int y=0;y<nPbH;y++) {
+    for (int x=0;x<nPbW;x++) {
+      dst[x] = (src0[x] + src1[x] + 1) >> 1;
+    }
+
+    dst  += dst_stride;
+    src0 += src0_stride;
+    src1 += src1_stride;
+  }
+}
+
+
+/* Fast path for full-sample motion (in luma and chroma) without weighted prediction.
+   The 14-bit intermediate prediction then equals the reference samples, so we copy
+   them directly into the picture, or average them in the bi-predictive case.
+   Returns false when the block has to go through the general path. */
+static bool predict_full_sample_motion(base_context* ctx,
+                                       const slice_segment_header* shdr,
+                                       de265_image* img,
+                                       void* pixels[3], int stride[3],
+                                       const int predFlag[2], const PBMotion* vi,
+                                       int xP,int yP, int nPbW,int nPbH)
+{
+  const pic_parameter_set* pps = shdr->pps.get();
+  const seq_parameter_set* sps = pps->sps.get();
+
+  bool weighted = (shdr->slice_type == SLICE_TYPE_P ?
+                   pps->weighted_pred_flag : pps->weighted_bipred_flag);
+
+  if (weighted || sps->ChromaArrayType == CHROMA_MONO) {
+    return false;
+  }
+
+  if (predFlag[0]==0 && predFlag[1]==0) {
+    return false;
+  }
+
+  if (shdr->slice_type == SLICE_TYPE_P && predFlag[1]) {
+    return false;
+  }
+
+  const int SubWidthC  = sps->SubWidthC;
+  const int SubHeightC = sps->SubHeightC;
+
+  // MVs are in quarter luma samples, chroma is sampled at 1/8 positions
+
+  const int full_sample_mask_x = (SubWidthC ==2 ? 7 : 3);
+  const int full_sample_mask_y = (SubHeightC==2 ? 7 : 3);
+
+  const int w = sps->pic_width_in_luma_samples;
+  const int h = sps->pic_height_in_luma_samples;
+
+  const de265_image* refPic[2] = { NULL, NULL };
+
+  for (int l=0;l<2;l++) {
+    if (!predFlag[l]) {
+      continue;
+    }
+
+    if ((vi->mv[l].x & full_sample_mask_x) ||
+        (vi->mv[l].y & full_sample_mask_y)) {
+      return false;
+    }
+
+    if (vi->refIdx[l] >= MAX_NUM_REF_PICS) {
+      return false;
+    }
+
+    refPic[l] = ctx->get_image(shdr->RefPicList[l][vi->refIdx[l]]);
+    if (refPic[l]->PicState == UnusedForReference) {
+      return false;
+    }
+
+    // the block (including the chroma block) must lie within the reference border
+
+    int b = refPic[l]->mc_border;
+    int x = xP + (vi->mv[l].x >> 2);
+    int y = yP + (vi->mv[l].y >> 2);
+
+    if (x < -b || y < -b || x+nPbW > w+b || y+nPbH > h+b) {
+      return false;
+    }
+  }
+
+
+  for (int c=0;c<3;c++) {
+    int subX = (c==0 ? 1 : SubWidthC);
+    int subY = (c==0 ? 1 : SubHeightC);
+
+    int blkW = nPbW/subX;
+    int blkH = nPbH/subY;
+
+    const void* src[2];
+    int src_stride[2];
+
+    for (int l=0;l<2;l++) {
+      if (predFlag[l]) {
+        src[l] = refPic[l]->get_image_plane_at_pos_any_depth(c,
+                                                             (xP + (vi->mv[l].x >> 2)) / subX,
+                                                             (yP + (vi->mv[l].y >> 2)) / subY);
+        src_stride[l] = refPic[l]->get_image_stride(c);
+      }
+    }
+
+    if (predFlag[0] && predFlag[1]) {
+      if (img->high_bit_depth(c)) {
+        average_prediction((uint16_t*)pixels[c], stride[c],
+                           (const uint16_t*)src[0], src_stride[0],
+                           (const uint16_t*)src[1], src_stride[1], blkW,blkH);
+      }
+      else {
+        average_prediction((uint8_t*)pixels[c], stride[c],
+                           (const uint8_t*)src[0], src_stride[0],
+                           (const uint8_t*)src[1], src_stride[1], blkW,blkH);
+      }
+    }
+    else {
+      int l = (predFlag[0] ? 0 : 1);
+
+      if (img->high_bit_depth(c)) {
+        copy_prediction((uint16_t*)pixels[c], stride[c],
+                        (const uint16_t*)src[l], src_stride[l], blkW,blkH);
+      }
+      else {
+        copy_prediction((uint8_t*)pixels[c], stride[c],
+                        (const uint8_t*)src[l], src_stride[l], blkW,blkH);
+      }
+    }
+  }
+
+  return true;
+}
+
+
 // 8.5.3.2
-// NOTE: for full-pel shifts, we can introduce a fast path, simply copying without shifts
 void generate_inter_prediction_samples(base_context* ctx,
                                        const slice_segment_header* shdr,
                                        de265_image* img,
@@ -334,6 +492,12 @@ void generate_inter_prediction_samples(base_context* ctx,
   }
 
 
+  if (predict_full_sample_motion(ctx, shdr, img, pixels, stride, predFlag, vi,
+                                 xP,yP, nPbW,nPbH)) {
+    return;
+  }
+
+
   for (int l=0;l<2;l++) {
     if (predFlag[l]) {
       // 8.5.3.2.1
@@ -367,30 +531,36 @@ void generate_inter_prediction_samples(base_context* ctx,
           mc_luma(ctx, sps, vi->mv[l].x, vi->mv[l].y, xP,yP,
                   predSamplesL[l],nCS,
                   (const uint16_t*)refPic->get_image_plane(0),
-                  refPic->get_luma_stride(), nPbW,nPbH, bit_depth_L);
+                  refPic->get_luma_stride(), refPic->mc_border,
+                  nPbW,nPbH, bit_depth_L);
         }
         else {
           mc_luma(ctx, sps, vi->mv[l].x, vi->mv[l].y, xP,yP,
                   predSamplesL[l],nCS,
                   (const uint8_t*)refPic->get_image_plane(0),
-                  refPic->get_luma_stride(), nPbW,nPbH, bit_depth_L);
+                  refPic->get_luma_stride(), refPic->mc_border,
+                  nPbW,nPbH, bit_depth_L);
         }
 
         if (img->high_bit_depth(0)) {
           mc_chroma(ctx, sps, vi->mv[l].x, vi->mv[l].y, xP,yP,
                     predSamplesC[0][l],nCS, (const uint16_t*)refPic->get_image_plane(1),
-                    refPic->get_chroma_stride(), nPbW/SubWidthC,nPbH/SubHeightC, bit_depth_C);
+                    refPic->get_chroma_stride(), refPic->mc_border,
+                    nPbW/SubWidthC,nPbH/SubHeightC, bit_depth_C);
           mc_chroma(ctx, sps, vi->mv[l].x, vi->mv[l].y, xP,yP,
                     predSamplesC[1][l],nCS, (const uint16_t*)refPic->get_image_plane(2),
-                    refPic->get_chroma_stride(), nPbW/SubWidthC,nPbH/SubHeightC, bit_depth_C);
+                    refPic->get_chroma_stride(), refPic->mc_border,
+                    nPbW/SubWidthC,nPbH/SubHeightC, bit_depth_C);
         }
         else {
           mc_chroma(ctx, sps, vi->mv[l].x, vi->mv[l].y, xP,yP,
                     predSamplesC[0][l],nCS, (const uint8_t*)refPic->get_image_plane(1),
-                    refPic->get_chroma_stride(), nPbW/SubWidthC,nPbH/SubHeightC, bit_depth_C);
+                    refPic->get_chroma_stride(), refPic->mc_border,
+                    nPbW/SubWidthC,nPbH/SubHeightC, bit_depth_C);
           mc_chroma(ctx, sps, vi->mv[l].x, vi->mv[l].y, xP,yP,
                     predSamplesC[1][l],nCS, (const uint8_t*)refPic->get_image_plane(2),
-                    refPic->get_chroma_stride(), nPbW/SubWidthC,nPbH/SubHeightC, bit_depth_C);
+                    refPic->get_chroma_stride(), refPic->mc_border,
+                    nPbW/SubWidthC,nPbH/SubHeightC, bit_depth_C);
         }
       }
     }
@@ -24,17 +24,83 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
+#include <utility>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NAL_PARSER_HAVE_SSE2 1
+#endif
+
+
+/* Return a pointer to the first zero byte in [p;end), or 'end' if there is none.
+   Start codes and emulation prevention bytes can only occur after a zero byte.
+   Hence, all NAL data in between can be copied as a whole.
+ */
+static inline const unsigned char* find_zero_byte(const unsigned char* p,
+                                                  const unsigned char* end)
+{
+#if NAL_PARSER_HAVE_SSE2
+  const __m128i zero = _mm_setzero_si128();
+
+  while (end-p >= 32) {
+    __m128i a = _mm_loadu_si128((const __m128i*)p);
+    __m128i b = _mm_loadu_si128((const __m128i*)(p+16));
+    int mask = ( _mm_movemask_epi8(_mm_cmpeq_epi8(a,zero)) |
+                (_mm_movemask_epi8(_mm_cmpeq_epi8(b,zero)) << 16));
+    if (mask) {
+      int n=0;
+      while ((mask & 1)==0) { mask>>=1; n++; }
+      return p+n;
+    }
+
+    p+=32;
+  }
+
+  if (end-p >= 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)p);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a,zero));
+    if (mask) {
+      int n=0;
+      while ((mask & 1)==0) { mask>>=1; n++; }
+      return p+n;
+    }
+
+    p+=16;
+  }
+#else
+  // check 8 bytes at once for a zero byte
+
+  while (end-p >= 8) {
+    uint64_t v;
+    memcpy(&v,p,8);
+    if ((v - UINT64_C(0x0101010101010101)) & ~v & UINT64_C(0x8080808080808080)) {
+      break;
+    }
+
+    p+=8;
+  }
+#endif
+
+  while (p<end && *p!=0) {
+    p++;
+  }
+
+  return p;
+}
+
 
 NAL_unit::NAL_unit()
   : skipped_bytes(DE265_SKIPPED_BYTES_INITIAL_SIZE)
 {
   pts=0;
   user_data = NULL;
+  stream_offset = 0;
+  arrival_time = 0;
 
   nal_data = NULL;
   data_size = 0;
@@ -51,6 +117,8 @@ void NAL_unit::clear()
   header = nal_header();
   pts = 0;
   user_data = NULL;
+  stream_offset = 0;
+  arrival_time = 0;
 
   // set size to zero but keep memory
   data_size = 0;
@@ -61,7 +129,19 @@ void NAL_unit::clear()
 LIBDE265_CHECK_RESULT bool NAL_unit::resize(int new_size)
 {
   if (capacity < new_size) {
-    unsigned char* newbuffer = (unsigned char*)malloc(new_size);
+    // round up to a power of two, such that the buffer fits into a pool size class
+
+    int new_capacity = 1<<DE265_NAL_POOL_MIN_LOG2_SIZE;
+    while (new_capacity < new_size) {
+      if (new_capacity > INT_MAX/2) {
+        new_capacity = new_size;
+        break;
+      }
+
+      new_capacity *= 2;
+    }
+
+    unsigned char* newbuffer = (unsigned char*)malloc(new_capacity);
     if (newbuffer == NULL) {
       return false;
     }
@@ -72,7 +152,7 @@ LIBDE265_CHECK_RESULT bool NAL_unit::resize(int new_size)
     }
 
     nal_data = newbuffer;
-    capacity = new_size;
+    capacity = new_capacity;
   }
   return true;
 }
@@ -97,6 +177,16 @@ bool LIBDE265_CHECK_RESULT NAL_unit::set_data(const unsigned char* in_data, int
   return true;
 }
 
+void NAL_unit::swap_buffer(NAL_unit* other)
+{
+  assert(other->capacity >= data_size);
+
+  memcpy(other->nal_data, nal_data, data_size);
+
+  std::swap(nal_data, other->nal_data);
+  std::swap(capacity, other->capacity);
+}
+
 void NAL_unit::insert_skipped_byte(int pos)
 {
   skipped_bytes.push_back(pos);
@@ -115,37 +205,42 @@ int NAL_unit::num_skipped_bytes_before(int byte_position, int headerLength) cons
 void NAL_unit::remove_stuffing_bytes()
 {
   uint8_t* p = data();
+  const uint8_t* end = p + size();
 
-  for (int i=0;i<size()-2;i++)
-    {
-#if 0
-        for (int k=i;k<i+64;k++) 
-          if (i*0+k<size()) {
-            printf("%c%02x", (k==i) ? '[':' ', data()[k]);
-          }
-        printf("\n");
-#endif
+  const uint8_t* in = p;   // next input byte that has not been copied yet
+  uint8_t* out = p;        // output position (always <= in)
 
-      if (p[2]!=3 && p[2]!=0) {
-        // fast forward 3 bytes (2+1)
-        p+=2;
-        i+=2;
-      }
-      else {
-        if (p[0]==0 && p[1]==0 && p[2]==3) {
-          //printf("SKIP NAL @ %d\n",i+2+num_skipped_bytes);
-          insert_skipped_byte(i+2 + num_skipped_bytes());
+  const uint8_t* scan = p;
+  for (;;) {
+    const uint8_t* zero = find_zero_byte(scan, end);
+    if (end-zero < 3) {
+      break;
+    }
 
-          memmove(p+2, p+3, size()-i-3);
-          set_size(size()-1);
+    if (zero[1]==0 && zero[2]==3) {
+      // move everything up to the emulation prevention byte as a block
 
-          p++;
-          i++;
-        }
+      int n = zero+2 - in;
+      if (out != in) {
+        memmove(out, in, n);
       }
+      out += n;
+
+      // remember which byte we removed (position in the original NAL data)
+      insert_skipped_byte(zero+2 - p);
 
-      p++;
+      in = scan = zero+3;
+    }
+    else {
+      scan = zero+1;
     }
+  }
+
+  if (out != in) {
+    memmove(out, in, end-in);
+  }
+
+  set_size(size() - (in-out));
 }
 
 
@@ -157,8 +252,13 @@ NAL_Parser::NAL_Parser()
   end_of_stream = false;
   end_of_frame = false;
   input_push_state = 0;
+  input_stream_offset = 0;
   pending_input_NAL = NULL;
   nBytes_in_NAL_queue = 0;
+
+  pool_max_units_per_class = DE265_NAL_POOL_DEFAULT_UNITS_PER_CLASS;
+  pool_max_bytes = DE265_NAL_POOL_DEFAULT_MAX_BYTES;
+  memset(&pool_stats, 0, sizeof(pool_stats));
 }
 
 
@@ -179,30 +279,73 @@ NAL_Parser::~NAL_Parser()
     free_NAL_unit(pending_input_NAL);
   }
 
-  // free all NALs in free-list
+  // free all NALs in the pool
+
+  release_pool();
+}
 
-  for (int i=0;i<NAL_free_list.size();i++) {
-    delete NAL_free_list[i];
+
+// size class of a buffer with the given capacity (rounded down)
+static int pool_class_of_capacity(int capacity)
+{
+  int c=0;
+  while (c < DE265_NAL_POOL_NUM_CLASSES-1 &&
+         capacity >= (2<<(c+DE265_NAL_POOL_MIN_LOG2_SIZE))) {
+    c++;
   }
+
+  return c;
 }
 
+// smallest size class whose buffers can hold 'size' bytes
+static int pool_class_of_size(int size)
+{
+  int c=0;
+  while (c < DE265_NAL_POOL_NUM_CLASSES-1 &&
+         size > (1<<(c+DE265_NAL_POOL_MIN_LOG2_SIZE))) {
+    c++;
+  }
+
+  return c;
+}
+
+
+/* Take a buffer from the smallest matching size class. Also accept buffers that
+   are up to four times larger, but do not hand out huge buffers for small NALs.
+ */
+NAL_unit* NAL_Parser::take_from_pool(int size)
+{
+  int sizeClass = pool_class_of_size(size);
+
+  for (int c=sizeClass; c<=sizeClass+2 && c<DE265_NAL_POOL_NUM_CLASSES; c++) {
+    if (!NAL_pool[c].empty() &&
+        NAL_pool[c].back()->get_capacity() >= size) {
+      NAL_unit* nal = NAL_pool[c].back();
+      NAL_pool[c].pop_back();
+
+      pool_stats.num_pooled_units--;
+      pool_stats.pooled_bytes -= nal->get_capacity();
+      pool_stats.num_pool_hits++;
+      return nal;
+    }
+  }
+
+  return NULL;
+}
 
 LIBDE265_CHECK_RESULT NAL_unit* NAL_Parser::alloc_NAL_unit(int size)
 {
-  NAL_unit* nal;
+  pool_stats.num_allocations++;
 
   // --- get NAL-unit object ---
 
-  if (NAL_free_list.size() > 0) {
-    nal = NAL_free_list.back();
-    NAL_free_list.pop_back();
-  }
-  else {
+  NAL_unit* nal = take_from_pool(size);
+  if (nal == NULL) {
     nal = new NAL_unit;
   }
 
   nal->clear();
-  if (!nal->resize(size)) {
+  if (!resize_NAL_unit(nal, size)) {
     free_NAL_unit(nal);
     return NULL;
   }
@@ -210,20 +353,100 @@ LIBDE265_CHECK_RESULT NAL_unit* NAL_Parser::alloc_NAL_unit(int size)
   return nal;
 }
 
+LIBDE265_CHECK_RESULT bool NAL_Parser::resize_NAL_unit(NAL_unit* nal, int size)
+{
+  if (nal->get_capacity() >= size) {
+    return true;
+  }
+
+  // When a NAL grows, move its data into a larger buffer from the pool.
+  // The smaller buffer is put back into the pool.
+
+  NAL_unit* donor = take_from_pool(size);
+  if (donor) {
+    nal->swap_buffer(donor);
+    free_NAL_unit(donor);
+    return true;
+  }
+
+  pool_stats.num_mallocs++;
+  return nal->resize(size);
+}
+
 void NAL_Parser::free_NAL_unit(NAL_unit* nal)
 {
   if (nal == NULL) {
     // Allow calling with NULL just like regular "free()"
     return;
   }
-  if (NAL_free_list.size() < DE265_NAL_FREE_LIST_SIZE) {
-    NAL_free_list.push_back(nal);
+
+  int capacity = nal->get_capacity();
+  int sizeClass = pool_class_of_capacity(capacity);
+
+  if (capacity > 0 &&
+      (int)NAL_pool[sizeClass].size() < pool_max_units_per_class &&
+      pool_stats.pooled_bytes + capacity <= pool_max_bytes) {
+    NAL_pool[sizeClass].push_back(nal);
+
+    pool_stats.num_pooled_units++;
+    pool_stats.pooled_bytes += capacity;
   }
   else {
     delete nal;
   }
 }
 
+void NAL_Parser::release_pool()
+{
+  for (int c=0;c<DE265_NAL_POOL_NUM_CLASSES;c++) {
+    for (int i=0;i<(int)NAL_pool[c].size();i++) {
+      delete NAL_pool[c][i];
+    }
+
+    NAL_pool[c].clear();
+  }
+
+  pool_stats.num_pooled_units = 0;
+  pool_stats.pooled_bytes = 0;
+}
+
+int64_t NAL_Parser::get_memory_usage() const
+{
+  int64_t bytes = nBytes_in_NAL_queue + pool_stats.pooled_bytes;
+
+  if (pending_input_NAL) {
+    bytes += pending_input_NAL->get_capacity();
+  }
+
+  return bytes;
+}
+
+void NAL_Parser::set_pool_limits(int max_units_per_class, int64_t max_bytes)
+{
+  pool_max_units_per_class = max_units_per_class;
+  pool_max_bytes = max_bytes;
+
+  // drop buffers that exceed the new limits
+
+  for (int c=DE265_NAL_POOL_NUM_CLASSES-1;c>=0;c--) {
+    while (!NAL_pool[c].empty() &&
+           ((int)NAL_pool[c].size() > pool_max_units_per_class ||
+            pool_stats.pooled_bytes > pool_max_bytes)) {
+      NAL_unit* nal = NAL_pool[c].back();
+      NAL_pool[c].pop_back();
+
+      pool_stats.num_pooled_units--;
+      pool_stats.pooled_bytes -= nal->get_capacity();
+      delete nal;
+    }
+  }
+}
+
+void NAL_Parser::get_pool_statistics(de265_nal_pool_statistics* stats) const
+{
+  *stats = pool_stats;
+}
+
 NAL_unit* NAL_Parser::pop_from_NAL_queue()
 {
   if (NAL_queue.empty()) {
@@ -241,6 +464,8 @@ NAL_unit* NAL_Parser::pop_from_NAL_queue()
 
 void NAL_Parser::push_to_NAL_queue(NAL_unit* nal)
 {
+  nal->arrival_time = monotonic_time_us();
+
   NAL_queue.push(nal);
   nBytes_in_NAL_queue += nal->size();
 }
@@ -263,13 +488,15 @@ de265_error NAL_Parser::push_data(const unsigned char* data, int len,
 
   // Resize output buffer so that complete input would fit.
   // We add 3, because in the worst case 3 extra bytes are created for an input byte.
-  if (!nal->resize(nal->size() + len + 3)) {
+  if (!resize_NAL_unit(nal, nal->size() + len + 3)) {
     return DE265_ERROR_OUT_OF_MEMORY;
   }
 
   unsigned char* out = nal->data() + nal->size();
+  const unsigned char* start = data;
+  const unsigned char* end = data + len;
 
-  for (int i=0;i<len;i++) {
+  while (data < end) {
     /*
     printf("state=%d input=%02x (%p) (output size: %d)\n",ctx->input_push_state, *data, data,
            out - ctx->nal_data.data);
@@ -282,7 +509,10 @@ de265_error NAL_Parser::push_data(const unsigned char* data, int len,
       else { input_push_state=0; }
       break;
     case 2:
-      if      (*data == 1) { input_push_state=3; } // nal->clear_skipped_bytes(); }
+      if      (*data == 1) {
+        input_push_state=3; // nal->clear_skipped_bytes();
+        nal->stream_offset = input_stream_offset + (data-start) - 2;
+      }
       else if (*data == 0) { } // *out++ = 0; }
       else { input_push_state=0; }
       break;
@@ -297,7 +527,17 @@ de265_error NAL_Parser::push_data(const unsigned char* data, int len,
 
     case 5:
       if (*data==0) { input_push_state=6; }
-      else { *out++ = *data; }
+      else {
+        // Copy everything up to the next zero byte in one block.
+        // Only a zero byte can start a start-code or an escape sequence.
+
+        const unsigned char* zero = find_zero_byte(data+1, end);
+        int n = zero - data;
+        memcpy(out, data, n);
+        out  += n;
+        data += n;
+        continue;
+      }
       break;
 
     case 6:
@@ -337,12 +577,14 @@ de265_error NAL_Parser::push_data(const unsigned char* data, int len,
 
         // initialize new, empty NAL unit
 
-        pending_input_NAL = alloc_NAL_unit(len+3);
+        // the remaining input has to fit into the new NAL
+        pending_input_NAL = alloc_NAL_unit(end-data+3);
         if (pending_input_NAL == NULL) {
           return DE265_ERROR_OUT_OF_MEMORY;
         }
         pending_input_NAL->pts = pts;
         pending_input_NAL->user_data = user_data;
+        pending_input_NAL->stream_offset = input_stream_offset + (data-start) - 2;
         nal = pending_input_NAL;
         out = nal->data();
 
@@ -362,6 +604,8 @@ de265_error NAL_Parser::push_data(const unsigned char* data, int len,
     data++;
   }
 
+  input_stream_offset += len;
+
   nal->set_size(out - nal->data());
   return DE265_OK;
 }
@@ -383,6 +627,8 @@ de265_error NAL_Parser::push_NAL(const unsigned char* data, int len,
   }
   nal->pts = pts;
   nal->user_data = user_data;
+  nal->stream_offset = input_stream_offset;
+  input_stream_offset += len;
 
   nal->remove_stuffing_bytes();
 
@@ -29,9 +29,14 @@
 #include <vector>
 #include <queue>
 
-#define DE265_NAL_FREE_LIST_SIZE 16
 #define DE265_SKIPPED_BYTES_INITIAL_SIZE 16
 
+// NAL buffers are pooled in size classes with power-of-two capacities.
+#define DE265_NAL_POOL_MIN_LOG2_SIZE 10  // smallest buffer: 1 KB
+#define DE265_NAL_POOL_NUM_CLASSES   16  // largest class: 32 MB and above
+#define DE265_NAL_POOL_DEFAULT_UNITS_PER_CLASS 16
+#define DE265_NAL_POOL_DEFAULT_MAX_BYTES (64*1024*1024)
+
 
 class NAL_unit {
  public:
@@ -43,6 +48,9 @@ class NAL_unit {
   de265_PTS  pts;
   void*      user_data;
 
+  int64_t    stream_offset; // position of the NAL start code in the input stream
+  int64_t    arrival_time;  // monotonic time (us) at which the NAL was complete in the input
+
 
   void clear();
 
@@ -52,8 +60,13 @@ class NAL_unit {
   LIBDE265_CHECK_RESULT bool append(const unsigned char* data, int n);
   LIBDE265_CHECK_RESULT bool set_data(const unsigned char* data, int n);
 
+  /* Exchange the data buffer with that of 'other'. The current data is copied
+     into the new buffer, which must be large enough. */
+  void swap_buffer(NAL_unit* other);
+
   int size() const { return data_size; }
   void set_size(int s) { data_size=s; }
+  int  get_capacity() const { return capacity; }
   unsigned char* data() { return nal_data; }
   const unsigned char* data() const { return nal_data; }
 
@@ -125,12 +138,31 @@ class NAL_Parser
   bool is_end_of_stream() const { return end_of_stream; }
   bool is_end_of_frame() const { return end_of_frame; }
 
+
+  // --- NAL buffer pool ---
+
+  void set_pool_limits(int max_units_per_class, int64_t max_bytes);
+  int     get_pool_max_units_per_class() const { return pool_max_units_per_class; }
+  int64_t get_pool_max_bytes() const { return pool_max_bytes; }
+  void get_pool_statistics(de265_nal_pool_statistics* stats) const;
+
+  // Free all pooled NAL buffers (e.g. to stay within a memory budget).
+  void release_pool();
+
+  // Bytes held in queued, pending and pooled NAL buffers.
+  int64_t get_memory_usage() const;
+
+  // Number of bytes pushed so far. Used to compute the stream offset of each NAL.
+  int64_t get_input_stream_offset() const { return input_stream_offset; }
+  void    set_input_stream_offset(int64_t offset) { input_stream_offset = offset; }
+
  private:
   // byte-stream level
 
   bool end_of_stream; // data in pending_input_data is end of stream
   bool end_of_frame;  // data in pending_input_data is end of frame
   int  input_push_state;
+  int64_t input_stream_offset;
 
   NAL_unit* pending_input_NAL;
 
@@ -143,11 +175,17 @@ class NAL_Parser
   void push_to_NAL_queue(NAL_unit*);
 
 
-  // pool of unused NAL memory
+  // pool of unused NAL memory, one free list per size class
+
+  std::vector<NAL_unit*> NAL_pool[DE265_NAL_POOL_NUM_CLASSES];
+  int     pool_max_units_per_class;
+  int64_t pool_max_bytes;
 
-  std::vector<NAL_unit*> NAL_free_list;  // maximum size: DE265_NAL_FREE_LIST_SIZE
+  de265_nal_pool_statistics pool_stats;
 
   LIBDE265_CHECK_RESULT NAL_unit* alloc_NAL_unit(int size);
+  LIBDE265_CHECK_RESULT bool resize_NAL_unit(NAL_unit* nal, int size);
+  NAL_unit* take_from_pool(int size);
 };
 
 
@@ -22,14 +22,15 @@
 #include <math.h>
 
 
-uint32_t SSD(const uint8_t* img, int imgStride,
-             const uint8_t* ref, int refStride,
-             int width, int height)
+template <class pixel_t>
+static uint32_t SSD_internal(const pixel_t* img, int imgStride,
+                             const pixel_t* ref, int refStride,
+                             int width, int height)
 {
   uint32_t sum=0;
 
-  const uint8_t* iPtr = img;
-  const uint8_t* rPtr = ref;
+  const pixel_t* iPtr = img;
+  const pixel_t* rPtr = ref;
 
   for (int y=0;y<height;y++) {
     for (int x=0;x<width;x++) {
@@ -45,14 +46,31 @@ uint32_t SSD(const uint8_t* img, int imgStride,
 }
 
 
-uint32_t SAD(const uint8_t* img, int imgStride,
+uint32_t SSD(const uint8_t* img, int imgStride,
              const uint8_t* ref, int refStride,
              int width, int height)
+{
+  return SSD_internal(img,imgStride, ref,refStride, width,height);
+}
+
+
+uint32_t SSD(const uint16_t* img, int imgStride,
+             const uint16_t* ref, int refStride,
+             int width, int height)
+{
+  return SSD_internal(img,imgStride, ref,refStride, width,height);
+}
+
+
+template <class pixel_t>
+static uint32_t SAD_internal(const pixel_t* img, int imgStride,
+                             const pixel_t* ref, int refStride,
+                             int width, int height)
 {
   uint32_t sum=0;
 
-  const uint8_t* iPtr = img;
-  const uint8_t* rPtr = ref;
+  const pixel_t* iPtr = img;
+  const pixel_t* rPtr = ref;
 
   for (int y=0;y<height;y++) {
     for (int x=0;x<width;x++) {
@@ -68,6 +86,22 @@ uint32_t SAD(const uint8_t* img, int imgStride,
 }
 
 
+uint32_t SAD(const uint8_t* img, int imgStride,
+             const uint8_t* ref, int refStride,
+             int width, int height)
+{
+  return SAD_internal(img,imgStride, ref,refStride, width,height);
+}
+
+
+uint32_t SAD(const uint16_t* img, int imgStride,
+             const uint16_t* ref, int refStride,
+             int width, int height)
+{
+  return SAD_internal(img,imgStride, ref,refStride, width,height);
+}
+
+
 double MSE(const uint8_t* img, int imgStride,
            const uint8_t* ref, int refStride,
            int width, int height)
@@ -102,9 +136,29 @@ double PSNR(double mse)
   return 10*log10(255.0*255.0/mse);
 }
 
+
+double PSNR(double mse, int bitDepth)
+{
+  if (mse==0) { return 99.99999; }
+
+  double maxValue = (1<<bitDepth)-1;
+  return 10*log10(maxValue*maxValue/mse);
+}
+
 uint32_t compute_distortion_ssd(const de265_image* img1, const de265_image* img2,
                                 int x0, int y0, int log2size, int cIdx)
 {
+  // (input images without SPS have 8 bits, so take the bit depth from the image itself)
+  int bit_depth = (cIdx==0 ? img1->BitDepth_Y : img1->BitDepth_C);
+
+  if (bit_depth > 8) {
+    return SSD((const uint16_t*)img1->get_image_plane_at_pos_any_depth(cIdx,x0,y0),
+               img1->get_image_stride(cIdx),
+               (const uint16_t*)img2->get_image_plane_at_pos_any_depth(cIdx,x0,y0),
+               img2->get_image_stride(cIdx),
+               1<<log2size, 1<<log2size);
+  }
+
   return SSD(img1->get_image_plane_at_pos(cIdx,x0,y0), img1->get_image_stride(cIdx),
              img2->get_image_plane_at_pos(cIdx,x0,y0), img2->get_image_stride(cIdx),
              1<<log2size, 1<<log2size);
@@ -30,15 +30,24 @@ LIBDE265_API uint32_t SSD(const uint8_t* img, int imgStride,
                           const uint8_t* ref, int refStride,
                           int width, int height);
 
+LIBDE265_API uint32_t SSD(const uint16_t* img, int imgStride,
+                          const uint16_t* ref, int refStride,
+                          int width, int height);
+
 LIBDE265_API uint32_t SAD(const uint8_t* img, int imgStride,
                           const uint8_t* ref, int refStride,
                           int width, int height);
 
+LIBDE265_API uint32_t SAD(const uint16_t* img, int imgStride,
+                          const uint16_t* ref, int refStride,
+                          int width, int height);
+
 LIBDE265_API double MSE(const uint8_t* img, int imgStride,
                         const uint8_t* ref, int refStride,
                         int width, int height);
 
 LIBDE265_API double PSNR(double mse);
+LIBDE265_API double PSNR(double mse, int bitDepth);
 
 
 LIBDE265_API uint32_t compute_distortion_ssd(const de265_image* img1, const de265_image* img2,
@@ -155,9 +155,12 @@ void apply_sao_internal(de265_image* img, int xCtb,int yCtb,
             }
 
 
-            if (pps->loop_filter_across_tiles_enabled_flag==0 &&
-                pps->TileIdRS[(xS>>ctbshiftW) + (yS>>ctbshiftH)*picWidthInCtbs] !=
-                pps->TileIdRS[(xC>>ctbshiftW) + (yC>>ctbshiftH)*picWidthInCtbs]) {
+            // do not read from tiles outside of the region of interest
+
+            int tileIdS = pps->TileIdRS[(xS>>ctbshiftW) + (yS>>ctbshiftH)*picWidthInCtbs];
+
+            if ((pps->loop_filter_across_tiles_enabled_flag==0 || !img->is_tile_decoded(tileIdS)) &&
+                tileIdS != pps->TileIdRS[(xC>>ctbshiftW) + (yC>>ctbshiftH)*picWidthInCtbs]) {
               edgeIdx=0;
               break;
             }
@@ -326,7 +329,9 @@ void apply_sample_adaptive_offset_sequential(de265_image* img)
   int lumaImageSize   = img->get_image_stride(0) * img->get_height(0) * img->get_bytes_per_pixel(0);
   int chromaImageSize = img->get_image_stride(1) * img->get_height(1) * img->get_bytes_per_pixel(1);
 
-  uint8_t* inputCopy = new uint8_t[ libde265_max(lumaImageSize, chromaImageSize) ];
+  // the copy of the unfiltered plane is kept in the decoder across pictures
+
+  uint8_t* inputCopy = img->decctx->get_sao_scratch_buffer(libde265_max(lumaImageSize, chromaImageSize));
   if (inputCopy == NULL) {
     img->decctx->add_warning(DE265_WARNING_CANNOT_APPLY_SAO_OUT_OF_MEMORY,false);
     return;
@@ -365,8 +370,6 @@ void apply_sample_adaptive_offset_sequential(de265_image* img)
           }
         }
   }
-
-  delete[] inputCopy;
 }
 
 
@@ -384,6 +387,8 @@ public:
   de265_image* outputImg;
   int inputProgress;
 
+  image_unit* imgunit;
+
   virtual void work();
   virtual std::string name() const {
     char buf[100];
@@ -406,16 +411,18 @@ void thread_task_sao::work()
 
   // wait until also the CTB-rows below and above are ready
 
-  img->wait_for_progress(this, rightCtb,ctb_y,  inputProgress);
+  int64_t waitTime = img->wait_for_CTB_row(this, ctb_y,  inputProgress);
 
   if (ctb_y>0) {
-    img->wait_for_progress(this, rightCtb,ctb_y-1, inputProgress);
+    waitTime += img->wait_for_CTB_row(this, ctb_y-1, inputProgress);
   }
 
   if (ctb_y+1<sps.PicHeightInCtbsY) {
-    img->wait_for_progress(this, rightCtb,ctb_y+1, inputProgress);
+    waitTime += img->wait_for_CTB_row(this, ctb_y+1, inputProgress);
   }
 
+  int64_t start = (img->decctx->param_stage_timing ? monotonic_time_ns() : 0);
+
 
   // copy input image to output for this CTB-row
 
@@ -452,6 +459,12 @@ void thread_task_sao::work()
     }
 
 
+  if (start) {
+    img->add_stage_time(DE265_STAGE_SAO, monotonic_time_ns() - start);
+    img->add_stage_time(DE265_STAGE_WAIT_FOR_PROGRESS, waitTime);
+  }
+
+
   // mark SAO progress
 
   for (int x=0;x<=rightCtb;x++) {
@@ -459,13 +472,17 @@ void thread_task_sao::work()
     img->ctb_progress[x+ctb_y*CtbWidth].set_progress(CTB_PROGRESS_SAO);
   }
 
+  if (img->decctx->has_row_callback()) {
+    img->decctx->report_final_CTB_rows(imgunit, outputImg, CTB_PROGRESS_SAO);
+  }
+
 
   state = Finished;
   img->thread_finishes(this);
 }
 
 
-bool add_sao_tasks(image_unit* imgunit, int saoInputProgress)
+bool alloc_sao_output(image_unit* imgunit)
 {
   de265_image* img = imgunit->img;
   const seq_parameter_set& sps = img->get_sps();
@@ -474,45 +491,49 @@ bool add_sao_tasks(image_unit* imgunit, int saoInputProgress)
     return false;
   }
 
+  de265_image* output = img->decctx->take_sao_output_image(sps);
 
-  decoder_context* ctx = img->decctx;
-
-  de265_error err = imgunit->sao_output.alloc_image(img->get_width(), img->get_height(),
-                                                    img->get_chroma_format(),
-                                                    img->get_shared_sps(),
-                                                    false,
-                                                    img->decctx, //img->encctx,
-                                                    img->pts, img->user_data, true);
+  de265_error err = output->alloc_image(img->get_width(), img->get_height(),
+                                        img->get_chroma_format(),
+                                        img->get_shared_sps(),
+                                        false,
+                                        img->decctx, //img->encctx,
+                                        img->pts, img->user_data, true);
   if (err != DE265_OK) {
+    delete output;
     img->decctx->add_warning(DE265_WARNING_CANNOT_APPLY_SAO_OUT_OF_MEMORY,false);
     return false;
   }
 
-  int nRows = sps.PicHeightInCtbsY;
+  imgunit->sao_output = output;
+
+  return true;
+}
+
+
+void add_sao_tasks(image_unit* imgunit, int saoInputProgress, int firstRow, int endRow)
+{
+  de265_image* img = imgunit->img;
+  decoder_context* ctx = img->decctx;
 
-  int n=0;
-  img->thread_start(nRows);
+  if (firstRow >= endRow) {
+    return;
+  }
 
-  for (int y=0;y<nRows;y++)
+  img->thread_start(endRow-firstRow);
+
+  for (int y=firstRow;y<endRow;y++)
     {
       thread_task_sao* task = new thread_task_sao;
 
       task->inputImg  = img;
-      task->outputImg = &imgunit->sao_output;
+      task->outputImg = imgunit->sao_output;
       task->img = img;
       task->ctb_y = y;
       task->inputProgress = saoInputProgress;
+      task->imgunit = imgunit;
 
       imgunit->tasks.push_back(task);
       add_task(&ctx->thread_pool_, task);
-      n++;
     }
-
-  /* Currently need barrier here because when are finished, we have to swap the pixel
-     data back into the main image. */
-  img->wait_for_completion();
-
-  img->exchange_pixel_data_with(imgunit->sao_output);
-
-  return true;
 }
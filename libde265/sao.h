@@ -28,9 +28,15 @@ void apply_sample_adaptive_offset(de265_image* img);
 /* requires less memory than the function above */
 void apply_sample_adaptive_offset_sequential(de265_image* img);
 
-/* saoInputProgress - the CTB progress that SAO will wait for before beginning processing.
-   Returns 'true' if any tasks have been added.
+/* Allocate the output picture of the SAO tasks (imgunit->sao_output), reusing pixel
+   planes from the DPB image pool. Returns 'false' if SAO is not used or the picture
+   cannot be allocated.
  */
-bool add_sao_tasks(image_unit* imgunit, int saoInputProgress);
+bool alloc_sao_output(image_unit* imgunit);
+
+/* Queue the SAO tasks for the CTB rows [firstRow;endRow).
+   saoInputProgress - the CTB progress that SAO will wait for before beginning processing.
+ */
+void add_sao_tasks(image_unit* imgunit, int saoInputProgress, int firstRow, int endRow);
 
 #endif
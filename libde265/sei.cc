@@ -27,6 +27,7 @@
 #include "libde265/decctx.h"
 
 #include <assert.h>
+#include <string.h>
 
 
 static de265_error read_sei_decoded_picture_hash(bitreader* reader, sei_message* sei,
@@ -139,42 +140,62 @@ raw_hash_data::data_chunk raw_hash_data::prepare_8bit(const uint8_t* data,int y)
 
 raw_hash_data::data_chunk raw_hash_data::prepare_16bit(const uint8_t* data,int y)
 {
+  const uint16_t* data16 = (uint16_t*)data;
+
+  data_chunk chunk;
+  chunk.len  = 2*mWidth;
+
+  // The samples are hashed in little-endian byte order, which is their memory layout
+  // on little-endian hosts. Only big-endian hosts have to copy the line.
+
+  const uint16_t endianness_test = 1;
+  if (*(const uint8_t*)&endianness_test) {
+    chunk.data = (const uint8_t*)(data16 + y*mStride);
+    return chunk;
+  }
+
   if (mMem == NULL) {
     mMem = new uint8_t[2*mWidth];
   }
 
-  const uint16_t* data16 = (uint16_t*)data;
-
   for (int x=0; x<mWidth; x++) {
     mMem[2*x+0] = data16[y*mStride+x] & 0xFF;
     mMem[2*x+1] = data16[y*mStride+x] >> 8;
   }
 
-  data_chunk chunk;
   chunk.data = mMem;
-  chunk.len  = 2*mWidth;
   return chunk;
 }
 
 
-static uint32_t compute_checksum_8bit(uint8_t* data,int w,int h,int stride, int bit_depth)
+static uint32_t compute_checksum_8bit(const uint8_t* data,int w,int h,int stride, int bit_depth)
 {
   uint32_t sum = 0;
 
   if (bit_depth<=8) {
-    for (int y=0; y<h; y++)
+    for (int y=0; y<h; y++) {
+      const uint8_t* row = data + y*stride;
+      const uint8_t yMask = ( y & 0xFF ) ^ ( y  >>  8 );
+
       for(int x=0; x<w; x++) {
-        uint8_t xorMask = ( x & 0xFF ) ^ ( y & 0xFF ) ^ ( x  >>  8 ) ^ ( y  >>  8 );
-        sum += data[y*stride + x] ^ xorMask;
+        uint8_t xorMask = ( x & 0xFF ) ^ ( x  >>  8 ) ^ yMask;
+        sum += row[x] ^ xorMask;
       }
+    }
   }
   else {
-    for (int y=0; y<h; y++)
+    const uint16_t* data16 = (const uint16_t*)data;
+
+    for (int y=0; y<h; y++) {
+      const uint16_t* row = data16 + y*stride;
+      const uint8_t yMask = ( y & 0xFF ) ^ ( y  >>  8 );
+
       for(int x=0; x<w; x++) {
-        uint8_t xorMask = ( x & 0xFF ) ^ ( y & 0xFF ) ^ ( x  >>  8 ) ^ ( y  >>  8 );
-        sum += (data[y*stride + x] & 0xFF) ^ xorMask;
-        sum += (data[y*stride + x] >> 8)   ^ xorMask;
+        uint8_t xorMask = ( x & 0xFF ) ^ ( x  >>  8 ) ^ yMask;
+        sum += (row[x] & 0xFF) ^ xorMask;
+        sum += (row[x] >> 8)   ^ xorMask;
       }
+    }
   }
 
   return sum & 0xFFFFFFFF;
@@ -222,6 +243,53 @@ static inline uint16_t crc_process_byte_parallel(uint16_t crc, uint8_t byte)
 	   (t << 12)) & 0xFFFF;
 }
 
+/* Tables for processing eight bytes at once ("slicing-by-8").
+   table[0] is the usual byte-wise CRC table, table[k] contains the CRC of a
+   byte followed by k zero bytes. */
+struct crc_slicing_tables
+{
+  crc_slicing_tables()
+  {
+    for (int b=0;b<256;b++) {
+      table[0][b] = crc_process_byte_parallel(0, b);
+    }
+
+    for (int k=1;k<8;k++)
+      for (int b=0;b<256;b++) {
+        uint16_t crc = table[k-1][b];
+        table[k][b] = ((crc << 8) ^ table[0][crc >> 8]) & 0xFFFF;
+      }
+  }
+
+  uint16_t table[8][256];
+};
+
+static const crc_slicing_tables crc_tables;
+
+static inline uint16_t crc_process_bytes(uint16_t crc, const uint8_t* data, int len)
+{
+  const uint16_t (*t)[256] = crc_tables.table;
+
+  // The CRC register only overlaps with the first two bytes of each block.
+
+  for (; len>=8; len-=8, data+=8) {
+    crc = (t[7][data[0] ^ (crc >> 8)] ^
+           t[6][data[1] ^ (crc & 0xFF)] ^
+           t[5][data[2]] ^
+           t[4][data[3]] ^
+           t[3][data[4]] ^
+           t[2][data[5]] ^
+           t[1][data[6]] ^
+           t[0][data[7]]);
+  }
+
+  for (; len>0; len--, data++) {
+    crc = ((crc << 8) ^ t[0][*data ^ (crc >> 8)]) & 0xFFFF;
+  }
+
+  return crc;
+}
+
 static uint32_t compute_CRC_8bit_fast(const uint8_t* data,int w,int h,int stride, int bit_depth)
 {
   raw_hash_data raw_data(w,stride);
@@ -239,16 +307,14 @@ static uint32_t compute_CRC_8bit_fast(const uint8_t* data,int w,int h,int stride
     else
       chunk = raw_data.prepare_8bit(data, y);
 
-    for(int x=0; x<chunk.len; x++) {
-      crc = crc_process_byte_parallel(crc, chunk.data[x]);
-    }
+    crc = crc_process_bytes(crc, chunk.data, chunk.len);
   }
 
   return crc;
 }
 
 
-static void compute_MD5(uint8_t* data,int w,int h,int stride, uint8_t* result, int bit_depth)
+static void compute_MD5(const uint8_t* data,int w,int h,int stride, uint8_t* result, int bit_depth)
 {
   MD5_CTX md5;
   MD5_Init(&md5);
@@ -270,6 +336,59 @@ static void compute_MD5(uint8_t* data,int w,int h,int stride, uint8_t* result, i
 }
 
 
+static void compute_plane_hash(const de265_image* img, int cIdx,
+                               enum sei_decoded_picture_hash_type hash_type,
+                               sei_decoded_picture_hash* result)
+{
+  const uint8_t* data = img->get_image_plane(cIdx);
+  int w = img->get_width(cIdx);
+  int h = img->get_height(cIdx);
+  int stride = img->get_image_stride(cIdx);
+  int bit_depth = img->get_bit_depth(cIdx);
+
+  switch (hash_type) {
+  case sei_decoded_picture_hash_type_MD5:
+    compute_MD5(data,w,h,stride, result->md5[cIdx], bit_depth);
+    break;
+
+  case sei_decoded_picture_hash_type_CRC:
+    result->crc[cIdx] = compute_CRC_8bit_fast(data,w,h,stride, bit_depth);
+    break;
+
+  case sei_decoded_picture_hash_type_checksum:
+    result->checksum[cIdx] = compute_checksum_8bit(data,w,h,stride, bit_depth);
+    break;
+  }
+}
+
+
+static bool plane_hash_matches(const sei_decoded_picture_hash* seihash,
+                               const sei_decoded_picture_hash* computed, int cIdx)
+{
+  switch (seihash->hash_type) {
+  case sei_decoded_picture_hash_type_MD5:
+    return memcmp(seihash->md5[cIdx], computed->md5[cIdx], 16)==0;
+
+  case sei_decoded_picture_hash_type_CRC:
+    logtrace(LogSEI,"SEI decoded picture hash: %04x <-[%d]-> decoded picture: %04x\n",
+             seihash->crc[cIdx], cIdx, computed->crc[cIdx]);
+
+    return seihash->crc[cIdx] == computed->crc[cIdx];
+
+  case sei_decoded_picture_hash_type_checksum:
+    return seihash->checksum[cIdx] == computed->checksum[cIdx];
+  }
+
+  return true;
+}
+
+
+static int number_of_hashed_planes(const de265_image* img)
+{
+  return img->get_sps().chroma_format_idc==0 ? 1 : 3;
+}
+
+
 static de265_error process_sei_decoded_picture_hash(const sei_message* sei, de265_image* img)
 {
   const sei_decoded_picture_hash* seihash = &sei->data.decoded_picture_hash;
@@ -284,77 +403,125 @@ static de265_error process_sei_decoded_picture_hash(const sei_message* sei, de26
 
   //write_picture(img);
 
-  int nHashes = img->get_sps().chroma_format_idc==0 ? 1 : 3;
+  int nHashes = number_of_hashed_planes(img);
   for (int i=0;i<nHashes;i++) {
-    uint8_t* data;
-    int w,h,stride;
+    sei_decoded_picture_hash computed;
+    compute_plane_hash(img, i, seihash->hash_type, &computed);
 
-    w = img->get_width(i);
-    h = img->get_height(i);
+    if (!plane_hash_matches(seihash, &computed, i)) {
+      return DE265_ERROR_CHECKSUM_MISMATCH;
+    }
+  }
 
-    data = img->get_image_plane(i);
-    stride = img->get_image_stride(i);
+  loginfo(LogSEI,"decoded picture hash checked: OK\n");
+  //printf("checked picture %d SEI: OK\n", img->PicOrderCntVal);
 
-    switch (seihash->hash_type) {
-    case sei_decoded_picture_hash_type_MD5:
-      {
-        uint8_t md5[16];
-        compute_MD5(data,w,h,stride,md5, img->get_bit_depth(i));
+  return DE265_OK;
+}
 
-/*
-        fprintf(stderr,"computed MD5: ");
-        for (int b=0;b<16;b++) {
-          fprintf(stderr,"%02x", md5[b]);
-        }
-        fprintf(stderr,"\n");
-*/
 
-        for (int b=0;b<16;b++) {
-          if (md5[b] != seihash->md5[i][b]) {
-/*
-            fprintf(stderr,"SEI decoded picture MD5 mismatch (POC=%d)\n", img->PicOrderCntVal);
-*/
-            return DE265_ERROR_CHECKSUM_MISMATCH;
-          }
-        }
-      }
-      break;
+class thread_task_hash_plane : public thread_task
+{
+public:
+  sei_hash_check* check;
+  int cIdx;
+
+  virtual void work();
+  virtual std::string name() const {
+    char buf[100];
+    sprintf(buf,"hash-%d",cIdx);
+    return buf;
+  }
+};
 
-    case sei_decoded_picture_hash_type_CRC:
-      {
-        uint16_t crc = compute_CRC_8bit_fast(data,w,h,stride, img->get_bit_depth(i));
 
-        logtrace(LogSEI,"SEI decoded picture hash: %04x <-[%d]-> decoded picture: %04x\n",
-                 seihash->crc[i], i, crc);
+void thread_task_hash_plane::work()
+{
+  de265_image* img = check->img;
 
-        if (crc != seihash->crc[i]) {
-/*
-          fprintf(stderr,"SEI decoded picture hash: %04x, decoded picture: %04x (POC=%d)\n",
-                  seihash->crc[i], crc, img->PicOrderCntVal);
-*/
-          return DE265_ERROR_CHECKSUM_MISMATCH;
-        }
-      }
-      break;
+  state = Running;
+  img->thread_run(this);
 
-    case sei_decoded_picture_hash_type_checksum:
-      {
-        uint32_t chksum = compute_checksum_8bit(data,w,h,stride, img->get_bit_depth(i));
+  int64_t start = (img->decctx->param_stage_timing ? monotonic_time_ns() : 0);
 
-        if (chksum != seihash->checksum[i]) {
-/*
-          fprintf(stderr,"SEI decoded picture hash: %04x, decoded picture: %04x (POC=%d)\n",
-                  seihash->checksum[i], chksum, img->PicOrderCntVal);
-*/
-          return DE265_ERROR_CHECKSUM_MISMATCH;
-        }
-      }
-      break;
+  compute_plane_hash(img, cIdx, check->seihash.hash_type, &check->computed);
+
+  if (start) {
+    check->hash_time += monotonic_time_ns() - start;
+  }
+
+  state = Finished;
+  img->thread_finishes(this);
+}
+
+
+sei_hash_check::sei_hash_check(const sei_message* sei, de265_image* image)
+{
+  seihash = sei->data.decoded_picture_hash;
+  img = image;
+  hash_time = 0;
+
+  decoded_picture_buffer::ref_image(img);
+}
+
+
+sei_hash_check::~sei_hash_check()
+{
+  if (!tasks.empty()) {
+    img->wait_for_completion();
+  }
+
+  for (int i=0;i<(int)tasks.size();i++) {
+    delete tasks[i];
+  }
+
+  decoded_picture_buffer::unref_image(img);
+}
+
+
+void sei_hash_check::start(thread_pool* pool)
+{
+  // see process_sei_decoded_picture_hash()
+  if (img->PicOutputFlag == false) {
+    return;
+  }
+
+  int nHashes = number_of_hashed_planes(img);
+
+  img->thread_start(nHashes);
+
+  for (int i=0;i<nHashes;i++) {
+    thread_task_hash_plane* task = new thread_task_hash_plane;
+    task->check = this;
+    task->cIdx  = i;
+
+    tasks.push_back(task);
+    add_task(pool, task);
+  }
+}
+
+
+bool sei_hash_check::is_finished() const
+{
+  return tasks.empty() || img->is_completed();
+}
+
+
+de265_error sei_hash_check::get_result()
+{
+  if (tasks.empty()) {
+    return DE265_OK;
+  }
+
+  img->wait_for_completion();
+
+  for (int i=0;i<(int)tasks.size();i++) {
+    if (!plane_hash_matches(&seihash, &computed, i)) {
+      return DE265_ERROR_CHECKSUM_MISMATCH;
     }
   }
 
   loginfo(LogSEI,"decoded picture hash checked: OK\n");
-  //printf("checked picture %d SEI: OK\n", img->PicOrderCntVal);
 
   return DE265_OK;
 }
@@ -424,10 +591,16 @@ de265_error process_sei(const sei_message* sei, de265_image* img)
   switch (sei->payload_type) {
   case sei_payload_type_decoded_picture_hash:
     if (img->decctx->param_sei_check_hash) {
+      int64_t start = (img->decctx->param_stage_timing ? monotonic_time_ns() : 0);
+
       err = process_sei_decoded_picture_hash(sei, img);
       if (err==DE265_OK) {
         //printf("SEI check ok\n");
       }
+
+      if (start) {
+        img->add_stage_time(DE265_STAGE_HASH_CHECK, monotonic_time_ns() - start);
+      }
     }
 
     break;
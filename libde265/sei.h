@@ -23,6 +23,10 @@
 
 #include "libde265/bitstream.h"
 #include "libde265/de265.h"
+#include "libde265/threads.h"
+
+#include <atomic>
+#include <vector>
 
 
 enum sei_payload_type {
@@ -86,4 +90,35 @@ de265_error read_sei(bitreader* reader, sei_message*, bool suffix, const seq_par
 void dump_sei(const sei_message*, const seq_parameter_set* sps);
 de265_error process_sei(const sei_message*, struct de265_image* img);
 
+
+/* Check of a decoded picture hash SEI on the worker threads.
+   Each color plane is hashed by a separate task, and the decoder continues with the
+   next pictures while the check is running. The image is referenced until the check
+   object is deleted, so that it is not reused in the meantime.
+ */
+class sei_hash_check
+{
+ public:
+  sei_hash_check(const sei_message* sei, struct de265_image* img);
+  ~sei_hash_check(); // waits for running tasks
+
+  void start(thread_pool* pool);
+
+  bool is_finished() const;
+  de265_error get_result(); // blocks until all planes have been hashed
+
+  int64_t get_hash_time() const { return hash_time; } // (ns) when stage timing is enabled
+
+ private:
+  sei_decoded_picture_hash seihash;
+  sei_decoded_picture_hash computed;
+
+  struct de265_image* img;
+  std::vector<thread_task*> tasks;
+
+  std::atomic<int64_t> hash_time;
+
+  friend class thread_task_hash_plane;
+};
+
 #endif
@@ -47,7 +47,9 @@ extern bool read_short_term_ref_pic_set(error_queue* errqueue,
                                         bool sliceRefPicSet);
 
 
+template <class pixel_t, int ChromaArrayType>
 void read_coding_tree_unit(thread_context* tctx);
+template <class pixel_t, int ChromaArrayType>
 void read_coding_quadtree(thread_context* tctx,
                           int xCtb, int yCtb,
                           int Log2CtbSizeY,
@@ -2832,6 +2834,7 @@ void read_sao(thread_context* tctx, int xCtb,int yCtb,
 }
 
 
+template <class pixel_t, int ChromaArrayType>
 void read_coding_tree_unit(thread_context* tctx)
 {
   slice_segment_header* shdr = tctx->shdr;
@@ -2858,7 +2861,7 @@ void read_coding_tree_unit(thread_context* tctx)
       read_sao(tctx, xCtb,yCtb, CtbAddrInSliceSeg);
     }
 
-  read_coding_quadtree(tctx, xCtbPixels, yCtbPixels, sps.Log2CtbSizeY, 0);
+  read_coding_quadtree<pixel_t,ChromaArrayType>(tctx, xCtbPixels, yCtbPixels, sps.Log2CtbSizeY, 0);
 }
 
 
@@ -3421,6 +3424,133 @@ int residual_coding(thread_context* tctx,
 }
 
 
+void begin_slice_data_timing(thread_context* tctx)
+{
+  if (tctx->decctx->param_stage_timing) {
+    for (int i=0;i<DE265_NUMBER_OF_DECODE_STAGES;i++) {
+      tctx->stage_time[i] = 0;
+    }
+
+    tctx->slice_data_start = monotonic_time_ns();
+  }
+  else {
+    tctx->slice_data_start = 0;
+  }
+}
+
+
+void end_slice_data_timing(thread_context* tctx)
+{
+  if (tctx->slice_data_start == 0) {
+    return;
+  }
+
+  int64_t* t = tctx->stage_time;
+
+  t[DE265_STAGE_SLICE_DATA] = (monotonic_time_ns() - tctx->slice_data_start
+                               - t[DE265_STAGE_INTRA_PREDICTION]
+                               - t[DE265_STAGE_MOTION_COMPENSATION]
+                               - t[DE265_STAGE_INVERSE_TRANSFORM]
+                               - t[DE265_STAGE_WAIT_FOR_PROGRESS]);
+
+  for (int i=0;i<DE265_NUMBER_OF_DECODE_STAGES;i++) {
+    if (t[i]) {
+      tctx->img->add_stage_time((enum de265_decode_stage)i, t[i]);
+    }
+  }
+
+  tctx->slice_data_start = 0;
+}
+
+
+// returns the start time of a stage, 0 if the timing is switched off
+static inline int64_t stage_start(const thread_context* tctx)
+{
+  return tctx->slice_data_start ? monotonic_time_ns() : 0;
+}
+
+static inline void stage_end(thread_context* tctx, enum de265_decode_stage stage,
+                             int64_t start)
+{
+  if (start) {
+    tctx->stage_time[stage] += monotonic_time_ns() - start;
+  }
+}
+
+
+/* The CTB decoding functions from read_coding_tree_unit() down to decode_TU() are
+   instantiated per sample type and chroma format (see decode_substream()), such that
+   they do not have to check the picture format for each block.
+   A pixel_t of void is used when luma and chroma have different sample types.
+ */
+
+template <int ChromaArrayType> struct chroma_format
+{
+  static const int SubWidthC  = (ChromaArrayType==CHROMA_420 ||
+                                 ChromaArrayType==CHROMA_422) ? 2 : 1;
+  static const int SubHeightC = (ChromaArrayType==CHROMA_420) ? 2 : 1;
+};
+
+
+template <class pixel_t>
+void read_pcm_samples_internal(thread_context* tctx, int x0, int y0, int log2CbSize,
+                               int cIdx, bitreader& br);
+
+template <class pixel_t> struct ctb_samples
+{
+  static void intra_prediction(de265_image* img, int x0,int y0,
+                               enum IntraPredMode intraPredMode, int nT, int cIdx)
+  {
+    decode_intra_prediction_internal<pixel_t>(img, x0,y0, intraPredMode,
+                                              img->get_image_plane_at_pos_NEW<pixel_t>(cIdx,x0,y0),
+                                              img->get_image_stride(cIdx),
+                                              nT,cIdx);
+  }
+
+  static void scale_coefficients(thread_context* tctx, int xT,int yT, int x0,int y0,
+                                 int nT, int cIdx,
+                                 bool transform_skip_flag, bool intra, int rdpcmMode)
+  {
+    scale_coefficients_internal<pixel_t>(tctx, xT,yT, x0,y0, nT,cIdx,
+                                         transform_skip_flag, intra, rdpcmMode);
+  }
+
+  static void pcm_samples(thread_context* tctx, int x0,int y0, int log2CbSize,
+                          int cIdx, bitreader& br)
+  {
+    read_pcm_samples_internal<pixel_t>(tctx,x0,y0,log2CbSize,cIdx,br);
+  }
+};
+
+// sample type decided per component
+template <> struct ctb_samples<void>
+{
+  static void intra_prediction(de265_image* img, int x0,int y0,
+                               enum IntraPredMode intraPredMode, int nT, int cIdx)
+  {
+    decode_intra_prediction(img, x0,y0, intraPredMode, nT,cIdx);
+  }
+
+  static void scale_coefficients(thread_context* tctx, int xT,int yT, int x0,int y0,
+                                 int nT, int cIdx,
+                                 bool transform_skip_flag, bool intra, int rdpcmMode)
+  {
+    ::scale_coefficients(tctx, xT,yT, x0,y0, nT,cIdx, transform_skip_flag, intra, rdpcmMode);
+  }
+
+  static void pcm_samples(thread_context* tctx, int x0,int y0, int log2CbSize,
+                          int cIdx, bitreader& br)
+  {
+    if (tctx->img->high_bit_depth(cIdx)) {
+      read_pcm_samples_internal<uint16_t>(tctx,x0,y0,log2CbSize,cIdx,br);
+    } else {
+      read_pcm_samples_internal<uint8_t>(tctx,x0,y0,log2CbSize,cIdx,br);
+    }
+  }
+};
+
+
+template <class pixel_t, int ChromaArrayType>
 static void decode_TU(thread_context* tctx,
                       int x0,int y0,
                       int xCUBase,int yCUBase,
@@ -3439,8 +3569,8 @@ static void decode_TU(thread_context* tctx,
         intraPredMode = img->get_IntraPredMode(x0,y0);
       }
       else {
-        const int SubWidthC  = sps.SubWidthC;
-        const int SubHeightC = sps.SubHeightC;
+        const int SubWidthC  = chroma_format<ChromaArrayType>::SubWidthC;
+        const int SubHeightC = chroma_format<ChromaArrayType>::SubHeightC;
 
         intraPredMode = img->get_IntraPredModeC(x0*SubWidthC,y0*SubHeightC);
       }
@@ -3450,7 +3580,9 @@ static void decode_TU(thread_context* tctx,
         intraPredMode = INTRA_DC;
       }
 
-      decode_intra_prediction(img, x0,y0, intraPredMode, nT, cIdx);
+      int64_t start = stage_start(tctx);
+      ctb_samples<pixel_t>::intra_prediction(img, x0,y0, intraPredMode, nT, cIdx);
+      stage_end(tctx, DE265_STAGE_INTRA_PREDICTION, start);
 
 
       residualDpcm = sps.range_extension.implicit_rdpcm_enabled_flag &&
@@ -3468,8 +3600,11 @@ static void decode_TU(thread_context* tctx,
     }
 
   if (cbf) {
-    scale_coefficients(tctx, x0,y0, xCUBase,yCUBase, nT, cIdx,
-                       tctx->transform_skip_flag[cIdx], cuPredMode==MODE_INTRA, residualDpcm);
+    int64_t start = stage_start(tctx);
+    ctb_samples<pixel_t>::scale_coefficients(tctx, x0,y0, xCUBase,yCUBase, nT, cIdx,
+                                             tctx->transform_skip_flag[cIdx],
+                                             cuPredMode==MODE_INTRA, residualDpcm);
+    stage_end(tctx, DE265_STAGE_INVERSE_TRANSFORM, start);
   }
   /*
   else if (!cbf && cIdx==0) {
@@ -3482,8 +3617,11 @@ static void decode_TU(thread_context* tctx,
     tctx->nCoeff[cIdx] = 0;
     residualDpcm=0;
 
-    scale_coefficients(tctx, x0,y0, xCUBase,yCUBase, nT, cIdx,
-                       tctx->transform_skip_flag[cIdx], cuPredMode==MODE_INTRA, residualDpcm);
+    int64_t start = stage_start(tctx);
+    ctb_samples<pixel_t>::scale_coefficients(tctx, x0,y0, xCUBase,yCUBase, nT, cIdx,
+                                             tctx->transform_skip_flag[cIdx],
+                                             cuPredMode==MODE_INTRA, residualDpcm);
+    stage_end(tctx, DE265_STAGE_INVERSE_TRANSFORM, start);
   }
 }
 
@@ -3546,6 +3684,7 @@ static void read_cross_comp_pred(thread_context* tctx, int cIdxMinus1)
 }
 
 
+template <class pixel_t, int ChromaArrayType>
 int read_transform_unit(thread_context* tctx,
                         int x0, int y0,        // position of TU in frame
                         int xBase, int yBase,  // position of parent TU in frame
@@ -3562,10 +3701,6 @@ int read_transform_unit(thread_context* tctx,
   assert(cbf_cr != -1);
   assert(cbf_luma != -1);
 
-  const seq_parameter_set& sps = tctx->img->get_sps();
-
-  const int ChromaArrayType = sps.ChromaArrayType;
-
   int log2TrafoSizeC = (ChromaArrayType==CHROMA_444 ? log2TrafoSize : log2TrafoSize-1);
   log2TrafoSizeC = libde265_max(2, log2TrafoSizeC);
 
@@ -3644,14 +3779,11 @@ int read_transform_unit(thread_context* tctx,
       }
     }
 
-  // position of TU in local CU
-  int xL = x0 - xCUBase;
-  int yL = y0 - yCUBase;
   int nT = 1<<log2TrafoSize;
   int nTC = 1<<log2TrafoSizeC;
 
-  const int SubWidthC  = sps.SubWidthC;
-  const int SubHeightC = sps.SubHeightC;
+  const int SubWidthC  = chroma_format<ChromaArrayType>::SubWidthC;
+  const int SubHeightC = chroma_format<ChromaArrayType>::SubHeightC;
 
   // --- luma ---
 
@@ -3662,13 +3794,11 @@ int read_transform_unit(thread_context* tctx,
     if ((err=residual_coding(tctx,x0,y0, log2TrafoSize,0)) != DE265_OK) return err;
   }
 
-  decode_TU(tctx, x0,y0, xCUBase,yCUBase, nT, 0, cuPredMode, cbf_luma);
+  decode_TU<pixel_t,ChromaArrayType>(tctx, x0,y0, xCUBase,yCUBase, nT, 0, cuPredMode, cbf_luma);
 
 
   // --- chroma ---
 
-  const int yOffset422 = 1<<log2TrafoSizeC;
-
   if (log2TrafoSize>2 || ChromaArrayType == CHROMA_444) {
     // TODO: cross-component prediction
 
@@ -3689,8 +3819,8 @@ int read_transform_unit(thread_context* tctx,
         if ((err=residual_coding(tctx,x0,y0,log2TrafoSizeC,1)) != DE265_OK) return err;
       }
 
-      if (sps.ChromaArrayType != CHROMA_MONO) {
-        decode_TU(tctx,
+      if (ChromaArrayType != CHROMA_MONO) {
+        decode_TU<pixel_t,ChromaArrayType>(tctx,
                   x0/SubWidthC,y0/SubHeightC,
                   xCUBase/SubWidthC,yCUBase/SubHeightC, nTC, 1, cuPredMode, cbf_cb & 1);
       }
@@ -3706,7 +3836,7 @@ int read_transform_unit(thread_context* tctx,
                                  log2TrafoSizeC,1)) != DE265_OK) return err;
       }
 
-      decode_TU(tctx,
+      decode_TU<pixel_t,ChromaArrayType>(tctx,
                 x0/SubWidthC,y0/SubHeightC + yOffset,
                 xCUBase/SubWidthC,yCUBase/SubHeightC +yOffset,
                 nTC, 1, cuPredMode, cbf_cb & 2);
@@ -3725,8 +3855,8 @@ int read_transform_unit(thread_context* tctx,
         if ((err=residual_coding(tctx,x0,y0,log2TrafoSizeC,2)) != DE265_OK) return err;
       }
 
-      if (sps.ChromaArrayType != CHROMA_MONO) {
-        decode_TU(tctx,
+      if (ChromaArrayType != CHROMA_MONO) {
+        decode_TU<pixel_t,ChromaArrayType>(tctx,
                   x0/SubWidthC,y0/SubHeightC,
                   xCUBase/SubWidthC,yCUBase/SubHeightC,
                   nTC, 2, cuPredMode, cbf_cr & 1);
@@ -3743,7 +3873,7 @@ int read_transform_unit(thread_context* tctx,
                                  log2TrafoSizeC,2)) != DE265_OK) return err;
       }
 
-      decode_TU(tctx,
+      decode_TU<pixel_t,ChromaArrayType>(tctx,
                 x0/SubWidthC,y0/SubHeightC+yOffset,
                 xCUBase/SubWidthC,yCUBase/SubHeightC+yOffset,
                 nTC, 2, cuPredMode, cbf_cr & 2);
@@ -3755,8 +3885,8 @@ int read_transform_unit(thread_context* tctx,
                                log2TrafoSize,1)) != DE265_OK) return err;
     }
 
-    if (sps.ChromaArrayType != CHROMA_MONO) {
-      decode_TU(tctx,
+    if (ChromaArrayType != CHROMA_MONO) {
+      decode_TU<pixel_t,ChromaArrayType>(tctx,
                 xBase/SubWidthC,  yBase/SubHeightC,
                 xCUBase/SubWidthC,yCUBase/SubHeightC, nT, 1, cuPredMode, cbf_cb & 1);
     }
@@ -3769,7 +3899,7 @@ int read_transform_unit(thread_context* tctx,
     }
 
     if (ChromaArrayType == CHROMA_422) {
-      decode_TU(tctx,
+      decode_TU<pixel_t,ChromaArrayType>(tctx,
                 xBase/SubWidthC,  yBase/SubHeightC + (1<<log2TrafoSize),
                 xCUBase/SubWidthC,yCUBase/SubHeightC, nT, 1, cuPredMode, cbf_cb & 2);
     }
@@ -3779,8 +3909,8 @@ int read_transform_unit(thread_context* tctx,
                                log2TrafoSize,2)) != DE265_OK) return err;
     }
 
-    if (sps.ChromaArrayType != CHROMA_MONO) {
-      decode_TU(tctx,
+    if (ChromaArrayType != CHROMA_MONO) {
+      decode_TU<pixel_t,ChromaArrayType>(tctx,
                 xBase/SubWidthC,  yBase/SubHeightC,
                 xCUBase/SubWidthC,yCUBase/SubHeightC, nT, 2, cuPredMode, cbf_cr & 1);
     }
@@ -3793,7 +3923,7 @@ int read_transform_unit(thread_context* tctx,
     }
 
     if (ChromaArrayType == CHROMA_422) {
-      decode_TU(tctx,
+      decode_TU<pixel_t,ChromaArrayType>(tctx,
                 xBase/SubWidthC,  yBase/SubHeightC + (1<<log2TrafoSize),
                 xCUBase/SubWidthC,yCUBase/SubHeightC, nT, 2, cuPredMode, cbf_cr & 2);
     }
@@ -3818,6 +3948,7 @@ static void dump_cbsize(de265_image* img)
 }
 
 
+template <class pixel_t, int ChromaArrayType>
 void read_transform_tree(thread_context* tctx,
                          int x0, int y0,        // position of TU in frame
                          int xBase, int yBase,  // position of parent TU in frame
@@ -3881,13 +4012,13 @@ void read_transform_tree(thread_context* tctx,
   // 4:2:0 and 4:4:4 modes: binary flag in bit 0
   // 4:2:2 mode: bit 0: top block, bit 1: bottom block
 
-  if ((log2TrafoSize>2 && sps.ChromaArrayType != CHROMA_MONO) ||
-      sps.ChromaArrayType == CHROMA_444) {
+  if ((log2TrafoSize>2 && ChromaArrayType != CHROMA_MONO) ||
+      ChromaArrayType == CHROMA_444) {
     // we do not have to test for trafoDepth==0, because parent_cbf_cb is 1 at depth 0
     if (/*trafoDepth==0 ||*/ parent_cbf_cb) {
       cbf_cb = decode_cbf_chroma(tctx,trafoDepth);
 
-      if (sps.ChromaArrayType == CHROMA_422 && (!split_transform_flag || log2TrafoSize==3)) {
+      if (ChromaArrayType == CHROMA_422 && (!split_transform_flag || log2TrafoSize==3)) {
         cbf_cb |= (decode_cbf_chroma(tctx,trafoDepth) << 1);
       }
     }
@@ -3896,7 +4027,7 @@ void read_transform_tree(thread_context* tctx,
     if (/*trafoDepth==0 ||*/ parent_cbf_cr) {
       cbf_cr = decode_cbf_chroma(tctx,trafoDepth);
 
-      if (sps.ChromaArrayType == CHROMA_422 && (!split_transform_flag || log2TrafoSize==3)) {
+      if (ChromaArrayType == CHROMA_422 && (!split_transform_flag || log2TrafoSize==3)) {
         cbf_cr |= (decode_cbf_chroma(tctx,trafoDepth) << 1);
       }
     }
@@ -3935,14 +4066,22 @@ void read_transform_tree(thread_context* tctx,
 
     logtrace(LogSlice,"transform split.\n");
 
-    read_transform_tree(tctx, x0,y0, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 0,
-                        MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
-    read_transform_tree(tctx, x1,y0, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 1,
-                        MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
-    read_transform_tree(tctx, x0,y1, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 2,
-                        MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
-    read_transform_tree(tctx, x1,y1, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 3,
-                        MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
+    read_transform_tree<pixel_t,ChromaArrayType>(tctx, x0,y0, x0,y0, xCUBase,yCUBase,
+                                                 log2TrafoSize-1, trafoDepth+1, 0,
+                                                 MaxTrafoDepth,IntraSplitFlag, cuPredMode,
+                                                 cbf_cb,cbf_cr);
+    read_transform_tree<pixel_t,ChromaArrayType>(tctx, x1,y0, x0,y0, xCUBase,yCUBase,
+                                                 log2TrafoSize-1, trafoDepth+1, 1,
+                                                 MaxTrafoDepth,IntraSplitFlag, cuPredMode,
+                                                 cbf_cb,cbf_cr);
+    read_transform_tree<pixel_t,ChromaArrayType>(tctx, x0,y1, x0,y0, xCUBase,yCUBase,
+                                                 log2TrafoSize-1, trafoDepth+1, 2,
+                                                 MaxTrafoDepth,IntraSplitFlag, cuPredMode,
+                                                 cbf_cb,cbf_cr);
+    read_transform_tree<pixel_t,ChromaArrayType>(tctx, x1,y1, x0,y0, xCUBase,yCUBase,
+                                                 log2TrafoSize-1, trafoDepth+1, 3,
+                                                 MaxTrafoDepth,IntraSplitFlag, cuPredMode,
+                                                 cbf_cb,cbf_cr);
   }
   else {
     int cbf_luma;
@@ -3960,8 +4099,9 @@ void read_transform_tree(thread_context* tctx,
 
     logtrace(LogSlice,"call read_transform_unit %d/%d\n",x0,y0);
 
-    read_transform_unit(tctx, x0,y0,xBase,yBase, xCUBase,yCUBase, log2TrafoSize,trafoDepth, blkIdx,
-                        cbf_luma, cbf_cb, cbf_cr);
+    read_transform_unit<pixel_t,ChromaArrayType>(tctx, x0,y0,xBase,yBase, xCUBase,yCUBase,
+                                                 log2TrafoSize,trafoDepth, blkIdx,
+                                                 cbf_luma, cbf_cb, cbf_cr);
   }
 }
 
@@ -4133,8 +4273,10 @@ void read_prediction_unit(thread_context* tctx,
 
 
 
+  int64_t start = stage_start(tctx);
   decode_prediction_unit(tctx->decctx, tctx->shdr, tctx->img, tctx->motion,
                          xC,yC,xB,yB, nCS, nPbW,nPbH, partIdx);
+  stage_end(tctx, DE265_STAGE_MOTION_COMPENSATION, start);
 }
 
 
@@ -4182,6 +4324,7 @@ void read_pcm_samples_internal(thread_context* tctx, int x0, int y0, int log2CbS
       }
 }
 
+template <class pixel_t, int ChromaArrayType>
 static void read_pcm_samples(thread_context* tctx, int x0, int y0, int log2CbSize)
 {
   bitreader br;
@@ -4191,20 +4334,11 @@ static void read_pcm_samples(thread_context* tctx, int x0, int y0, int log2CbSiz
   br.nextbits_cnt = 0;
 
 
-  if (tctx->img->high_bit_depth(0)) {
-    read_pcm_samples_internal<uint16_t>(tctx,x0,y0,log2CbSize,0,br);
-  } else {
-    read_pcm_samples_internal<uint8_t>(tctx,x0,y0,log2CbSize,0,br);
-  }
+  ctb_samples<pixel_t>::pcm_samples(tctx,x0,y0,log2CbSize,0,br);
 
-  if (tctx->img->get_sps().ChromaArrayType != CHROMA_MONO) {
-    if (tctx->img->high_bit_depth(1)) {
-      read_pcm_samples_internal<uint16_t>(tctx,x0,y0,log2CbSize,1,br);
-      read_pcm_samples_internal<uint16_t>(tctx,x0,y0,log2CbSize,2,br);
-    } else {
-      read_pcm_samples_internal<uint8_t>(tctx,x0,y0,log2CbSize,1,br);
-      read_pcm_samples_internal<uint8_t>(tctx,x0,y0,log2CbSize,2,br);
-    }
+  if (ChromaArrayType != CHROMA_MONO) {
+    ctb_samples<pixel_t>::pcm_samples(tctx,x0,y0,log2CbSize,1,br);
+    ctb_samples<pixel_t>::pcm_samples(tctx,x0,y0,log2CbSize,2,br);
   }
 
   prepare_for_CABAC(&br);
@@ -4242,6 +4376,7 @@ static const uint8_t map_chroma_422[35] = {
   21,22,23,23,24,24,25,25,26,27,27,28,28,29,29,30,31
 };
 
+template <class pixel_t, int ChromaArrayType>
 void read_coding_unit(thread_context* tctx,
                       int x0, int y0,  // position of coding unit in frame
                       int log2CbSize,
@@ -4306,8 +4441,10 @@ void read_coding_unit(thread_context* tctx,
     // DECODE
 
     int nCS_L = 1<<log2CbSize;
+    int64_t start = stage_start(tctx);
     decode_prediction_unit(tctx->decctx,tctx->shdr,tctx->img,tctx->motion,
                            x0,y0, 0,0, nCS_L, nCS_L,nCS_L, 0);
+    stage_end(tctx, DE265_STAGE_MOTION_COMPENSATION, start);
   }
   else /* not skipped */ {
     if (shdr->slice_type != SLICE_TYPE_I) {
@@ -4353,7 +4490,7 @@ void read_coding_unit(thread_context* tctx,
       if (pcm_flag) {
         img->set_pcm_flag(x0,y0,log2CbSize);
 
-        read_pcm_samples(tctx, x0,y0, log2CbSize);
+        read_pcm_samples<pixel_t,ChromaArrayType>(tctx, x0,y0, log2CbSize);
       }
       else {
         int pbOffset = (PartMode == PART_NxN) ? (nCbS/2) : nCbS;
@@ -4444,7 +4581,7 @@ void read_coding_unit(thread_context* tctx,
 
         // set chroma intra prediction mode
 
-        if (sps.ChromaArrayType == CHROMA_444) {
+        if (ChromaArrayType == CHROMA_444) {
           // chroma 4:4:4
 
           idx = 0;
@@ -4467,7 +4604,7 @@ void read_coding_unit(thread_context* tctx,
               idx++;
             }
         }
-        else if (sps.ChromaArrayType != CHROMA_MONO) {
+        else if (ChromaArrayType != CHROMA_MONO) {
           // chroma 4:2:0 and 4:2:2
 
           int intra_chroma_pred_mode = decode_intra_chroma_pred_mode(tctx);
@@ -4475,7 +4612,7 @@ void read_coding_unit(thread_context* tctx,
           logtrace(LogSlice,"IntraPredMode: %d\n",IntraPredMode);
           int IntraPredModeC = map_chroma_pred_mode(intra_chroma_pred_mode, IntraPredMode);
 
-          if (sps.ChromaArrayType == CHROMA_422) {
+          if (ChromaArrayType == CHROMA_422) {
             IntraPredModeC = map_chroma_422[ IntraPredModeC ];
           }
 
@@ -4563,11 +4700,12 @@ void read_coding_unit(thread_context* tctx,
         logtrace(LogSlice,"MaxTrafoDepth: %d\n",MaxTrafoDepth);
 
         uint8_t initial_chroma_cbf = 1;
-        if (sps.ChromaArrayType == CHROMA_MONO) {
+        if (ChromaArrayType == CHROMA_MONO) {
           initial_chroma_cbf = 0;
         }
 
-        read_transform_tree(tctx, x0,y0, x0,y0, x0,y0, log2CbSize, 0,0,
+        read_transform_tree<pixel_t,ChromaArrayType>(tctx,
+                                                 x0,y0, x0,y0, x0,y0, log2CbSize, 0,0,
                             MaxTrafoDepth, IntraSplitFlag, cuPredMode,
                             initial_chroma_cbf, initial_chroma_cbf);
       }
@@ -4579,6 +4717,7 @@ void read_coding_unit(thread_context* tctx,
 // ------------------------------------------------------------------------------------------
 
 
+template <class pixel_t, int ChromaArrayType>
 void read_coding_quadtree(thread_context* tctx,
                           int x0, int y0,
                           int log2CbSize,
@@ -4627,24 +4766,24 @@ void read_coding_quadtree(thread_context* tctx,
     int x1 = x0 + (1<<(log2CbSize-1));
     int y1 = y0 + (1<<(log2CbSize-1));
 
-    read_coding_quadtree(tctx,x0,y0, log2CbSize-1, ctDepth+1);
+    read_coding_quadtree<pixel_t,ChromaArrayType>(tctx,x0,y0, log2CbSize-1, ctDepth+1);
 
     if (x1<sps.pic_width_in_luma_samples)
-      read_coding_quadtree(tctx,x1,y0, log2CbSize-1, ctDepth+1);
+      read_coding_quadtree<pixel_t,ChromaArrayType>(tctx,x1,y0, log2CbSize-1, ctDepth+1);
 
     if (y1<sps.pic_height_in_luma_samples)
-      read_coding_quadtree(tctx,x0,y1, log2CbSize-1, ctDepth+1);
+      read_coding_quadtree<pixel_t,ChromaArrayType>(tctx,x0,y1, log2CbSize-1, ctDepth+1);
 
     if (x1<sps.pic_width_in_luma_samples &&
         y1<sps.pic_height_in_luma_samples)
-      read_coding_quadtree(tctx,x1,y1, log2CbSize-1, ctDepth+1);
+      read_coding_quadtree<pixel_t,ChromaArrayType>(tctx,x1,y1, log2CbSize-1, ctDepth+1);
   }
   else {
     // set ctDepth of this CU
 
     img->set_ctDepth(x0,y0, log2CbSize, ctDepth);
 
-    read_coding_unit(tctx, x0,y0, log2CbSize, ctDepth);
+    read_coding_unit<pixel_t,ChromaArrayType>(tctx, x0,y0, log2CbSize, ctDepth);
   }
 
   logtrace(LogSlice,"-\n");
@@ -4661,9 +4800,10 @@ enum DecodeResult {
 
 /* Decode CTBs until the end of sub-stream, the end-of-slice, or some error occurs.
  */
-enum DecodeResult decode_substream(thread_context* tctx,
-                                   bool block_wpp, // block on WPP dependencies
-                                   bool first_independent_substream)
+template <class pixel_t, int ChromaArrayType>
+static enum DecodeResult decode_substream_internal(thread_context* tctx,
+                                                   bool block_wpp, // block on WPP dependencies
+                                                   bool first_independent_substream)
 {
   const pic_parameter_set& pps = tctx->img->get_pps();
   const seq_parameter_set& sps = tctx->img->get_sps();
@@ -4682,21 +4822,23 @@ enum DecodeResult decode_substream(thread_context* tctx,
       tctx->CtbY>=1 && tctx->CtbX==0)
     {
       if (sps.PicWidthInCtbsY>1) {
-        if ((tctx->CtbY-1) >= tctx->imgunit->ctx_models.size()) {
+        if ((tctx->CtbY-1) >= (int)tctx->imgunit->ctx_models.size()) {
           return Decode_Error;
         }
 
         //printf("CTX wait on %d/%d\n",1,tctx->CtbY-1);
 
         // we have to wait until the context model data is there
-        tctx->img->wait_for_progress(tctx->task, 1,tctx->CtbY-1,CTB_PROGRESS_PREFILTER);
+        tctx->stage_time[DE265_STAGE_WAIT_FOR_PROGRESS] +=
+          tctx->img->wait_for_progress(tctx->task, 1,tctx->CtbY-1,CTB_PROGRESS_PREFILTER);
 
         // copy CABAC model from previous CTB row
         tctx->ctx_model = tctx->imgunit->ctx_models[(tctx->CtbY-1)];
         tctx->imgunit->ctx_models[(tctx->CtbY-1)].release(); // not used anymore
       }
       else {
-        tctx->img->wait_for_progress(tctx->task, 0,tctx->CtbY-1,CTB_PROGRESS_PREFILTER);
+        tctx->stage_time[DE265_STAGE_WAIT_FOR_PROGRESS] +=
+          tctx->img->wait_for_progress(tctx->task, 0,tctx->CtbY-1,CTB_PROGRESS_PREFILTER);
         initialize_CABAC_models(tctx);
       }
     }
@@ -4706,7 +4848,7 @@ enum DecodeResult decode_substream(thread_context* tctx,
     const int ctbx = tctx->CtbX;
     const int ctby = tctx->CtbY;
 
-    if (ctbx+ctby*ctbW >= pps.CtbAddrRStoTS.size()) {
+    if (ctbx+ctby*ctbW >= (int)pps.CtbAddrRStoTS.size()) {
         return Decode_Error;
     }
 
@@ -4721,7 +4863,8 @@ enum DecodeResult decode_substream(thread_context* tctx,
 
       //printf("wait on %d/%d (%d)\n",ctbx+1,ctby-1, ctbx+1+(ctby-1)*sps->PicWidthInCtbsY);
 
-      tctx->img->wait_for_progress(tctx->task, ctbx+1,ctby-1, CTB_PROGRESS_PREFILTER);
+      tctx->stage_time[DE265_STAGE_WAIT_FOR_PROGRESS] +=
+        tctx->img->wait_for_progress(tctx->task, ctbx+1,ctby-1, CTB_PROGRESS_PREFILTER);
     }
 
     //printf("%p: decode %d;%d\n", tctx, tctx->CtbX,tctx->CtbY);
@@ -4733,7 +4876,7 @@ enum DecodeResult decode_substream(thread_context* tctx,
       return Decode_Error;
     }
 
-    read_coding_tree_unit(tctx);
+    read_coding_tree_unit<pixel_t,ChromaArrayType>(tctx);
 
 
     // save CABAC-model for WPP (except in last CTB row)
@@ -4743,7 +4886,7 @@ enum DecodeResult decode_substream(thread_context* tctx,
         ctby < sps.PicHeightInCtbsY-1)
       {
         // no storage for context table has been allocated
-        if (tctx->imgunit->ctx_models.size() <= ctby) {
+        if ((int)tctx->imgunit->ctx_models.size() <= ctby) {
           return Decode_Error;
         }
 
@@ -4781,6 +4924,10 @@ enum DecodeResult decode_substream(thread_context* tctx,
 
     bool endOfPicture = advanceCtbAddr(tctx); // true if we read past the end of the image
 
+    if ((endOfPicture || tctx->CtbY != lastCtbY) && tctx->decctx->has_row_callback()) {
+      tctx->decctx->report_final_CTB_rows(tctx->imgunit, tctx->img, CTB_PROGRESS_PREFILTER);
+    }
+
     if (endOfPicture &&
         end_of_slice_segment_flag == false)
       {
@@ -4791,6 +4938,10 @@ enum DecodeResult decode_substream(thread_context* tctx,
 
 
     if (end_of_slice_segment_flag) {
+      if (endOfPicture) {
+        tctx->imgunit->end_of_picture_decoded = true;
+      }
+
       /* corrupted inputs may send the end_of_slice_segment_flag even if not all
          CTBs in a row have been coded. Hence, we mark all of them as finished.
        */
@@ -4830,6 +4981,52 @@ enum DecodeResult decode_substream(thread_context* tctx,
 }
 
 
+template <class pixel_t>
+static enum DecodeResult decode_substream_for_sample_type(thread_context* tctx,
+                                                          bool block_wpp,
+                                                          bool first_independent_substream)
+{
+  switch (tctx->img->get_sps().ChromaArrayType) {
+  case CHROMA_MONO:
+    return decode_substream_internal<pixel_t,CHROMA_MONO>(tctx, block_wpp,
+                                                          first_independent_substream);
+  case CHROMA_420:
+    return decode_substream_internal<pixel_t,CHROMA_420>(tctx, block_wpp,
+                                                         first_independent_substream);
+  case CHROMA_422:
+    return decode_substream_internal<pixel_t,CHROMA_422>(tctx, block_wpp,
+                                                         first_independent_substream);
+  default:
+    return decode_substream_internal<pixel_t,CHROMA_444>(tctx, block_wpp,
+                                                         first_independent_substream);
+  }
+}
+
+
+enum DecodeResult decode_substream(thread_context* tctx,
+                                   bool block_wpp, // block on WPP dependencies
+                                   bool first_independent_substream)
+{
+  const de265_image* img = tctx->img;
+
+  bool high_luma   = img->high_bit_depth(0);
+  bool high_chroma = (img->get_sps().ChromaArrayType == CHROMA_MONO ?
+                      high_luma : img->high_bit_depth(1));
+
+  if (high_luma != high_chroma) {
+    return decode_substream_for_sample_type<void>(tctx, block_wpp, first_independent_substream);
+  }
+  else if (high_luma) {
+    return decode_substream_for_sample_type<uint16_t>(tctx, block_wpp,
+                                                      first_independent_substream);
+  }
+  else {
+    return decode_substream_for_sample_type<uint8_t>(tctx, block_wpp,
+                                                     first_independent_substream);
+  }
+}
+
+
 
 bool initialize_CABAC_at_slice_segment_start(thread_context* tctx)
 {
@@ -4904,6 +5101,23 @@ std::string thread_task_slice_segment::name() const {
 }
 
 
+/* Mark the CTBs of the tile from the current position to the end of the tile as decoded,
+   so that the filters of the surrounding CTB rows do not wait for them.
+ */
+static void mark_remaining_CTBs_in_tile(thread_context* tctx, int tileID)
+{
+  de265_image* img = tctx->img;
+  const pic_parameter_set& pps = img->get_pps();
+  const int nCtbs = img->get_sps().PicSizeInCtbsY;
+
+  for (int ctbAddrTS = tctx->CtbAddrInTS;
+       ctbAddrTS < nCtbs && pps.TileId[ctbAddrTS] == tileID;
+       ctbAddrTS++) {
+    img->ctb_progress[pps.CtbAddrTStoRS[ctbAddrTS]].set_progress(CTB_PROGRESS_PREFILTER);
+  }
+}
+
+
 void thread_task_slice_segment::work()
 {
   thread_task_slice_segment* data = this;
@@ -4917,9 +5131,19 @@ void thread_task_slice_segment::work()
 
   //printf("%p: A start decoding at %d/%d\n", tctx, tctx->CtbX,tctx->CtbY);
 
+  const pic_parameter_set& pps = img->get_pps();
+  int myTileID = pps.TileId[tctx->CtbAddrInTS];
+
+  // A slice segment with several entry points consists of complete tiles.
+  bool completeTile = (tctx->shdr->num_entry_point_offsets > 0);
+
   if (data->firstSliceSubstream) {
     bool success = initialize_CABAC_at_slice_segment_start(tctx);
     if (!success) {
+      if (completeTile) {
+        mark_remaining_CTBs_in_tile(tctx, myTileID);
+      }
+
       state = Finished;
       tctx->sliceunit->finished_threads.increase_progress(1);
       img->thread_finishes(this);
@@ -4932,7 +5156,15 @@ void thread_task_slice_segment::work()
 
   init_CABAC_decoder_2(&tctx->cabac_decoder);
 
+  begin_slice_data_timing(tctx);
   /*enum DecodeResult result =*/ decode_substream(tctx, false, data->firstSliceSubstream);
+  end_slice_data_timing(tctx);
+
+  // mark progress on remaining CTBs in tile (in case of decoder error and early termination)
+
+  if (completeTile) {
+    mark_remaining_CTBs_in_tile(tctx, myTileID);
+  }
 
   state = Finished;
   tctx->sliceunit->finished_threads.increase_progress(1);
@@ -4982,8 +5214,10 @@ void thread_task_ctb_row::work()
   bool firstIndependentSubstream =
     data->firstSliceSubstream && !tctx->shdr->dependent_slice_segment_flag;
 
+  begin_slice_data_timing(tctx);
   /*enum DecodeResult result =*/
   decode_substream(tctx, true, firstIndependentSubstream);
+  end_slice_data_timing(tctx);
 
   // mark progress on remaining CTBs in row (in case of decoder error and early termination)
 
@@ -5006,6 +5240,49 @@ void thread_task_ctb_row::work()
 }
 
 
+/* Skip the remainder of the current tile (outside of the region of interest) and
+   continue with the next substream. Returns false if the slice segment ends in this tile.
+ */
+static bool skip_tile_substream(thread_context* tctx, int substream)
+{
+  const pic_parameter_set& pps = tctx->img->get_pps();
+  const seq_parameter_set& sps = tctx->img->get_sps();
+  slice_segment_header* shdr = tctx->shdr;
+
+  int tileId = pps.TileId[tctx->CtbAddrInTS];
+  int ctbAddrTS = tctx->CtbAddrInTS;
+  while (ctbAddrTS < sps.PicSizeInCtbsY && pps.TileId[ctbAddrTS] == tileId) {
+    ctbAddrTS++;
+  }
+
+  if (substream >= shdr->num_entry_point_offsets) {
+    // Slice segments spanning several tiles contain complete tiles.
+    if (shdr->num_entry_point_offsets > 0 && ctbAddrTS == sps.PicSizeInCtbsY) {
+      tctx->imgunit->end_of_picture_decoded = true;
+    }
+
+    return false;
+  }
+
+  if (substream >= (int)shdr->entry_point_offset.size() ||
+      ctbAddrTS >= sps.PicSizeInCtbsY ||
+      shdr->entry_point_offset[substream] >=
+      tctx->cabac_decoder.bitstream_end - tctx->cabac_decoder.bitstream_start) {
+    tctx->decctx->add_warning(DE265_WARNING_INCORRECT_ENTRY_POINT_OFFSET, true);
+    return false;
+  }
+
+  tctx->cabac_decoder.bitstream_curr =
+    tctx->cabac_decoder.bitstream_start + shdr->entry_point_offset[substream];
+  init_CABAC_decoder_2(&tctx->cabac_decoder);
+
+  tctx->CtbAddrInTS = ctbAddrTS;
+  setCtbAddrFromTS(tctx);
+
+  return true;
+}
+
+
 de265_error read_slice_segment_data(thread_context* tctx)
 {
   setCtbAddrFromTS(tctx);
@@ -5015,18 +5292,35 @@ de265_error read_slice_segment_data(thread_context* tctx)
   const seq_parameter_set& sps = img->get_sps();
   slice_segment_header* shdr = tctx->shdr;
 
-  bool success = initialize_CABAC_at_slice_segment_start(tctx);
-  if (!success) {
-    return DE265_ERROR_UNSPECIFIED_DECODING_ERROR;
-  }
+  bool first_slice_substream = !shdr->dependent_slice_segment_flag;
 
-  init_CABAC_decoder_2(&tctx->cabac_decoder);
+  int substream=0;
 
-  //printf("-----\n");
+  // skip leading tiles outside of the region of interest
 
-  bool first_slice_substream = !shdr->dependent_slice_segment_flag;
+  if (pps.tiles_enabled_flag &&
+      !tctx->imgunit->is_tile_decoded(pps.TileId[tctx->CtbAddrInTS])) {
+    do {
+      if (!skip_tile_substream(tctx, substream)) {
+        return DE265_OK;
+      }
 
-  int substream=0;
+      substream++;
+    } while (!tctx->imgunit->is_tile_decoded(pps.TileId[tctx->CtbAddrInTS]));
+
+    initialize_CABAC_models(tctx);
+    first_slice_substream = false;
+  }
+  else {
+    bool success = initialize_CABAC_at_slice_segment_start(tctx);
+    if (!success) {
+      return DE265_ERROR_UNSPECIFIED_DECODING_ERROR;
+    }
+
+    init_CABAC_decoder_2(&tctx->cabac_decoder);
+  }
+
+  //printf("-----\n");
 
   enum DecodeResult result;
   do {
@@ -5057,6 +5351,16 @@ de265_error read_slice_segment_data(thread_context* tctx)
     first_slice_substream = false;
 
     if (pps.tiles_enabled_flag) {
+      // skip following tiles outside of the region of interest
+
+      while (!tctx->imgunit->is_tile_decoded(pps.TileId[tctx->CtbAddrInTS])) {
+        if (!skip_tile_substream(tctx, substream)) {
+          return DE265_OK;
+        }
+
+        substream++;
+      }
+
       initialize_CABAC_models(tctx);
     }
   } while (true);
@@ -280,6 +280,11 @@ typedef struct {
 
 de265_error read_slice_segment_data(thread_context* tctx);
 
+/* Measure the time of slice data decoding in 'tctx' and add it to the picture
+   (only if DE265_DECODER_PARAM_STAGE_TIMING is set). */
+void begin_slice_data_timing(thread_context* tctx);
+void end_slice_data_timing(thread_context* tctx);
+
 bool alloc_and_init_significant_coeff_ctxIdx_lookupTable();
 void free_significant_coeff_ctxIdx_lookupTable();
 
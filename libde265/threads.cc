@@ -19,6 +19,7 @@
  */
 
 #include "threads.h"
+#include "util.h"
 #include <assert.h>
 #include <string.h>
 
@@ -184,6 +185,202 @@ void printblks(const thread_pool* pool)
 #endif
 
 
+thread_trace::thread_trace()
+{
+  for (int i=0;i<MAX_THREADS;i++) {
+    num_dropped_events[i] = 0;
+  }
+
+  de265_mutex_init(&mutex);
+}
+
+
+thread_trace::~thread_trace()
+{
+  de265_mutex_destroy(&mutex);
+}
+
+
+void thread_trace::add(int worker, const event& e)
+{
+  if (worker<0 || worker>=MAX_THREADS) {
+    return;
+  }
+
+  de265_mutex_lock(&mutex);
+
+  if (events[worker].size() >= max_events_per_worker) {
+    num_dropped_events[worker]++;
+  }
+  else {
+    events[worker].push_back(e);
+  }
+
+  de265_mutex_unlock(&mutex);
+}
+
+
+void thread_trace::add_task(int worker, const std::string& name, int64_t start, int64_t end)
+{
+  event e;
+  e.type = Task;
+  e.start = start;
+  e.end = end;
+  e.name = name;
+  e.ctbx = e.ctby = e.progress = 0;
+
+  add(worker, e);
+}
+
+
+void thread_trace::add_blocked(int worker, int64_t start, int64_t end,
+                               int ctbx,int ctby, int progress)
+{
+  event e;
+  e.type = Blocked;
+  e.start = start;
+  e.end = end;
+  e.ctbx = ctbx;
+  e.ctby = ctby;
+  e.progress = progress;
+
+  add(worker, e);
+}
+
+
+void thread_trace::add_idle(int worker, int64_t start, int64_t end)
+{
+  event e;
+  e.type = Idle;
+  e.start = start;
+  e.end = end;
+  e.ctbx = e.ctby = e.progress = 0;
+
+  add(worker, e);
+}
+
+
+void thread_trace::clear()
+{
+  de265_mutex_lock(&mutex);
+  clear_unlocked();
+  de265_mutex_unlock(&mutex);
+}
+
+
+void thread_trace::clear_unlocked()
+{
+  for (int i=0;i<MAX_THREADS;i++) {
+    events[i].clear();
+    num_dropped_events[i] = 0;
+  }
+}
+
+
+bool thread_trace::write_chrome_trace(FILE* fh, bool clear_events)
+{
+  de265_mutex_lock(&mutex);
+
+  bool success = write_chrome_trace_unlocked(fh);
+  if (clear_events) {
+    clear_unlocked();
+  }
+
+  de265_mutex_unlock(&mutex);
+
+  return success;
+}
+
+
+bool thread_trace::write_chrome_trace_unlocked(FILE* fh) const
+{
+  // all times relative to the first event
+
+  int64_t timeBase = 0;
+  bool first = true;
+
+  for (int w=0;w<MAX_THREADS;w++) {
+    if (!events[w].empty() && (first || events[w][0].start < timeBase)) {
+      timeBase = events[w][0].start;
+      first = false;
+    }
+  }
+
+  fprintf(fh,"{\"traceEvents\":[\n");
+
+  const char* separator = "";
+
+  for (int w=0;w<MAX_THREADS;w++) {
+    if (events[w].empty()) {
+      continue;
+    }
+
+    fprintf(fh,"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"worker %d\"}}", separator, w,w);
+    separator = ",\n";
+
+    for (size_t i=0;i<events[w].size();i++) {
+      const event& e = events[w][i];
+
+      double ts  = (e.start - timeBase) / 1000.0;
+      double dur = (e.end - e.start) / 1000.0;
+
+      switch (e.type) {
+      case Task:
+        fprintf(fh,",\n{\"name\":\"%s\",\"cat\":\"task\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                e.name.c_str(), ts,dur, w);
+        break;
+
+      case Blocked:
+        fprintf(fh,",\n{\"name\":\"wait %d;%d\",\"cat\":\"blocked\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"ctb_x\":%d,\"ctb_y\":%d,\"progress\":%d}}",
+                e.ctbx,e.ctby, ts,dur, w, e.ctbx,e.ctby,e.progress);
+        break;
+
+      case Idle:
+        fprintf(fh,",\n{\"name\":\"idle\",\"cat\":\"idle\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                ts,dur, w);
+        break;
+      }
+    }
+  }
+
+  fprintf(fh,"\n],\n\"displayTimeUnit\":\"ns\",\n\"otherData\":{");
+
+
+  // summary per worker
+
+  separator = "";
+
+  for (int w=0;w<MAX_THREADS;w++) {
+    if (events[w].empty()) {
+      continue;
+    }
+
+    int64_t sum[3] = { 0,0,0 };
+    for (size_t i=0;i<events[w].size();i++) {
+      sum[ events[w][i].type ] += events[w][i].end - events[w][i].start;
+    }
+
+    fprintf(fh,"%s\n\"worker %d\":\"tasks %.3f ms (blocked %.3f ms), idle %.3f ms",
+            separator, w, sum[Task]/1000000.0, sum[Blocked]/1000000.0, sum[Idle]/1000000.0);
+    if (num_dropped_events[w]) {
+      fprintf(fh,", %d events dropped", num_dropped_events[w]);
+    }
+    fprintf(fh,"\"");
+
+    separator = ",";
+  }
+
+  fprintf(fh,"\n}}\n");
+
+  return !ferror(fh);
+}
+
+
 static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
 {
   thread_pool* pool = (thread_pool*)pool_ptr;
@@ -191,6 +388,9 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
 
   de265_mutex_lock(&pool->mutex);
 
+  const int worker = pool->next_worker_id++;
+  int64_t idleStart = 0; // 0: not tracing
+
   while(true) {
 
     // wait until we can pick a task or until the pool has been stopped
@@ -202,6 +402,10 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
         break;
       }
 
+      if (pool->trace && idleStart==0) {
+        idleStart = monotonic_time_ns();
+      }
+
       //printf("going idle\n");
       de265_cond_wait(&pool->cond_var, &pool->mutex);
     }
@@ -221,6 +425,9 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
 
     pool->num_threads_working++;
 
+    task->worker = worker;
+    task->trace  = pool->trace;
+
     //printblks(pool);
 
     de265_mutex_unlock(&pool->mutex);
@@ -228,7 +435,27 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
 
     // execute the task
 
-    task->work();
+    thread_trace* trace = task->trace;
+
+    if (trace) {
+      // the task may be deleted when it is finished, so get its name before
+
+      std::string name = task->name();
+
+      int64_t start = monotonic_time_ns();
+      if (idleStart) {
+        trace->add_idle(worker, idleStart, start);
+      }
+
+      task->work();
+
+      idleStart = monotonic_time_ns();
+      trace->add_task(worker, name, start, idleStart);
+    }
+    else {
+      idleStart = 0;
+      task->work();
+    }
 
     // end processing and check if this was the last task to be processed
 
@@ -254,6 +481,7 @@ de265_error start_thread_pool(thread_pool* pool, int num_threads)
   }
 
   pool->num_threads = 0; // will be increased below
+  pool->next_worker_id = 0;
 
   de265_mutex_init(&pool->mutex);
   de265_cond_init(&pool->cond_var);
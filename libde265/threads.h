@@ -33,7 +33,9 @@
 
 #include <deque>
 #include <string>
+#include <vector>
 #include <atomic>
+#include <stdio.h>
 
 #ifndef _WIN32
 #include <pthread.h>
@@ -98,14 +100,19 @@ private:
 
 
 
+class thread_trace;
+
 class thread_task
 {
 public:
-  thread_task() : state(Queued) { }
+  thread_task() : state(Queued), worker(-1), trace(NULL) { }
   virtual ~thread_task() { }
 
   enum { Queued, Running, Blocked, Finished } state;
 
+  int worker;          // index of the executing worker thread
+  thread_trace* trace; // set by the worker thread while tracing, NULL otherwise
+
   virtual void work() = 0;
 
   virtual std::string name() const { return "noname"; }
@@ -114,6 +121,52 @@ public:
 
 #define MAX_THREADS 32
 
+
+/* Records the activity of the worker threads: the executed tasks, the times a task
+   was blocked in wait_for_progress() and the idle times. It can be written as a
+   Chrome trace-event file (chrome://tracing, ui.perfetto.dev).
+   Each worker appends to its own event list. Adding, clearing and writing are
+   serialized by a mutex, because workers may still add events (e.g. of background
+   tasks) while the application writes the trace.
+ */
+class thread_trace
+{
+ public:
+  thread_trace();
+  ~thread_trace();
+
+  void add_task(int worker, const std::string& name, int64_t start, int64_t end);
+  void add_blocked(int worker, int64_t start, int64_t end, int ctbx,int ctby, int progress);
+  void add_idle(int worker, int64_t start, int64_t end);
+
+  void clear();
+
+  // Write the trace. When 'clear_events' is set, the written events are removed
+  // without losing events that are added concurrently.
+  bool write_chrome_trace(FILE* fh, bool clear_events);
+
+ private:
+  enum event_type { Task, Blocked, Idle };
+
+  struct event {
+    enum event_type type;
+    int64_t start, end;        // ns, monotonic clock
+    std::string name;          // Task
+    int ctbx, ctby, progress;  // Blocked
+  };
+
+  static const int max_events_per_worker = 1000000;
+
+  std::vector<event> events[MAX_THREADS];
+  int num_dropped_events[MAX_THREADS];
+
+  de265_mutex mutex;
+
+  void add(int worker, const event& e);
+  void clear_unlocked();
+  bool write_chrome_trace_unlocked(FILE* fh) const;
+};
+
 /* TODO NOTE: When unblocking a task, we have to check first
    if there are threads waiting because of the run-count limit.
    If there are higher-priority tasks, those should be run instead
@@ -123,6 +176,8 @@ public:
 class thread_pool
 {
  public:
+  thread_pool() : trace(NULL) { }
+
   bool stopped;
 
   std::deque<thread_task*> tasks;  // we are not the owner
@@ -135,6 +190,10 @@ class thread_pool
   int ctbx[MAX_THREADS]; // the CTB the thread is working on
   int ctby[MAX_THREADS];
 
+  int next_worker_id;
+
+  thread_trace* trace; // NULL: tracing disabled (only change while holding the mutex)
+
   de265_mutex  mutex;
   de265_cond   cond_var;
 };
@@ -312,17 +312,18 @@ void transform_coefficients_explicit(thread_context* tctx,
 }
 
 
+template <class pixel_t>
 void inv_transform(acceleration_functions* acceleration,
-                   uint8_t* dst, int dstStride, int16_t* coeff,
-                   int log2TbSize, int trType)
+                   pixel_t* dst, int dstStride, int16_t* coeff,
+                   int log2TbSize, int trType, int bit_depth)
 {
   if (trType==1) {
     assert(log2TbSize==2);
 
-    acceleration->transform_4x4_dst_add_8(dst, coeff, dstStride);
+    acceleration->transform_4x4_dst_add<pixel_t>(dst, coeff, dstStride, bit_depth);
 
   } else {
-    acceleration->transform_add_8[log2TbSize-2](dst,coeff,dstStride);
+    acceleration->transform_add<pixel_t>(log2TbSize-2, dst,coeff,dstStride, bit_depth);
   }
 
 
@@ -336,21 +337,38 @@ void inv_transform(acceleration_functions* acceleration,
 #endif
 }
 
+template void inv_transform<uint8_t>(acceleration_functions* acceleration,
+                                     uint8_t* dst, int dstStride, int16_t* coeff,
+                                     int log2TbSize, int trType, int bit_depth);
+template void inv_transform<uint16_t>(acceleration_functions* acceleration,
+                                      uint16_t* dst, int dstStride, int16_t* coeff,
+                                      int log2TbSize, int trType, int bit_depth);
+
 
 void fwd_transform(acceleration_functions* acceleration,
                    int16_t* coeff, int coeffStride, int log2TbSize, int trType,
-                   const int16_t* src, int srcStride)
+                   const int16_t* src, int srcStride, int bit_depth)
 {
   logtrace(LogTransform,"transform --- trType: %d nT: %d\n",trType,1<<log2TbSize);
 
   if (trType==1) {
     // DST 4x4
 
-    acceleration->fwd_transform_4x4_dst_8(coeff, src, srcStride);
+    if (bit_depth==8) {
+      acceleration->fwd_transform_4x4_dst_8(coeff, src, srcStride);
+    }
+    else {
+      acceleration->fwd_transform_4x4_dst_16(coeff, src, srcStride, bit_depth);
+    }
   } else {
     // DCT 4x4, 8x8, 16x16, 32x32
 
-    acceleration->fwd_transform_8[log2TbSize-2](coeff,src,srcStride);
+    if (bit_depth==8) {
+      acceleration->fwd_transform_8[log2TbSize-2](coeff,src,srcStride);
+    }
+    else {
+      acceleration->fwd_transform_16[log2TbSize-2](coeff,src,srcStride, bit_depth);
+    }
   }
 }
 
@@ -653,6 +671,18 @@ void scale_coefficients(thread_context* tctx,
 }
 
 
+template void scale_coefficients_internal<uint8_t>(thread_context* tctx,
+                                                   int xT,int yT, int x0,int y0,
+                                                   int nT, int cIdx,
+                                                   bool transform_skip_flag, bool intra,
+                                                   int rdpcmMode);
+template void scale_coefficients_internal<uint16_t>(thread_context* tctx,
+                                                    int xT,int yT, int x0,int y0,
+                                                    int nT, int cIdx,
+                                                    bool transform_skip_flag, bool intra,
+                                                    int rdpcmMode);
+
+
 //#define QUANT_IQUANT_SHIFT    20 // Q(QP%6) * IQ(QP%6) = 2^20
 #define QUANT_SHIFT           14 // Q(4) = 2^14
 //#define SCALE_BITS            15 // Inherited from TMuC, pressumably for fractional bit estimates in RDOQ
@@ -663,11 +693,37 @@ const static uint16_t g_quantScales[6] = {
   26214,23302,20560,18396,16384,14564
 };
 
+int get_component_qp_prime(const seq_parameter_set& sps, const pic_parameter_set& pps,
+                           int QPY, int cIdx)
+{
+  if (cIdx==0) {
+    return QPY + sps.QpBdOffset_Y;
+  }
+
+  int qPi = Clip3(-sps.QpBdOffset_C,57, QPY + (cIdx==1 ? pps.pic_cb_qp_offset : pps.pic_cr_qp_offset));
+
+  int qPC;
+  if (sps.ChromaArrayType == CHROMA_420) {
+    qPC = table8_22(qPi);
+  }
+  else {
+    qPC = qPi;
+  }
+
+  int qPCPrime = qPC + sps.QpBdOffset_C;
+  if (qPCPrime<0) {
+    qPCPrime = 0;
+  }
+
+  return qPCPrime;
+}
+
+
 void quant_coefficients(//encoder_context* ectx,
                         int16_t* out_coeff,
                         const int16_t* in_coeff,
                         int log2TrSize, int qp,
-                        bool intra)
+                        bool intra, int bitDepth)
 {
   const int qpDiv6 = qp / 6;
   const int qpMod6 = qp % 6;
@@ -675,7 +731,6 @@ void quant_coefficients(//encoder_context* ectx,
   //int uiLog2TrSize = xLog2( iWidth - 1);
 
   int uiQ = g_quantScales[qpMod6];
-  int bitDepth = 8;
   int transformShift = MAX_TR_DYNAMIC_RANGE - bitDepth - log2TrSize;  // Represents scaling through forward transform
   int qBits = QUANT_SHIFT + qpDiv6 + transformShift;
 
@@ -709,10 +764,9 @@ void quant_coefficients(//encoder_context* ectx,
 
 void dequant_coefficients(int16_t* out_coeff,
                           const int16_t* in_coeff,
-                          int log2TrSize, int qP)
+                          int log2TrSize, int qP, int bitDepth)
 {
   const int m_x_y = 1;
-  int bitDepth = 8;
   int bdShift = bitDepth + log2TrSize - 5;
   bdShift -= 4;  // this is equivalent to having a m_x_y of 16 and we can use 32bit integers
 
@@ -44,22 +44,36 @@ void scale_coefficients(thread_context* tctx,
                         int nT, int cIdx,
                         bool transform_skip_flag, bool intra, int rdpcmMode);
 
+// for callers that know the sample type of the component (instantiated for uint8_t/uint16_t)
+template <class pixel_t>
+void scale_coefficients_internal(thread_context* tctx,
+                                 int xT,int yT, int x0,int y0,
+                                 int nT, int cIdx,
+                                 bool transform_skip_flag, bool intra, int rdpcmMode);
 
+
+// (instantiated for uint8_t/uint16_t)
+template <class pixel_t>
 void inv_transform(acceleration_functions* acceleration,
-                   uint8_t* dst, int dstStride, int16_t* coeff,
-                   int log2TbSize, int trType);
+                   pixel_t* dst, int dstStride, int16_t* coeff,
+                   int log2TbSize, int trType, int bit_depth);
 
 void fwd_transform(acceleration_functions* acceleration,
                    int16_t* coeff, int coeffStride, int log2TbSize, int trType,
-                   const int16_t* src, int srcStride);
+                   const int16_t* src, int srcStride, int bit_depth);
+
+// (8.6.1) qP' of colour component cIdx in a CU with luma QP 'QPY' (for the encoder,
+// which uses no slice or CU chroma QP offsets)
+int get_component_qp_prime(const seq_parameter_set& sps, const pic_parameter_set& pps,
+                           int QPY, int cIdx);
 
 void quant_coefficients(int16_t* out_coeff,
                         const int16_t* in_coeff,
                         int log2TrSize, int qp,
-                        bool intra);
+                        bool intra, int bitDepth);
 
 void dequant_coefficients(int16_t* out_coeff,
                           const int16_t* in_coeff,
-                          int log2TrSize, int qP);
+                          int log2TrSize, int qP, int bitDepth);
 
 #endif
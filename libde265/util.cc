@@ -24,6 +24,20 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <chrono>
+
+
+int64_t monotonic_time_us()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>
+    (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t monotonic_time_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>
+    (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 
 void copy_subimage(uint8_t* dst,int dststride,
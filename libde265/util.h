@@ -64,6 +64,32 @@
 #define ALIGNED_8( var )  LIBDE265_DECLARE_ALIGNED( var, 8 )
 #define ALIGNED_4( var )  LIBDE265_DECLARE_ALIGNED( var, 4 )
 
+// Allocation of memory blocks with a given base address alignment.
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#include <stdlib.h>
+
+#ifdef HAVE___MINGW_ALIGNED_MALLOC
+#define ALLOC_ALIGNED(alignment, size)         __mingw_aligned_malloc((size), (alignment))
+#define FREE_ALIGNED(mem)                      __mingw_aligned_free((mem))
+#elif _WIN32
+#define ALLOC_ALIGNED(alignment, size)         _aligned_malloc((size), (alignment))
+#define FREE_ALIGNED(mem)                      _aligned_free((mem))
+#elif defined(HAVE_POSIX_MEMALIGN)
+static inline void *ALLOC_ALIGNED(size_t alignment, size_t size) {
+    void *mem = NULL;
+    if (posix_memalign(&mem, alignment, size) != 0) {
+        return NULL;
+    }
+    return mem;
+};
+#define FREE_ALIGNED(mem)                      free((mem))
+#else
+#define ALLOC_ALIGNED(alignment, size)      memalign((alignment), (size))
+#define FREE_ALIGNED(mem)                   free((mem))
+#endif
+
 // C++11 specific features
 #if defined(_MSC_VER) || (!__clang__ && __GNUC__ && GCC_VERSION < 40600)
 #define FOR_LOOP(type, var, list)   for each (type var in list)
@@ -152,6 +178,10 @@ void copy_subimage(uint8_t* dst,int dststride,
                    const uint8_t* src,int srcstride,
                    int w, int h);
 
+// monotonic clock for measuring durations
+int64_t monotonic_time_us();
+int64_t monotonic_time_ns();
+
 
 // === logging ===
 
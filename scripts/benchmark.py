@@ -0,0 +1,489 @@
+#!/usr/bin/python
+"""
+H.265 video codec.
+Copyright (c) 2014 struktur AG, Dirk Farin <farin@struktur.de>
+
+This file is part of libde265.
+
+libde265 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+libde265 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+"""
+
+# End-to-end decoding benchmark.
+#
+# A corpus of synthetic streams is generated with enc265 at several resolutions:
+# intra-only streams, and streams with WPP, tiles, multiple slices, 10 bit and
+# low-delay P pictures (see CORPUS_CONFIGS). The input pictures are generated
+# from a fixed random seed, so the same encoder always produces the same streams.
+# Corpus streams that enc265 fails to encode within --encoder-timeout seconds are
+# skipped with a warning.
+#
+# The streams in benchmark-streams/ are decoded as well. They are generated in
+# the same way (see --generate-default-streams and the README there), but kept
+# in the repository, so that they stay the same when the encoder changes. More
+# streams can be added with --streams.
+#
+# Each stream is decoded with dec265 at each thread count. The best of several
+# runs is reported as fps, the speedup relative to the first thread count and
+# the peak memory (resident set size) of the decoder process. The peak memory
+# is taken from /proc in an additional run and is not available on all systems.
+#
+# The results are written as JSON (or CSV). When a previous result file is
+# given with --compare, streams that became slower than the tolerance are listed
+# and the exit code is 1.
+
+from __future__ import print_function, division
+
+import glob
+import json
+import optparse
+import os
+import platform
+import random
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+try:
+    import multiprocessing
+    CPU_COUNT = multiprocessing.cpu_count()
+except (ImportError, NotImplementedError):
+    CPU_COUNT = 1
+
+RESULT_FORMAT_VERSION = 1
+
+STREAMS_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'benchmark-streams')
+
+DEFAULT_RESOLUTIONS = '416x240,832x480,1280x720'
+DEFAULT_FRAMES = 16
+DEFAULT_QP = 27
+DEFAULT_ENCODER_TIMEOUT = 300
+
+# enc265 options for all corpus streams (the fastest encoder decisions)
+ENCODER_OPTIONS = ['--TB-IntraPredMode', 'min-residual',
+                   '--CB-IntraPartMode', 'fixed',
+                   '--TB-RateEstimation', 'none',
+                   '--min-cb-size', '16',
+                   '--max-transform-hierarchy-depth-intra', '1']
+
+# enc265 options of the streams that use the in-loop filters
+LOOP_FILTER_OPTIONS = ['--deblocking', '--sao']
+
+# name, bit depth, extra enc265 options
+CORPUS_CONFIGS = [
+    ('intra', 8, ['--sop-structure', 'intra']),
+    ('wpp', 8, ['--sop-structure', 'intra', '--wpp'] + LOOP_FILTER_OPTIONS),
+    ('tiles4x2', 8, ['--sop-structure', 'intra',
+                     '--tile-columns', '4', '--tile-rows', '2'] + LOOP_FILTER_OPTIONS),
+    ('slices_wpp', 8, ['--sop-structure', 'intra', '--wpp',
+                       '--slice-ctb-rows', '3'] + LOOP_FILTER_OPTIONS),
+    ('wpp_main10', 10, ['--sop-structure', 'intra', '--wpp'] + LOOP_FILTER_OPTIONS),
+    ('ldp_wpp', 8, ['--sop-structure', 'low-delay', '--MEMode', 'search',
+                    '--wpp'] + LOOP_FILTER_OPTIONS),
+]
+
+# the streams in benchmark-streams/ (written by --generate-default-streams)
+DEFAULT_STREAM_CONFIGS = CORPUS_CONFIGS[1:]
+DEFAULT_STREAM_RESOLUTIONS = '416x240,832x480'
+DEFAULT_STREAM_FRAMES = 8
+DEFAULT_STREAM_QP = 32
+
+# motion of the synthetic content per frame (luma samples)
+MOTION_X = 3
+MOTION_Y = 1
+
+
+def default_thread_counts():
+    counts = [0, 1]
+    n = 2
+    while n < CPU_COUNT:
+        counts.append(n)
+        n *= 2
+    if CPU_COUNT > 1:
+        counts.append(CPU_COUNT)
+    return counts
+
+
+def write_synthetic_yuv(filename, width, height, frames, seed, bit_depth=8):
+    """Write a 4:2:0 sequence of a blocky random texture moving over a gradient.
+
+    Above 8 bit, the samples are written as 16 bit little endian values and the
+    additional low bits are filled with noise, so that they carry information.
+    """
+    rng = random.Random(seed)
+
+    scale = 4
+    texw = width + MOTION_X * frames
+    texh = height + MOTION_Y * frames
+    basew = texw // scale + 1
+    baseh = texh // scale + 1
+
+    base = [bytearray(rng.getrandbits(6) for x in range(basew)) for y in range(baseh)]
+
+    texture = []
+    for y in range(texh):
+        row = base[y // scale]
+        texture.append(bytearray(row[x // scale] + (x + y) * 128 // (texw + texh) + 32
+                                 for x in range(texw)))
+
+    shift = bit_depth - 8
+
+    def samples(values):
+        if shift == 0:
+            return bytes(values)
+        data = bytearray()
+        for v in values:
+            v = (v << shift) | rng.getrandbits(shift)
+            data.append(v & 0xFF)
+            data.append(v >> 8)
+        return bytes(data)
+
+    chroma = samples(bytearray([128]) * ((width // 2) * (height // 2)))
+
+    with open(filename, 'wb') as f:
+        for t in range(frames):
+            x0 = t * MOTION_X
+            y0 = t * MOTION_Y
+            for y in range(height):
+                f.write(samples(texture[y0 + y][x0:x0 + width]))
+            f.write(chroma)
+            f.write(chroma)
+
+
+def call_with_timeout(cmd, timeout, **kwargs):
+    """Run a command and return its returncode, or None if it was killed after timeout seconds."""
+    p = subprocess.Popen(cmd, **kwargs)
+
+    deadline = time.time() + timeout
+    while p.poll() is None:
+        if time.time() > deadline:
+            p.kill()
+            p.wait()
+            return None
+        time.sleep(0.1)
+
+    return p.returncode
+
+
+def list_streams(path):
+    return sorted(glob.glob(os.path.join(path, '*.bin')) +
+                  glob.glob(os.path.join(path, '*.bit')))
+
+
+def generate_corpus(enc265, corpus_dir, configs, resolutions, frames, qp, timeout,
+                    input_dir=None):
+    """Encode the streams of all configs and resolutions that do not exist yet.
+
+    The synthetic input files are written to input_dir (default: corpus_dir).
+    Returns the list of streams.
+    """
+    if input_dir is None:
+        input_dir = corpus_dir
+
+    for path in (corpus_dir, input_dir):
+        if not os.path.isdir(path):
+            os.makedirs(path)
+
+    streams = []
+    for resolution in resolutions:
+        width, height = [int(v) for v in resolution.split('x')]
+
+        for name, bit_depth, options in configs:
+            filename = os.path.join(corpus_dir, '%s_%dx%d_%df_qp%d.bin' %
+                                    (name, width, height, frames, qp))
+            streams.append(filename)
+
+            if os.path.exists(filename):
+                continue
+
+            print('generating %s' % filename, file=sys.stderr)
+
+            if bit_depth == 8:
+                yuv = os.path.join(input_dir, 'input_%dx%d_%df.yuv' % (width, height, frames))
+            else:
+                yuv = os.path.join(input_dir, 'input_%dx%d_%df_%dbit.yuv' %
+                                   (width, height, frames, bit_depth))
+            if not os.path.exists(yuv):
+                write_synthetic_yuv(yuv, width, height, frames, seed=width * height,
+                                    bit_depth=bit_depth)
+
+            cmd = [enc265, '-i', yuv, '-o', filename + '.tmp',
+                   '-w', str(width), '-h', str(height), '-f', str(frames),
+                   '--bit-depth', str(bit_depth),
+                   '-q', str(qp)] + ENCODER_OPTIONS + options
+            with open(os.devnull, 'wb') as devnull:
+                ret = call_with_timeout(cmd, timeout, stdout=devnull, stderr=devnull)
+            if ret != 0:
+                if ret is None:
+                    print('WARNING: %s did not finish within %d seconds, skipping stream' %
+                          (' '.join(cmd), timeout), file=sys.stderr)
+                else:
+                    print('WARNING: %s failed with returncode %d, skipping stream' %
+                          (' '.join(cmd), ret), file=sys.stderr)
+                streams.pop()
+                if os.path.exists(filename + '.tmp'):
+                    os.remove(filename + '.tmp')
+                continue
+
+            os.rename(filename + '.tmp', filename)
+
+    return streams
+
+
+def run_decoder(dec265, filename, threads):
+    """Decode a stream once. Returns (seconds, frames, width, height)."""
+    cmd = [dec265, '-q', '-t', str(threads), filename]
+
+    with tempfile.TemporaryFile() as out:
+        start = time.time()
+        ret = subprocess.call(cmd, stdout=out, stderr=subprocess.STDOUT)
+        seconds = time.time() - start
+
+        out.seek(0)
+        output = out.read().decode('utf-8', 'replace')
+
+    if ret != 0:
+        print('ERROR: %s failed with returncode %d (%r)' % (filename, ret, output),
+              file=sys.stderr)
+        return None
+
+    m = re.search(r'nFrames decoded: (\d+) \((\d+)x(\d+)', output)
+    if m is None:
+        print('ERROR: %s: cannot parse decoder output (%r)' % (filename, output),
+              file=sys.stderr)
+        return None
+
+    return (seconds, int(m.group(1)), int(m.group(2)), int(m.group(3)))
+
+
+def read_peak_rss_kb(pid):
+    try:
+        with open('/proc/%d/status' % pid) as f:
+            for line in f:
+                if line.startswith('VmHWM:'):
+                    return int(line.split()[1])
+    except (IOError, OSError, ValueError):
+        pass
+    return None
+
+
+def measure_peak_memory(dec265, filename, threads):
+    """Decode a stream once and return the peak resident set size in kB (or None).
+
+    This is a separate run, because polling the process disturbs the timing.
+    The ru_maxrss of the child cannot be used on Linux, as it includes the
+    memory of this (forking) process.
+    """
+    cmd = [dec265, '-q', '-t', str(threads), filename]
+
+    with open(os.devnull, 'wb') as devnull:
+        p = subprocess.Popen(cmd, stdout=devnull, stderr=devnull)
+
+        peak = None
+        while p.poll() is None:
+            rss = read_peak_rss_kb(p.pid)
+            if rss is not None:
+                peak = rss
+            time.sleep(0.002)
+
+    return peak
+
+
+def benchmark_stream(dec265, filename, thread_counts, repeat):
+    result = {'name': os.path.basename(filename), 'file': filename, 'results': []}
+
+    for threads in thread_counts:
+        runs = [run_decoder(dec265, filename, threads) for i in range(repeat)]
+        if None in runs:
+            return None
+
+        seconds = min(run[0] for run in runs)
+        frames, width, height = runs[0][1:4]
+        peak_rss_kb = measure_peak_memory(dec265, filename, threads)
+
+        result['frames'] = frames
+        result['width'] = width
+        result['height'] = height
+
+        entry = {
+            'threads': threads,
+            'seconds': round(seconds, 4),
+            'fps': round(frames / seconds, 2) if seconds > 0 else 0,
+            'peak_rss_kb': peak_rss_kb,
+        }
+
+        first = result['results'][0] if result['results'] else entry
+        entry['speedup'] = round(first['seconds'] / seconds, 3) if seconds > 0 else 0
+
+        result['results'].append(entry)
+
+        print('%-40s threads %2d: %8.2f fps  speedup %5.2f  peak %s kB' %
+              (result['name'], threads, entry['fps'], entry['speedup'],
+               entry['peak_rss_kb']), file=sys.stderr)
+
+    return result
+
+
+def write_csv(report, f):
+    f.write('stream,width,height,frames,threads,seconds,fps,speedup,peak_rss_kb\n')
+    for stream in report['streams']:
+        for r in stream['results']:
+            f.write('%s,%d,%d,%d,%d,%.4f,%.2f,%.3f,%s\n' %
+                    (stream['name'], stream['width'], stream['height'], stream['frames'],
+                     r['threads'], r['seconds'], r['fps'], r['speedup'],
+                     r['peak_rss_kb'] if r['peak_rss_kb'] is not None else ''))
+
+
+def compare_reports(baseline, report, tolerance):
+    """Returns a list of (stream, threads, old fps, new fps) that are slower than the tolerance."""
+    old = {}
+    for stream in baseline['streams']:
+        for r in stream['results']:
+            old[(stream['name'], r['threads'])] = r['fps']
+
+    regressions = []
+    for stream in report['streams']:
+        for r in stream['results']:
+            key = (stream['name'], r['threads'])
+            if key in old and r['fps'] < old[key] * (1 - tolerance / 100.0):
+                regressions.append((stream['name'], r['threads'], old[key], r['fps']))
+
+    return regressions
+
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options]')
+    parser.add_option('--dec265', default='./dec265/dec265',
+                      help='decoder executable [%default]')
+    parser.add_option('--enc265', default='./enc265/enc265',
+                      help='encoder executable for generating the corpus [%default]')
+    parser.add_option('--corpus', default='benchmark-corpus',
+                      help='directory of the generated streams [%default]')
+    parser.add_option('--no-corpus', action='store_true',
+                      help='do not generate/use the synthetic corpus')
+    parser.add_option('--encoder-timeout', type='int', default=DEFAULT_ENCODER_TIMEOUT,
+                      help='seconds after which the encoding of a corpus stream is aborted [%default]')
+    parser.add_option('--no-default-streams', action='store_true',
+                      help='do not decode the streams in %s' % STREAMS_DIR)
+    parser.add_option('--generate-default-streams', action='store_true',
+                      help='encode the missing streams of %s with --enc265 and exit' % STREAMS_DIR)
+    parser.add_option('--streams', action='append', default=[],
+                      help='additional stream file or directory of *.bin/*.bit files '
+                      '(e.g. with WPP, tiles, slices or 10 bit), can be repeated')
+    parser.add_option('--resolutions', default=DEFAULT_RESOLUTIONS,
+                      help='corpus resolutions [%default]')
+    parser.add_option('--frames', type='int', default=DEFAULT_FRAMES,
+                      help='frames per corpus stream [%default]')
+    parser.add_option('--qp', type='int', default=DEFAULT_QP,
+                      help='QP of the corpus streams [%default]')
+    parser.add_option('--threads', default=None,
+                      help='comma-separated thread counts [%s]' %
+                      ','.join(str(t) for t in default_thread_counts()))
+    parser.add_option('--repeat', type='int', default=3,
+                      help='decode each stream this often, the fastest run counts [%default]')
+    parser.add_option('--output', default=None,
+                      help='write the results to this file instead of stdout')
+    parser.add_option('--csv', action='store_true',
+                      help='write CSV instead of JSON')
+    parser.add_option('--compare', default=None,
+                      help='JSON results of a previous run to compare against')
+    parser.add_option('--tolerance', type='float', default=5.0,
+                      help='allowed slowdown in percent when comparing [%default]')
+    (options, args) = parser.parse_args()
+
+    if options.threads:
+        thread_counts = [int(t) for t in options.threads.split(',')]
+    else:
+        thread_counts = default_thread_counts()
+
+    if options.generate_default_streams:
+        streams = generate_corpus(options.enc265, STREAMS_DIR, DEFAULT_STREAM_CONFIGS,
+                                  DEFAULT_STREAM_RESOLUTIONS.split(','),
+                                  DEFAULT_STREAM_FRAMES, DEFAULT_STREAM_QP,
+                                  options.encoder_timeout, input_dir=options.corpus)
+        expected = len(DEFAULT_STREAM_CONFIGS) * len(DEFAULT_STREAM_RESOLUTIONS.split(','))
+        sys.exit(0 if len(streams) == expected else 1)
+
+    streams = []
+    if not options.no_corpus:
+        streams += generate_corpus(options.enc265, options.corpus, CORPUS_CONFIGS,
+                                   options.resolutions.split(','),
+                                   options.frames, options.qp,
+                                   options.encoder_timeout)
+
+    if not options.no_default_streams:
+        streams += list_streams(STREAMS_DIR)
+
+    for path in options.streams + args:
+        if os.path.isdir(path):
+            streams += list_streams(path)
+        else:
+            streams.append(path)
+
+    if not streams:
+        print('no streams to decode', file=sys.stderr)
+        sys.exit(1)
+
+    report = {
+        'version': RESULT_FORMAT_VERSION,
+        'date': time.strftime('%Y-%m-%dT%H:%M:%S'),
+        'host': platform.node(),
+        'platform': platform.platform(),
+        'cpus': CPU_COUNT,
+        'dec265': options.dec265,
+        'repeat': options.repeat,
+        'streams': [],
+    }
+
+    failed = []
+    for filename in streams:
+        result = benchmark_stream(options.dec265, filename, thread_counts, options.repeat)
+        if result is None:
+            failed.append(filename)
+        else:
+            report['streams'].append(result)
+
+    out = open(options.output, 'w') if options.output else sys.stdout
+    if options.csv:
+        write_csv(report, out)
+    else:
+        json.dump(report, out, indent=2, sort_keys=True)
+        out.write('\n')
+    if options.output:
+        out.close()
+
+    exitcode = 0
+
+    if failed:
+        print('Found %d streams with errors:' % len(failed), file=sys.stderr)
+        print('\n'.join(failed), file=sys.stderr)
+        exitcode = 1
+
+    if options.compare:
+        with open(options.compare) as f:
+            baseline = json.load(f)
+
+        regressions = compare_reports(baseline, report, options.tolerance)
+        for name, threads, old_fps, new_fps in regressions:
+            print('SLOWER: %s threads %d: %.2f -> %.2f fps (%.1f%%)' %
+                  (name, threads, old_fps, new_fps, (new_fps / old_fps - 1) * 100),
+                  file=sys.stderr)
+        if regressions:
+            exitcode = 1
+
+    sys.exit(exitcode)
+
+if __name__ == '__main__':
+    main()
@@ -438,6 +438,7 @@ void VideoDecoder::init_decoder(const char* filename)
   //rbsp_buffer_init(&buf);
 
   ctx = de265_new_decoder();
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_KEEP_FULL_MOTION_FIELD, 1); // for draw_Motion()
   de265_start_worker_threads(ctx, 4); // start 4 background threads
 }
 